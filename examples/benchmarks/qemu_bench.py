@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2020 Richard Healy
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+
+#
+# qemu_bench.py
+# Boot the benchmark image under qemu-system-aarch64, collect the BENCH
+# report lines printed by task1 and compare them against a baseline. 
+# Exits with status 1 if a benchmark is slower than the baseline by 
+# more than the tolerance.
+#
+# Usage: qemu_bench.py [--save baseline.json] [--baseline baseline.json]
+#                      [--capture uart.log] [--rounds N] [--tolerance F]
+#
+
+import argparse
+import json
+import re
+import statistics
+import subprocess
+import sys
+import time
+
+BENCH = re.compile(r"^BENCH (\w+) 0x([0-9A-Fa-f]+) 0x([0-9A-Fa-f]+) "
+                   r"0x([0-9A-Fa-f]+) 0x([0-9A-Fa-f]+) 0x([0-9A-Fa-f]+)")
+
+#
+# Capture. Returns the uart output up to the end of the last round.
+#
+
+def run_qemu(args):
+    cmd = [args.qemu, "-M", args.machine, "-kernel", args.image,
+           "-display", "none", "-serial", "stdio", "-monitor", "none"]
+    if args.icount:
+# Counter follows the instruction count so results do not depend on
+# the load of the host.
+        cmd += ["-icount", "shift=0,align=off"]
+
+    proc  = subprocess.Popen(cmd, stdout=subprocess.PIPE, 
+                             stderr=subprocess.DEVNULL, 
+                             universal_newlines=True, errors="replace")
+    lines = []
+    ends  = 0
+    start = time.time()
+
+    try:
+        for line in proc.stdout:
+            lines.append(line)
+            if line.startswith("BENCH end"):
+                ends += 1
+                if ends > args.rounds: # First round warms up.
+                    break
+            if time.time() - start > args.timeout:
+                sys.exit("qemu_bench.py: timed out after %u rounds" % ends)
+    finally:
+        proc.kill()
+        proc.wait()
+
+    if ends <= args.rounds:
+        sys.exit("qemu_bench.py: qemu exited after %u rounds" % ends)
+
+    return "".join(lines)
+
+#
+# Report. Returns {name: {"avg": ns, "min": ns, "max": ns, "rounds": n}}.
+# avg is the median over rounds of the average of each round.
+#
+
+def parse(text, skip):
+    rounds = {}
+    ended  = 0
+
+    for line in text.splitlines():
+        if line.startswith("BENCH end"):
+            ended += 1
+            continue
+        m = BENCH.match(line)
+        if not m or ended < skip:
+            continue
+        name = m.group(1)
+        num, lo, avg, hi, freq = (int(g, 16) for g in m.groups()[1:])
+        if not freq:
+            continue
+        ns = lambda ticks: ticks * 1e9 / freq
+        rounds.setdefault(name, []).append((ns(lo), ns(avg), ns(hi)))
+
+    report = {}
+    for name, res in rounds.items():
+        report[name] = {
+            "avg": statistics.median(r[1] for r in res),
+            "min": min(r[0] for r in res),
+            "max": max(r[2] for r in res),
+            "rounds": len(res),
+        }
+
+    return report
+
+def compare(report, baseline, tolerance):
+    regressions = 0
+
+    print("%-18s %12s %12s %8s" % ("benchmark", "baseline ns", "ns", "ratio"))
+    for name in sorted(set(report) | set(baseline)):
+        if name not in report or name not in baseline:
+            print("%-18s %s" % (name, "missing from " + 
+                  ("report" if name not in report else "baseline")))
+            continue
+
+        old = baseline[name]["avg"]
+        new = report[name]["avg"]
+        ratio = new / old if old else 1.0
+        flag  = ""
+        if ratio > 1.0 + tolerance:
+            flag = "  REGRESSION"
+            regressions += 1
+        print("%-18s %12.0f %12.0f %8.2f%s" % (name, old, new, ratio, flag))
+
+    return regressions
+
+def main():
+    ap = argparse.ArgumentParser(description="Run and compare the rpi3rtos benchmark image.")
+    ap.add_argument("--image", default="kernel8.img")
+    ap.add_argument("--qemu", default="qemu-system-aarch64")
+    ap.add_argument("--machine", default="raspi3", 
+                    help="raspi3b on qemu 6.0 and later")
+    ap.add_argument("--no-icount", dest="icount", action="store_false",
+                    help="run qemu in real time")
+    ap.add_argument("--rounds", type=int, default=3, 
+                    help="rounds to collect after the first")
+    ap.add_argument("--timeout", type=float, default=600)
+    ap.add_argument("--capture", 
+                    help="read a uart capture (for example from hardware) instead of running qemu")
+    ap.add_argument("--save", help="write the report to this baseline file")
+    ap.add_argument("--baseline", help="compare against this baseline file")
+    ap.add_argument("--tolerance", type=float, default=0.10,
+                    help="allowed slow down as a fraction (default 0.10)")
+    args = ap.parse_args()
+
+    if args.capture:
+        with open(args.capture, errors="replace") as f:
+            text = f.read()
+    else:
+        text = run_qemu(args)
+
+    report = parse(text, 0 if args.capture else 1)
+    if not report:
+        sys.exit("qemu_bench.py: no BENCH lines found")
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+            f.write("\n")
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        if compare(report, baseline, args.tolerance):
+            sys.exit(1)
+    else:
+        for name in sorted(report):
+            r = report[name]
+            print("%-18s avg %10.0f ns min %10.0f ns max %10.0f ns" % 
+                  (name, r["avg"], r["min"], r["max"]))
+
+if __name__ == "__main__":
+    main()
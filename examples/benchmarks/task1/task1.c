@@ -0,0 +1,439 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//task1.c
+// Benchmark. Measures context switches, syscall round trips, how late
+// a task runs after a sleep expires, copy bandwidth of the loader and
+// of word copy and fill loops. Prints a report then repeats.
+//
+
+#include "task.h"
+#include "uart.h"
+#include "timer.h"
+#include "kernel.h"
+
+//
+//TASK1_PRIORITY
+// Priority in kernel queue. Higher than task2.
+//
+#define TASK1_PRIORITY 2
+
+//
+//TASK2_PRIORITY
+// Priority of task2 which yields in a loop.
+//
+#define TASK2_PRIORITY 1
+
+//
+//TASK1_SAMPLES
+// Number of measurements per report.
+//
+#define TASK1_SAMPLES 64
+
+//
+//TASK1_SLEEP_US
+// Microseconds to sleep for each measurement.
+//
+#define TASK1_SLEEP_US 500
+
+//
+//TASK1_JITTER_SAMPLES
+// Number of tick sleeps per report. Each takes one tick.
+//
+#define TASK1_JITTER_SAMPLES 8
+
+//
+//TASK1_AFFINITY
+// Task1 and task2 share core 1 so they can switch to each other. Core
+// 0 also handles uart interrupts.
+//
+#define TASK1_AFFINITY 0x2
+
+//
+//TASK1_COPY_SZ
+// Bytes copied or filled for each bandwidth measurement.
+//
+#define TASK1_COPY_SZ 0x4000
+
+//*********************************************************************
+// Mandatory OS Headers
+//
+// The operating system relies on the existence of headers linked at
+// a specific offset in the task image to assist in loading and
+// communicating with the task.
+// 
+//*********************************************************************
+
+//
+//From linker script in order of appearance in memory.
+//
+extern int __task_ro_end;
+extern int __task_rw_beg;
+extern int __task_header_beg;
+extern int __task_rw_end;
+extern int __task_bss_beg;
+extern int __task_bss_end;
+extern int __task_bss_sz;
+
+//
+//tasklistitem{}
+// List item for each task stored in the executable image. This gets
+// loaded into first block of r/o memory in task's address space.
+//
+static task_list_item tasklistitem
+    __attribute__ ((section (".task_list_item"))) 
+    __attribute__ ((__used__)) = {
+    TASK_LIST_ITEM_MAGIC,
+    (u64_t) &__task_ro_end,
+    (u64_t) &__task_rw_beg,
+    (u64_t) &__task_rw_end,
+    (u64_t) &__task_bss_beg,
+    (u64_t) &__task_bss_end
+};
+
+
+//
+//Predefines for header.
+//
+void task1_init(u64_t);
+void task1_reset(u64_t);
+
+//
+//task1_header{}
+// Header located in 4kB aligned R/W memory shared by task and kernel.
+//
+volatile task_header task1_header
+    __attribute__ ((section (".task_header"))) 
+    __attribute__ ((__used__)) = {
+    TASK_HEADER_MAGIC, 0,
+    TASK1_PRIORITY, KERNEL_TASK_FLAG_QUEUE_FIFO,
+    task1_init,
+    task1_reset,
+    TASK1_AFFINITY
+};
+
+
+//*********************************************************************
+// Task Specific Code
+//*********************************************************************
+
+//
+//task1_stats{}
+// Minimum, maximum and total of a set of samples.
+//
+typedef struct _task1_stats {
+    u64_t num;
+    u64_t min;
+    u64_t max;
+    u64_t sum;
+} task1_stats;
+
+//
+//task1_stats_init()
+//
+void task1_stats_init(task1_stats *st) {
+    st->num = 0;
+    st->min = 0xFFFFFFFFFFFFFFFF;
+    st->max = 0;
+    st->sum = 0;
+}
+
+//
+//task1_stats_add()
+//
+void task1_stats_add(task1_stats *st, u64_t sample) {
+    ++st->num;
+    st->sum += sample;
+    if (sample < st->min) { st->min = sample; }
+    if (sample > st->max) { st->max = sample; }
+}
+
+//
+//task1_stats_print()
+// Prints: BENCH <name> <samples> <min> <avg> <max> <counter frequency>
+//
+void task1_stats_print(const char *name, task1_stats *st) {
+    uart_puts("BENCH ");
+    uart_puts(name);
+    uart_puts(" ");
+    uart_u64hex(st->num);
+    uart_puts(" ");
+    uart_u64hex(st->min);
+    uart_puts(" ");
+    uart_u64hex(st->sum / st->num);
+    uart_puts(" ");
+    uart_u64hex(st->max);
+    uart_puts(" ");
+    uart_u64hex(timer_cntp_freq());
+    uart_puts("\n");
+}
+
+//
+//task1_src[], task1_dst[]
+// Buffers for the bandwidth measurements.
+//
+u64_t task1_src[TASK1_COPY_SZ / 8];
+u64_t task1_dst[TASK1_COPY_SZ / 8];
+
+//
+//task1_context_switch()
+// Half the round trip of a yield to task2 which yields straight back.
+// Task1 drops to task2's priority for the measurement.
+//
+void task1_context_switch(task1_stats *st) {
+    u64_t i, beg, end;
+
+    task_priority_set(TASK2_PRIORITY, KERNEL_TASK_FLAG_QUEUE_FIFO);
+
+    for (i = 0; i < TASK1_SAMPLES; ++i) {
+        beg = timer_cntp_count();
+        task_yield();
+        end = timer_cntp_count();
+        task1_stats_add(st, (end - beg) / 2);
+    }
+
+    task_priority_set(TASK1_PRIORITY, KERNEL_TASK_FLAG_QUEUE_FIFO);
+}
+
+//
+//task1_syscall_time()
+// Counter ticks for a round trip of a syscall taking the fast path.
+//
+void task1_syscall_time(task1_stats *st) {
+    u64_t i, beg, end;
+
+    for (i = 0; i < TASK1_SAMPLES; ++i) {
+        beg = timer_cntp_count();
+        task_time();
+        end = timer_cntp_count();
+        task1_stats_add(st, end - beg);
+    }
+}
+
+//
+//task1_syscall_priority()
+// Round trip of a priority change. Task1 alternates between two 
+// priorities above task2 so every call moves it in the queue through
+// the kernel, which resumes task1 without running another task. Setting
+// the current priority would take the fast path.
+//
+void task1_syscall_priority(task1_stats *st) {
+    u64_t i, beg, end, priority;
+
+    for (i = 0; i < TASK1_SAMPLES; ++i) {
+        priority = (i & 1) ? TASK1_PRIORITY : TASK1_PRIORITY + 1;
+        beg = timer_cntp_count();
+        task_priority_set(priority, KERNEL_TASK_FLAG_QUEUE_FIFO);
+        end = timer_cntp_count();
+        task1_stats_add(st, end - beg);
+    }
+
+    task_priority_set(TASK1_PRIORITY, KERNEL_TASK_FLAG_QUEUE_FIFO);
+}
+
+//
+//task1_syscall_yield()
+// Round trip of a yield with no other task at the same priority.
+//
+void task1_syscall_yield(task1_stats *st) {
+    u64_t i, beg, end;
+
+    for (i = 0; i < TASK1_SAMPLES; ++i) {
+        beg = timer_cntp_count();
+        task_yield();
+        end = timer_cntp_count();
+        task1_stats_add(st, end - beg);
+    }
+}
+
+//
+//task1_syscall_sleep()
+// Round trip of a sleep which has already expired. The task leaves the
+// queue, task2 runs until the timer interrupt and the task is switched
+// back in.
+//
+void task1_syscall_sleep(task1_stats *st) {
+    u64_t i, beg, end;
+
+    for (i = 0; i < TASK1_SAMPLES; ++i) {
+        beg = timer_cntp_count();
+        task_usleep(0);
+        end = timer_cntp_count();
+        task1_stats_add(st, end - beg);
+    }
+}
+
+//
+//task1_wakeup_latency()
+// Counter ticks from requested wake up time until the task runs. The
+// timer interrupt fires at the wake up time so this is the latency from
+// interrupt to task.
+//
+void task1_wakeup_latency(task1_stats *st) {
+    u64_t i, beg, end;
+    u64_t sleep = (TASK1_SLEEP_US * timer_cntp_freq()) / 1000000;
+
+    for (i = 0; i < TASK1_SAMPLES; ++i) {
+        beg = timer_cntp_count();
+        task_usleep(TASK1_SLEEP_US);
+        end = timer_cntp_count();
+        task1_stats_add(st, end - (beg + sleep));
+    }
+}
+
+//
+//task1_sleep_jitter()
+// Counter ticks between the period of a one tick sleep loop and the 
+// tick.
+//
+void task1_sleep_jitter(task1_stats *st) {
+    u64_t i, beg, end;
+    u64_t tick = (KERNEL_TICK_DURATION_MS * timer_cntp_freq()) / 1000;
+
+//Line up with the tick.
+    task_sleep(KERNEL_TICK_DURATION_MS);
+    beg = timer_cntp_count();
+
+    for (i = 0; i < TASK1_JITTER_SAMPLES; ++i) {
+        task_sleep(KERNEL_TICK_DURATION_MS);
+        end = timer_cntp_count();
+        task1_stats_add(st, end - beg > tick ? end - beg - tick : 
+                                               tick - (end - beg));
+        beg = end;
+    }
+}
+
+//
+//task1_loader_copy()
+// Counter ticks per 4kB for the copy loop the startup loader uses.
+//
+void task1_loader_copy(task1_stats *st) {
+    u64_t i, beg, end;
+
+    for (i = 0; i < TASK1_SAMPLES; ++i) {
+        beg = timer_cntp_count();
+        task_image_copy(task1_dst, task1_src, TASK1_COPY_SZ);
+        end = timer_cntp_count();
+        task1_stats_add(st, (end - beg) * 0x1000 / TASK1_COPY_SZ);
+    }
+}
+
+//
+//task1_memcpy()
+// Counter ticks per 4kB to copy 32 bytes at a time. The barrier stops
+// the compiler from replacing the loop with a call to memcpy().
+//
+void task1_memcpy(task1_stats *st) {
+    u64_t i, j, beg, end;
+
+    for (i = 0; i < TASK1_SAMPLES; ++i) {
+        beg = timer_cntp_count();
+        for (j = 0; j < TASK1_COPY_SZ / 8; j += 4) {
+            task1_dst[j]     = task1_src[j];
+            task1_dst[j + 1] = task1_src[j + 1];
+            task1_dst[j + 2] = task1_src[j + 2];
+            task1_dst[j + 3] = task1_src[j + 3];
+            asm volatile ("" ::: "memory");
+        }
+        end = timer_cntp_count();
+        task1_stats_add(st, (end - beg) * 0x1000 / TASK1_COPY_SZ);
+    }
+}
+
+//
+//task1_memset()
+// Counter ticks per 4kB to fill 32 bytes at a time.
+//
+void task1_memset(task1_stats *st) {
+    u64_t i, j, beg, end;
+
+    for (i = 0; i < TASK1_SAMPLES; ++i) {
+        beg = timer_cntp_count();
+        for (j = 0; j < TASK1_COPY_SZ / 8; j += 4) {
+            task1_dst[j]     = i;
+            task1_dst[j + 1] = i;
+            task1_dst[j + 2] = i;
+            task1_dst[j + 3] = i;
+            asm volatile ("" ::: "memory");
+        }
+        end = timer_cntp_count();
+        task1_stats_add(st, (end - beg) * 0x1000 / TASK1_COPY_SZ);
+    }
+}
+
+//
+//task1_bench()
+// Run one benchmark and print its report line.
+//
+void task1_bench(const char *name, void (*fn)(task1_stats *)) {
+    task1_stats st;
+
+    task1_stats_init(&st);
+    fn(&st);
+    task1_stats_print(name, &st);
+}
+
+//
+//task1_main()
+// Run benchmarks. Print report. Repeat.
+//
+void task1_main() {
+    while(1) {
+        task1_bench("context_switch", task1_context_switch);
+        task1_bench("syscall_time", task1_syscall_time);
+        task1_bench("syscall_priority", task1_syscall_priority);
+        task1_bench("syscall_yield", task1_syscall_yield);
+        task1_bench("syscall_sleep", task1_syscall_sleep);
+        task1_bench("wakeup_latency", task1_wakeup_latency);
+        task1_bench("sleep_jitter", task1_sleep_jitter);
+        task1_bench("loader_copy", task1_loader_copy);
+        task1_bench("memcpy", task1_memcpy);
+        task1_bench("memset", task1_memset);
+        uart_puts("BENCH end\n");
+    }
+}
+
+//
+//task1_init()
+// Manadatory function.
+//
+void task1_init(u64_t arg) {
+    uart_puts("task1_init(): Initializing task1.\n");
+    uart_puts("task1_init(): Initialized task1. Suspending...\n");
+    task_suspend(KERNEL_TASK_FLAG_WAKEUP_POST_INIT);
+//When woke from kernel post-init execution will resume from here.
+    uart_puts("task1_main(): Woke from suspend. Calling task1_main().\n");
+    task1_main();
+}
+
+//
+//task1_reset()
+// Manadatory function.
+//
+void task1_reset(u64_t arg) {
+    uart_puts("task1_init(): Reset task1...\n");
+    uart_puts("task1_init(): Task1 reset. Suspending...\n");
+    task_suspend(KERNEL_TASK_FLAG_WAKEUP_POST_RESET);
+}
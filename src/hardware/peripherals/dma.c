@@ -0,0 +1,74 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dma.h"
+
+//
+//dma_barrier()
+// Complete memory accesses before the controller is started.
+//
+static inline void dma_barrier(void) {
+    asm volatile ("dsb sy\n" ::: "memory");
+}
+
+void dma_init(u64_t ch) {
+    *DMA_ENABLE |= (0x1 << ch);
+    DMA_CHANNEL_REG_BLK(ch)->CS = DMA_CS_RESET;
+    while (DMA_CHANNEL_REG_BLK(ch)->CS & DMA_CS_RESET) {}
+    DMA_CHANNEL_REG_BLK(ch)->CS = DMA_CS_END | DMA_CS_INT;
+}
+
+void dma_start(u64_t ch, dma_cb *cb) {
+    dma_cache_clean(cb, sizeof(dma_cb));
+
+    DMA_CHANNEL_REG_BLK(ch)->CONBLK_AD = DMA_BUS_MEM(cb);
+    DMA_CHANNEL_REG_BLK(ch)->CS = DMA_CS_ACTIVE | DMA_CS_WAIT_WRITES |
+                                  DMA_CS_PRIORITY(8) | DMA_CS_PANIC(8);
+}
+
+u64_t dma_active(u64_t ch) {
+    return DMA_CHANNEL_REG_BLK(ch)->CS & DMA_CS_ACTIVE;
+}
+
+u64_t dma_irq_clear(u64_t ch) {
+    u32_t cs = DMA_CHANNEL_REG_BLK(ch)->CS;
+
+    DMA_CHANNEL_REG_BLK(ch)->CS = (cs & DMA_CS_ACTIVE) | DMA_CS_END | DMA_CS_INT;
+    dma_barrier();
+
+    return cs & DMA_CS_END;
+}
+
+void dma_cache_clean(const void *beg, u64_t len) {
+    u64_t ctr, line, addr;
+
+//Smallest data cache line is 4 << CTR_EL0.DminLine bytes.
+    asm volatile ("mrs  %0, ctr_el0\n" : "=r"(ctr) :: );
+    line = 4 << ((ctr >> 16) & 0xF);
+
+    for (addr = (u64_t) beg & ~(line - 1); addr < (u64_t) beg + len; addr += line) {
+        asm volatile ("dc   cvac, %0\n" :: "r"(addr) : "memory");
+    }
+    dma_barrier();
+}
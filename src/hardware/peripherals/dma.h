@@ -0,0 +1,144 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//dma.h
+// BCM2837 DMA controller. Channels 0-6 are full channels. Addresses
+// handed to the controller are VideoCore bus addresses.
+//
+#ifndef DMA_H
+#define DMA_H
+
+#include "platform.h"
+
+//
+//DMA controller registers
+//
+#define DMA_BASE        (MMIO_BASE + 0x00007000)
+#define DMA_ENABLE      ((volatile u32_t *) (DMA_BASE + 0xFF0))
+
+//
+//DMA_BUS_*()
+// Bus address of ARM memory through the uncached alias and of a 
+// peripheral register.
+//
+#define DMA_BUS_MEM(addr)    ((u32_t) (u64_t) (addr) | 0xC0000000)
+#define DMA_BUS_PERIPH(addr) ((u32_t) ((u64_t) (addr) - MMIO_BASE + 0x7E000000))
+
+//
+//DMA_CS_*
+// Channel control and status bits.
+//
+#define DMA_CS_ACTIVE       0x00000001 //ACTIVE [0:0] Start or busy.
+#define DMA_CS_END          0x00000002 //END [1:1] Write 1 to clear.
+#define DMA_CS_INT          0x00000004 //INT [2:2] Write 1 to clear.
+#define DMA_CS_PRIORITY(n)  ((n) << 16) //PRIORITY [19:16]
+#define DMA_CS_PANIC(n)     ((n) << 20) //PANIC_PRIORITY [23:20]
+#define DMA_CS_WAIT_WRITES  0x10000000 //WAIT_FOR_OUTSTANDING_WRITES [28:28]
+#define DMA_CS_RESET        0x80000000 //RESET [31:31]
+
+//
+//DMA_TI_*
+// Transfer information bits of a control block.
+//
+#define DMA_TI_INTEN        0x00000001 //INTEN [0:0] Interrupt when done.
+#define DMA_TI_WAIT_RESP    0x00000008 //WAIT_RESP [3:3]
+#define DMA_TI_DEST_DREQ    0x00000040 //DEST_DREQ [6:6] Peripheral paces writes.
+#define DMA_TI_SRC_INC      0x00000100 //SRC_INC [8:8]
+#define DMA_TI_PERMAP(n)    ((n) << 16) //PERMAP [20:16] DREQ source.
+#define DMA_TI_NO_WIDE      0x04000000 //NO_WIDE_BURSTS [26:26]
+
+//
+//DMA_PERMAP_UART_TX
+// PL011 transmit DREQ.
+//
+#define DMA_PERMAP_UART_TX  12
+
+//
+//dma_channel_register_block
+// Registers of one channel. Channels are 0x100 apart.
+//
+typedef struct _dma_channel_register_block {
+    u32_t CS;           // 0x00
+    u32_t CONBLK_AD;    // 0x04
+    u32_t TI;           // 0x08
+    u32_t SOURCE_AD;    // 0x0C
+    u32_t DEST_AD;      // 0x10
+    u32_t TXFR_LEN;     // 0x14
+    u32_t STRIDE;       // 0x18
+    u32_t NEXTCONBK;    // 0x1C
+    u32_t DEBUG;        // 0x20
+} dma_channel_register_block;
+
+#define DMA_CHANNEL_REG_BLK(ch) \
+    ((volatile dma_channel_register_block *) (DMA_BASE + 0x100 * (ch)))
+
+//
+//dma_cb{}
+// Control block read by the controller. Must be 32 byte aligned.
+//
+typedef struct _dma_cb {
+    u32_t ti;
+    u32_t source_ad;
+    u32_t dest_ad;
+    u32_t txfr_len;
+    u32_t stride;
+    u32_t nextconbk;
+    u32_t res[2];
+} __attribute__((aligned(32))) dma_cb;
+
+//
+//dma_init()
+// Enable and reset channel 'ch'.
+//
+void dma_init(u64_t ch);
+
+//
+//dma_start()
+// Clean 'cb' to memory and start channel 'ch' on it. The caller cleans
+// the source buffer.
+//
+void dma_start(u64_t ch, dma_cb *cb);
+
+//
+//dma_active()
+// Non-zero while channel 'ch' is transferring.
+//
+u64_t dma_active(u64_t ch);
+
+//
+//dma_irq_clear()
+// Acknowledge a completion interrupt from channel 'ch'.
+// Returns: Non-zero if the channel had finished a transfer.
+//
+u64_t dma_irq_clear(u64_t ch);
+
+//
+//dma_cache_clean()
+// Write data cache lines covering [beg, beg + len) back to memory so 
+// the controller sees them.
+//
+void dma_cache_clean(const void *beg, u64_t len);
+
+#endif
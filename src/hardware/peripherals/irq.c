@@ -31,3 +31,19 @@ void irq_enable_system_timer(u64_t timer) {
         IRQ_REG_BLK->ENABLE_1 = 0b100; //System Timer 3 is IRQ 3.
     }
 }
+
+void irq_enable_uart0(void) {
+    IRQ_REG_BLK->ENABLE_2 = IRQ_PENDING_2_UART0;
+}
+
+void irq_enable_dma(u64_t ch) {
+    IRQ_REG_BLK->ENABLE_1 = IRQ_PENDING_1_DMA(ch);
+}
+
+void irq_mbox_enable(u64_t core) {
+    *IRQ_MBOX_CTL_CORE(core) |= IRQ_MBOX_CTL_MBOX0;
+}
+
+void irq_pmu_enable(u64_t core) {
+    *IRQ_PMU_ROUTE_SET = 0x1 << core;
+}
@@ -45,6 +45,41 @@ typedef struct _irq_register_block {
 
 #define IRQ_REG_BLK ((irq_register_block *) IRQ_BASE)
 
+//
+//IRQ_PENDING_2_UART0
+// UART0 (PL011) is GPU IRQ 57. Bit 25 of the second pending and 
+// enable registers. GPU interrupts are routed to core 0.
+//
+#define IRQ_PENDING_2_UART0 (0x1 << 25)
+
+//
+//IRQ_PENDING_1_DMA()
+// DMA channels 0-12 are GPU IRQs 16-28. Bits of the first pending and
+// enable registers.
+//
+#define IRQ_PENDING_1_DMA(ch) (0x1 << (16 + (ch)))
+
+//
+//Core mailboxes. Writing a set bit to another core's mailbox raises an
+//interrupt on that core until the bit is cleared.
+//
+#define IRQ_MBOX_CTL_CORE0 ((volatile u32_t *) 0x40000050)
+#define IRQ_MBOX0_SET_CORE0 ((volatile u32_t *) 0x40000080)
+#define IRQ_MBOX0_CLR_CORE0 ((volatile u32_t *) 0x400000C0)
+
+#define IRQ_MBOX_CTL_CORE(core)  (IRQ_MBOX_CTL_CORE0 + (core))
+#define IRQ_MBOX0_SET_CORE(core) (IRQ_MBOX0_SET_CORE0 + 4 * (core))
+#define IRQ_MBOX0_CLR_CORE(core) (IRQ_MBOX0_CLR_CORE0 + 4 * (core))
+
+#define IRQ_MBOX_CTL_MBOX0 0x1 //Mailbox 0 raises an IRQ.
+
+//
+//PMU interrupt routing. Writing bit N to the set register sends core
+//N's PMU interrupt to its IRQ. The clear register routes it nowhere.
+//
+#define IRQ_PMU_ROUTE_SET ((volatile u32_t *) 0x40000010)
+#define IRQ_PMU_ROUTE_CLR ((volatile u32_t *) 0x40000014)
+
 inline void irq_enable(void) {
     asm volatile ("msr  daifclr, #2\n");
 }
@@ -53,10 +88,69 @@ inline void irq_disable(void) {
     asm volatile ("msr  daifset, #2\n");
 }
 
+//
+//irq_save()
+// Disable interrupts and return the previous mask for irq_restore().
+//
+inline u64_t irq_save(void) {
+    u64_t daif;
+    asm volatile ("mrs  %0, daif\n"
+                  "msr  daifset, #2\n" : "=r"(daif) :: "memory");
+    return daif;
+}
+
+//
+//irq_restore()
+// Restore the interrupt mask returned by irq_save().
+//
+inline void irq_restore(u64_t daif) {
+    asm volatile ("msr  daif, %0\n" :: "r"(daif) : "memory");
+}
+
 //
 //irq_enable_system_timer()
 // Enable system timer 1 or 3 interrupts
 //
 void irq_enable_system_timer(u64_t timer);
 
+//
+//irq_enable_uart0()
+// Enable UART0 (PL011) interrupts. Taken on core 0.
+//
+void irq_enable_uart0(void);
+
+//
+//irq_enable_dma()
+// Enable interrupts from DMA channel 'ch' (0-12). Taken on core 0.
+//
+void irq_enable_dma(u64_t ch);
+
+//
+//irq_mbox_enable()
+// Interrupt core when its mailbox 0 is written.
+//
+void irq_mbox_enable(u64_t core);
+
+//
+//irq_pmu_enable()
+// Interrupt core on a PMU counter overflow.
+//
+void irq_pmu_enable(u64_t core);
+
+//
+//irq_mbox_send()
+// Raise a mailbox 0 interrupt on core.
+//
+inline void irq_mbox_send(u64_t core) {
+    *IRQ_MBOX0_SET_CORE(core) = 0x1;
+}
+
+//
+//irq_mbox_clear()
+// Clear core's mailbox 0 interrupt.
+//
+inline void irq_mbox_clear(u64_t core) {
+    *IRQ_MBOX0_CLR_CORE(core) = 0xFFFFFFFF;
+}
+
 #endif
@@ -47,14 +47,8 @@ level_3_tables LEVEL_3_TABLES;
 //Helper function.
 void mmu_print_range(u64_t beg, u64_t end, u64_t div) {
     u64_t round = div - 1;
-    uart_u64hex(beg);
-    uart_puts("-");
-    uart_u64hex(end);
-    uart_puts(" [");
-    uart_u64hex((beg + round) / div);
-    uart_puts("-");
-    uart_u64hex((end + round) / div);
-    uart_puts("]");
+    uart_printf("0x%016llX-0x%016llX [0x%016llX-0x%016llX]", beg, end,
+                (beg + round) / div, (end + round) / div);
 }
 
 
@@ -128,6 +122,38 @@ void mmu_enable_level_3_table_rox_blks(u64_t task, u64_t beg, u64_t num) {
     }
 }
 
+//
+//mmu_map_ro_page()
+// Map 'page' in the level 3 table for 'task' to the 4kB page at 'addr'
+// read-only and non-executable. Used for pages shared with the kernel.
+//
+void mmu_map_ro_page(u64_t task, u64_t page, u64_t addr) {
+    LEVEL_3_TABLES.tables[task][page] =
+        //Valid bit - [0:0]
+        //Set = 0b1
+        (u64_t) 0x0000000000000001 +
+        //Type bit - [1:1]
+        //TABLE = 0b1
+        (u64_t) 0x0000000000000002 +
+        //Attr Index - [4:2] 
+        //DRAM = 0b001 (ATTR1 in MAIR_EL1 above)
+        (u64_t) 0x0000000000000004 +
+        //AP - [7:6]
+        //RO_EL1 = 0b10
+        (u64_t) 0x0000000000000080 +
+        //SH - [9:8]
+        //Inner shareable = 0b11
+        (u64_t) 0x0000000000000300 +
+        //AF bit - [10:10]
+        //Accessible = 0b1
+        (u64_t) 0x0000000000000400 +
+        //LVL3_OUTPUT_ADDR_4KiB - [47:12]
+        (addr & 0x0000FFFFFFFFF000) +
+        //PXN - [53:53]
+        //No execute - 0b1
+        (u64_t) 0x0020000000000000;
+}
+
 //
 //mmu_enable_level_3_table()
 // Enable the level 3 table for a task.
@@ -251,7 +277,7 @@ void mmu_enable_level_2_table(u64_t task, u64_t lvl3_pos) {
     }
 }
 
-void mmu_enable(mmu_range_lst rolst, u64_t numtasks) {
+void mmu_enable(mmu_range_lst rolst, u64_t numtasks, u64_t shared) {
     u64_t i;
 
 //
@@ -298,6 +324,10 @@ void mmu_enable(mmu_range_lst rolst, u64_t numtasks) {
     for (i = 0; i < numtasks; ++i) {
         mmu_enable_level_2_table(i, MMU_BLOCKS_PER_TASK - 1);
         mmu_enable_level_3_table(i, rolst[i][0], rolst[i][1]);
+//Kernel writes the shared page. Tasks may only read it.
+        if (shared) {
+            mmu_map_ro_page(i, MMU_SHARED_PAGE, shared);
+        }
     }
 
 //Entries describe peripheral addresses starting at MMIO_BASE and extending
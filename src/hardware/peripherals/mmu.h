@@ -69,6 +69,14 @@ Task Memory
  Task executable must not exceed 2MB in size.
 */
 
+//
+//MMU_SHARED_PAGE
+// Level 3 table entry of each task mapped read-only to a page shared
+// with the kernel, the kernel statistics page. It is the last 4kB of 
+// the task's address space so task images must leave it unused.
+//
+#define MMU_SHARED_PAGE 511
+
 typedef u64_t mmu_range_lst [RTOS_MAX_TASKS][2];
 
 //
@@ -78,7 +86,16 @@ typedef u64_t mmu_range_lst [RTOS_MAX_TASKS][2];
 // rolst - Initialized array of read only begin and read only length in
 //         bytes for each task.
 // numtasks - number of tasks in rolenlst.
+// shared - 4kB aligned physical address mapped read-only at each task's
+//          MMU_SHARED_PAGE. 0 for none.
+//
+void mmu_enable(mmu_range_lst rolst, u64_t numtasks, u64_t shared);
+
+//
+//mmu_map_ro_page()
+// Map 4kB 'page' of the level 3 table for 'task' to physical address
+// 'addr' as read-only non-executable memory.
 //
-void mmu_enable(mmu_range_lst rolst, u64_t numtasks);
+void mmu_map_ro_page(u64_t task, u64_t page, u64_t addr);
 
 #endif
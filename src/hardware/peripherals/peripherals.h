@@ -28,6 +28,7 @@ Top level include pulls in all the peripheral headers.
 #ifndef PERIPHERALS_H
 #define PERIPHERALS_H
 
+#include "dma.h"
 #include "mbox.h"
 #include "mmu.h"
 #include "uart.h"
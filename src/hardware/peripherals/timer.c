@@ -33,7 +33,7 @@ void timer_init_core0(u64_t msecs) {
     
     //Enable local timer.
     //Clock is 38,400,000 MHz. Bit 28 enables timer. Bit 29 enables interrupt.
-    *TIMER_CTL_AND_STATUS = 0x30000000 + (u64_t)(38400000.0 * ((f64_t) msecs / 1000.0));
+    *TIMER_CTL_AND_STATUS = 0x30000000 + (38400 * msecs);
 
     //Set bit 2 to enable non-secure IRQ "CNTPNSIRQ"
     *TIMER_IRQCTL_CORE0 = 0b0010;
@@ -42,6 +42,13 @@ void timer_init_core0(u64_t msecs) {
     timer_clr_and_reload();    
 }
 
+void timer_init_cntp_core(u64_t core) {
+    timer_cntp_stop();
+
+    //Set bit 1 to enable non-secure IRQ "CNTPNSIRQ"
+    *TIMER_IRQCTL_CORE(core) = 0b0010;
+}
+
 void timer_one_shot_sys(u64_t timer, u64_t msecs) {
     u32_t tm = TIMER_REG_BLK_SYS->CLO + msecs;
     if (1 == timer) {
@@ -50,8 +50,32 @@ timer.h
 #define TIMER_IRQCTL_CORE0   ((volatile u32_t *) 0x40000040)
 #define TIMER_IRQSRC_CORE0   ((volatile u32_t *) 0x40000060)
 
+//
+//Per core timer interrupt control and interrupt source registers.
+//
+#define TIMER_IRQCTL_CORE(core) (TIMER_IRQCTL_CORE0 + (core))
+#define TIMER_IRQSRC_CORE(core) (TIMER_IRQSRC_CORE0 + (core))
+
 #define TIMER_CTL_AND_STATUS_INT_FLG 0x80000000 //R/O bit 31 set when there's an interrupt.
 
+//
+//Core interrupt sources.
+//
+#define TIMER_IRQSRC_CNTPNS 0x00000002 //Bit 1 set for non-secure physical timer.
+#define TIMER_IRQSRC_MBOX0  0x00000010 //Bit 4 set for mailbox 0.
+#define TIMER_IRQSRC_GPU    0x00000100 //Bit 8 set for GPU (peripheral) interrupt.
+#define TIMER_IRQSRC_PMU    0x00000200 //Bit 9 set for PMU interrupt.
+#define TIMER_IRQSRC_LOCAL  0x00000800 //Bit 11 set for local timer.
+
+//
+//ARM Generic Timer
+// Each core has a 64 bit physical counter and compare value. An
+// interrupt fires when the counter reaches the compare value.
+//
+#define TIMER_CNTP_CTL_ENABLE  0x1 //Bit 0 enables the timer.
+#define TIMER_CNTP_CTL_IMASK   0x2 //Bit 1 masks the interrupt.
+#define TIMER_CNTP_CTL_ISTATUS 0x4 //Bit 2 R/O set when condition met.
+
 //
 //timer_register_block{}
 // Register block for the system timer.
@@ -90,6 +114,52 @@ inline void timer_clr_and_reload(void) {
     *TIMER_CLR_AND_RELOAD = 0xC0000000;
 }
 
+//
+//timer_init_cntp_core()
+// Enable the generic physical timer interrupt of the calling core. 
+// Each core has its own timer. Timer is left stopped.
+//
+void timer_init_cntp_core(u64_t core);
+
+//
+//timer_cntp_freq()
+// Frequency of the generic timer counter in Hz.
+//
+inline u64_t timer_cntp_freq(void) {
+    u64_t freq;
+    asm volatile ("mrs %0, cntfrq_el0\n" : "=r"(freq) ::);
+    return freq;
+}
+
+//
+//timer_cntp_count()
+// Current value of the generic timer physical counter.
+//
+inline u64_t timer_cntp_count(void) {
+    u64_t cnt;
+    asm volatile ("isb\n"
+                  "mrs %0, cntpct_el0\n" : "=r"(cnt) :: "memory");
+    return cnt;
+}
+
+//
+//timer_cntp_set()
+// One shot. Interrupt when the physical counter reaches 'cval'.
+//
+inline void timer_cntp_set(u64_t cval) {
+    asm volatile ("msr cntp_cval_el0, %0\n"
+                  "msr cntp_ctl_el0, %1\n" 
+                  :: "r"(cval), "r"((u64_t) TIMER_CNTP_CTL_ENABLE) :);
+}
+
+//
+//timer_cntp_stop()
+// Stop the generic timer. Clears a pending interrupt.
+//
+inline void timer_cntp_stop(void) {
+    asm volatile ("msr cntp_ctl_el0, xzr\n" ::: );
+}
+
 //
 //timer_one_shot_sys()
 // Non-repeating one shot timer uses the system timer. Returns 
@@ -28,6 +28,9 @@
 //
 
 #include "uart.h"
+#include "dma.h"
+#include "fmt.h"
+#include "irq.h"
 #include "mbox.h"
 
 #define UART_FSEL14_MASK    0x00007000 //FSEL14 [14:12] = Input (0b000).
@@ -41,6 +44,15 @@
 #define UART_IBRD_MASK      0x0000FFFF //IBRD [15:0] = 0 
 #define UART_FBRD_MASK      0x0000001F //FBRD [5:0]
 #define UART_LCRH_8N1       0x00000060 //LCRH [6:5] = 0b11
+#define UART_LCRH_FEN       0x00000010 //FEN [4:4] = 0b1 16 byte FIFOs.
+#define UART_IFLS_TX_MASK   0x00000007 //TXIFLSEL [2:0]
+#define UART_IFLS_TX_1_8    0x00000000 //TXIFLSEL [2:0] = 0b000 Interrupt at 1/8 full.
+#define UART_IFLS_RX_MASK   0x00000038 //RXIFLSEL [5:3]
+#define UART_IFLS_RX_1_8    0x00000000 //RXIFLSEL [5:3] = 0b000 Interrupt at 1/8 full.
+#define UART_INT_RX         0x00000010 //RXIM, RXMIS, RXIC [4:4]
+#define UART_INT_TX         0x00000020 //TXIM, TXMIS, TXIC [5:5]
+#define UART_INT_RT         0x00000040 //RTIM, RTMIS, RTIC [6:6] Receive timeout.
+#define UART_DMACR_TXDMAE   0x00000002 //TXDMAE [1:1] Transmit FIFO raises DREQ.
 #define UART_CR_RXE         0x00000200 //RXE [9:9] = 0b1
 #define UART_CR_TXE         0x00000100 //TXE [8:8] = 0b1
 #define UART_CR_UARTEN      0x00000001 //UARTEN [0:0] = 0b1
@@ -51,6 +63,21 @@
 //
 #define UART_FR_TXFF_FLAG 0x00000020 //TXFF [5:5] 
 
+//
+//UART_FR_RXFE_FLAG
+// Bit is set while the receive FIFO is empty.
+//
+#define UART_FR_RXFE_FLAG 0x00000010 //RXFE [4:4]
+
+//
+//UART_CLOCK_*
+// UART reference clock. 4MHz gives exact divisors up to 115200 baud.
+// Faster rates need 48MHz.
+//
+#define UART_CLOCK_SLOW     4000000
+#define UART_CLOCK_FAST     48000000
+#define UART_BAUD_MAX       (UART_CLOCK_FAST / 16)
+
 typedef struct _uart0_register_block {
 //Data register.
     u32_t DR;       // 0x00
@@ -82,13 +109,115 @@ typedef struct _uart0_register_block {
     u32_t MIS;      // 0x40
 //Interupt Clear Register
     u32_t ICR;      // 0x44
+//DMA Control Register
+    u32_t DMACR;    // 0x48
 } uart0_register_block;
 
 #define UART_0_REG_BLK ((volatile uart0_register_block*) UART0_BASE)
 
+//
+//uart_tx_ring{}
+// Output queued by one core. Only the owning core writes head and only
+// core 0 writes tail so no locks are needed.
+//
+typedef struct _uart_tx_ring {
+    volatile u64_t head;        //Bytes queued.
+    volatile u64_t tail;        //Bytes moved to the hardware FIFO.
+    u64_t drops;                //Bytes dropped because the ring was full.
+    char buf[UART_TX_RING_SZ];
+} uart_tx_ring;
+
+static uart_tx_ring uart_tx_rings[PLATFORM_CORES];
+
+//
+//UART_TX_STALL_SPINS
+// Spins uart_flush() waits on cores 1-3 without core 0 taking any 
+// output before giving up.
+//
+#define UART_TX_STALL_SPINS 1000000
+
+//
+//uart_rx_ring{}
+// Received bytes. Only core 0 writes head and only the reader writes
+// tail.
+//
+typedef struct _uart_rx_ring {
+    volatile u64_t head;        //Bytes received.
+    volatile u64_t tail;        //Bytes read.
+    u64_t drops;                //Bytes dropped because the ring was full.
+    char buf[UART_RX_RING_SZ];
+} uart_rx_ring;
+
+static uart_rx_ring uart_rx;
+
+//
+//Non-zero once uart_tx_irq_init() has been called.
+//
+static volatile u64_t uart_tx_irq_on = 0;
+
+//
+//Ring being moved to the FIFO. Only changes at the end of a line so 
+//lines from different cores are not mixed. Core 0 only.
+//
+static u64_t uart_tx_cur = 0;
+
+//
+//Last byte moved from the current ring did not end a line.
+//
+static u64_t uart_tx_mid = 0;
+
+//
+//UART_DMA_*
+// States of the DMA transfer. Requested by any core and started by 
+// core 0 between lines.
+//
+#define UART_DMA_IDLE       0
+#define UART_DMA_PENDING    1
+#define UART_DMA_RUNNING    2
+
+//
+//uart_dma_req{}
+// The one DMA transfer which may be pending or running.
+//
+typedef struct _uart_dma_req {
+    volatile u64_t state;       //One of UART_DMA_*.
+    uart_dma_done_fn done;      //Called on core 0 when sent.
+    void *arg;                  //Passed to done.
+    dma_cb cb;                  //Control block read by the controller.
+    u32_t words[UART_DMA_MAX];  //One byte per word. See uart_dma_write().
+} uart_dma_req;
+
+static uart_dma_req uart_dma;
+
+//
+//Non-zero once uart_dma_init() has been called.
+//
+static volatile u64_t uart_dma_on = 0;
+
+//
+//uart_barrier()
+// Order ring accesses between cores.
+//
+static inline void uart_barrier(void) {
+    asm volatile ("dmb sy\n" ::: "memory");
+}
+
 int uart_init(void) {
+    return uart_init_baud(UART_BAUD);
+}
+
+int uart_init_baud(u64_t baud) {
     int i;
     mbox_buf buf;
+    u64_t clock, div;
+
+    if (0 == baud || baud > UART_BAUD_MAX) {
+        return -1;
+    }
+
+//Baud divisor in 64ths is clock / (16 * baud) * 64.
+    clock = (baud > 115200) ? UART_CLOCK_FAST : UART_CLOCK_SLOW;
+    div   = (4 * clock + baud / 2) / baud;
 
     buf.buffer[0] = 9 * sizeof(u32_t);
     buf.buffer[1] = 0;
@@ -96,7 +225,7 @@ int uart_init(void) {
     buf.buffer[3] = 12;
     buf.buffer[4] = 8;
     buf.buffer[5] = MBOX_CLOCK_UART;
-    buf.buffer[6] = 4000000;
+    buf.buffer[6] = clock;
     buf.buffer[7] = 0;
     buf.buffer[8] = 0;
 
@@ -136,14 +265,16 @@ int uart_init(void) {
     *GPPUDCLK_REG = 0x00000000;
 
 //Set up UART.
+    //Disable while the baud rate changes.
+    UART_0_REG_BLK->CR   = 0;
     //Clear interrupt control reg.
     UART_0_REG_BLK->ICR  = UART_0_REG_BLK->ICR   & (~UART_ICR_MASK);            //[10:0] = 0. 
-    //Results in 115200 baud.
-    UART_0_REG_BLK->IBRD = (UART_0_REG_BLK->IBRD & (~UART_IBRD_MASK)) | 0x0002; //[15:0] = 0x0002. 
-    //Fractional baud rate.
-    UART_0_REG_BLK->FBRD = (UART_0_REG_BLK->FBRD & (~UART_FBRD_MASK)) | 0xB;    //[5:0] = 0xB
-    //Bit and parity
-    UART_0_REG_BLK->LCRH = (UART_0_REG_BLK->LCRH | UART_LCRH_8N1);              //[6:5] = 0b11
+    //Integer baud rate. 0x2 for 115200 baud.
+    UART_0_REG_BLK->IBRD = (UART_0_REG_BLK->IBRD & (~UART_IBRD_MASK)) | (div >> 6);   //[15:0]
+    //Fractional baud rate. 0xB for 115200 baud.
+    UART_0_REG_BLK->FBRD = (UART_0_REG_BLK->FBRD & (~UART_FBRD_MASK)) | (div & 0x3F); //[5:0]
+    //Bit and parity. FIFOs on.
+    UART_0_REG_BLK->LCRH = (UART_0_REG_BLK->LCRH | UART_LCRH_8N1 | UART_LCRH_FEN); //[6:4] = 0b111
     //Enable UART, RX & TX
     UART_0_REG_BLK->CR   = UART_0_REG_BLK->CR |
                  UART_CR_RXE |
@@ -153,87 +284,411 @@ int uart_init(void) {
     return 0;
 }
 
-void uart_send(char c) {
-    //Wait until UART is not transmitting.
-    while(UART_0_REG_BLK->FR & UART_FR_TXFF_FLAG) {
-        asm volatile ("nop\n" :::);
+//
+//uart_tx_dma_busy()
+// Core 0 with interrupts disabled. Starts a pending DMA transfer once
+// the current ring is between lines.
+// Returns: Non-zero while DMA owns the transmit FIFO.
+//
+static u64_t uart_tx_dma_busy(void) {
+    uart_tx_ring *r = &uart_tx_rings[uart_tx_cur];
+
+    if (UART_DMA_RUNNING == uart_dma.state) {
+//Output queued meanwhile goes out after the IRQ even if already done.
+        return dma_active(UART_DMA_CHANNEL);
+    }
+
+    if (UART_DMA_PENDING == uart_dma.state && 
+        (!uart_tx_mid || r->head == r->tail)) 
+    {
+        uart_dma.state = UART_DMA_RUNNING;
+        dma_start(UART_DMA_CHANNEL, &uart_dma.cb);
+        return 1;
     }
-    //Write character to UART buffer.
-    UART_0_REG_BLK->DR = (u32_t) c;
+
+    return 0;
 }
 
-void uart_puts(const char *str) {
-    const char *ch;
-    for (ch = str; *ch != 0x00; ++ch) {
-        // convert newline to carrige return + newline
-        if ('\n' == *ch) {
-            uart_send('\r');
+//
+//uart_tx_fifo()
+// Core 0 with interrupts disabled. Move queued output to the hardware
+// FIFO until it is full or nothing is queued. The transmit interrupt
+// is only enabled while output is queued and DMA is not sending.
+//
+static void uart_tx_fifo(void) {
+    uart_tx_ring *r;
+    u64_t i;
+    char c;
+
+    if (uart_tx_dma_busy()) {
+        UART_0_REG_BLK->IMSC &= ~UART_INT_TX;
+        return;
+    }
+
+    while (!(UART_0_REG_BLK->FR & UART_FR_TXFF_FLAG)) {
+        r = &uart_tx_rings[uart_tx_cur];
+
+        if (r->head == r->tail) {
+//Next core with output.
+            for (i = 1; i <= PLATFORM_CORES; ++i) {
+                r = &uart_tx_rings[(uart_tx_cur + i) % PLATFORM_CORES];
+                if (r->head != r->tail) {
+                    break;
+                }
+            }
+            if (i > PLATFORM_CORES) {
+                break;
+            }
+            uart_tx_cur = (uart_tx_cur + i) % PLATFORM_CORES;
+        }
+
+        uart_barrier();
+        c = r->buf[r->tail & (UART_TX_RING_SZ - 1)];
+        UART_0_REG_BLK->DR = (u32_t) c;
+        uart_barrier();
+        ++r->tail;
+
+        uart_tx_mid = ('\n' != c);
+        if (!uart_tx_mid) {
+            uart_tx_cur = (uart_tx_cur + 1) % PLATFORM_CORES;
+        }
+
+        if (uart_tx_dma_busy()) {
+            UART_0_REG_BLK->IMSC &= ~UART_INT_TX;
+            return;
         }
-        uart_send(*ch);
     }
+
+    for (i = 0; i < PLATFORM_CORES; ++i) {
+        if (uart_tx_rings[i].head != uart_tx_rings[i].tail) {
+            UART_0_REG_BLK->IMSC |= UART_INT_TX;
+            return;
+        }
+    }
+    UART_0_REG_BLK->IMSC &= ~UART_INT_TX;
 }
 
-void uart_nputs(char *str, u32_t numch) {
-    int i = 0;
-    char *ch = str;
-    
-    for ( ; (i < numch) && (*ch != 0x00); ++i) {
-        // convert newline to carrige return + newline
-        if ('\n' == *ch) {
-            uart_send('\r');
+//
+//uart_tx_kick()
+// Get core 0 to move queued output to the FIFO.
+//
+static void uart_tx_kick(u64_t core) {
+    if (0 == core) {
+        uart_tx_fifo();
+    } else {
+        irq_mbox_send(0);
+    }
+}
+
+//
+//uart_tx_queue()
+// Queue one byte on the calling core's ring at 'head'. If the ring is
+// full core 0 waits for the FIFO to take output. Cores 1-3 drop the 
+// byte and count it in the ring's drops.
+// Returns: The new head.
+//
+static inline u64_t uart_tx_queue(uart_tx_ring *r, u64_t core, 
+                                  u64_t head, char c) 
+{
+    while (UART_TX_RING_SZ == head - r->tail) {
+//Full. Publish what is queued. Core 0 moves it to the FIFO itself.
+        uart_barrier();
+        r->head = head;
+        uart_tx_kick(core);
+
+//Other cores never wait for core 0 with interrupts masked. Core 0 may
+//be waiting for this core's kernel lock.
+        if (0 != core) {
+            ++r->drops;
+            return head;
         }
-        uart_send(*ch);
-        ++ch;
     }
+
+    r->buf[head & (UART_TX_RING_SZ - 1)] = c;
+    return head + 1;
 }
 
-char uart_tohex(u8_t val) {
-    switch (val & 0x0F) {
-        case 0x0: return '0';
-        case 0x1: return '1';
-        case 0x2: return '2';
-        case 0x3: return '3';
-        case 0x4: return '4';
-        case 0x5: return '5';
-        case 0x6: return '6';
-        case 0x7: return '7';
-        case 0x8: return '8';
-        case 0x9: return '9';
-        case 0xA: return 'A';
-        case 0xB: return 'B';
-        case 0xC: return 'C';
-        case 0xD: return 'D';
-        case 0xE: return 'E';
-        case 0xF: return 'F';
-        default:  return '?';
+//
+//uart_tx()
+// Send up to 'len' bytes. Text stops at a null and sends a carriage
+// return before each newline.
+//
+static void uart_tx(const char *buf, u64_t len, u64_t text) {
+    u64_t core, head, daif;
+    uart_tx_ring *r;
+
+    if (!uart_tx_irq_on) {
+//Polled. Wait for room in the FIFO before each byte.
+        for (; len && (!text || *buf); --len, ++buf) {
+            if (text && '\n' == *buf) {
+                while(UART_0_REG_BLK->FR & UART_FR_TXFF_FLAG) {}
+                UART_0_REG_BLK->DR = (u32_t) '\r';
+            }
+            while(UART_0_REG_BLK->FR & UART_FR_TXFF_FLAG) {}
+            UART_0_REG_BLK->DR = (u32_t) *buf;
+        }
+        return;
     }
+
+//Queue on this core's ring. Interrupts are disabled so nothing else on
+//this core writes the ring.
+    daif = irq_save();
+    core = platform_core();
+    r    = &uart_tx_rings[core];
+    head = r->head;
+
+    for (; len && (!text || *buf); --len, ++buf) {
+        if (text && '\n' == *buf) {
+            head = uart_tx_queue(r, core, head, '\r');
+        }
+        head = uart_tx_queue(r, core, head, *buf);
+    }
+
+    uart_barrier();
+    r->head = head;
+    uart_tx_kick(core);
+
+    irq_restore(daif);
 }
 
-void uart_u64hex(u64_t val) {
-    int i;
-    uart_puts("0x");
-    for(i = 15; i > -1; --i) {
-        uart_send(
-            uart_tohex((u8_t) (val >> i * 4))
-        );
+void uart_tx_irq_init(void) {
+//Interrupt when the FIFO drains to 2 bytes.
+    UART_0_REG_BLK->IFLS = (UART_0_REG_BLK->IFLS & (~UART_IFLS_TX_MASK)) | 
+                           UART_IFLS_TX_1_8;
+    UART_0_REG_BLK->IMSC &= ~UART_INT_TX;
+    UART_0_REG_BLK->ICR   = UART_INT_TX;
+
+    irq_enable_uart0();
+    irq_mbox_enable(0);
+
+    uart_barrier();
+    uart_tx_irq_on = 1;
+    uart_barrier();
+}
+
+void uart_tx_irq(void) {
+    if (UART_0_REG_BLK->MIS & UART_INT_TX) {
+        UART_0_REG_BLK->ICR = UART_INT_TX;
     }
+    uart_tx_fifo();
 }
 
-void uart_u64hex_s(u64_t val) {
-    int i, b;
-    b = 0;
-    u8_t byte;
-    uart_puts("0x");
-    for(i = 15; i > 0; --i) {
-        byte = (u8_t) (val >> i * 4);
-        if (0 == byte) {
-            if (0 == b) {
-                continue;
+void uart_rx_irq_init(void) {
+//Interrupt at 2 bytes. Fewer raise the receive timeout interrupt.
+    UART_0_REG_BLK->IFLS = (UART_0_REG_BLK->IFLS & (~UART_IFLS_RX_MASK)) | 
+                           UART_IFLS_RX_1_8;
+    UART_0_REG_BLK->ICR   = UART_INT_RX | UART_INT_RT;
+    UART_0_REG_BLK->IMSC |= UART_INT_RX | UART_INT_RT;
+
+    irq_enable_uart0();
+}
+
+u64_t uart_rx_irq(void) {
+    u64_t n = 0;
+    char c;
+
+    while (!(UART_0_REG_BLK->FR & UART_FR_RXFE_FLAG)) {
+        c = (char) UART_0_REG_BLK->DR;
+        ++n;
+
+        if (UART_RX_RING_SZ == uart_rx.head - uart_rx.tail) {
+            ++uart_rx.drops;
+            continue;
+        }
+
+        uart_rx.buf[uart_rx.head & (UART_RX_RING_SZ - 1)] = c;
+        uart_barrier();
+        ++uart_rx.head;
+    }
+
+    UART_0_REG_BLK->ICR = UART_INT_RX | UART_INT_RT;
+    uart_barrier();
+
+    return n;
+}
+
+u64_t uart_rx_available(void) {
+    uart_barrier();
+    return uart_rx.head != uart_rx.tail;
+}
+
+u64_t uart_read(char *buf, u64_t len) {
+    u64_t n = 0;
+
+    while (n < len && uart_rx.head != uart_rx.tail) {
+        uart_barrier();
+        buf[n++] = uart_rx.buf[uart_rx.tail & (UART_RX_RING_SZ - 1)];
+        uart_barrier();
+        ++uart_rx.tail;
+    }
+
+    return n;
+}
+
+int uart_dma_init(void) {
+    if (!uart_tx_irq_on) {
+        return -1;
+    }
+
+    dma_init(UART_DMA_CHANNEL);
+    UART_0_REG_BLK->DMACR |= UART_DMACR_TXDMAE;
+    irq_enable_dma(UART_DMA_CHANNEL);
+
+    uart_barrier();
+    uart_dma_on = 1;
+    uart_barrier();
+
+    return 0;
+}
+
+int uart_dma_write(const void *buf, u64_t len, 
+                   uart_dma_done_fn done, void *arg) 
+{
+    const u8_t *src = (const u8_t *) buf;
+    u64_t daif, i;
+
+    if (!uart_dma_on || UART_DMA_IDLE != uart_dma.state || 
+        !len || len > UART_DMA_MAX)
+    {
+        return -1;
+    }
+
+    uart_dma.done = done;
+    uart_dma.arg  = arg;
+
+//The controller only writes whole words and the data register takes 
+//the low byte of each.
+    for (i = 0; i < len; ++i) {
+        uart_dma.words[i] = src[i];
+    }
+
+//The DREQ holds the controller off while the FIFO is full.
+    uart_dma.cb.ti        = DMA_TI_INTEN | DMA_TI_WAIT_RESP | 
+                            DMA_TI_DEST_DREQ | DMA_TI_SRC_INC | 
+                            DMA_TI_PERMAP(DMA_PERMAP_UART_TX) | 
+                            DMA_TI_NO_WIDE;
+    uart_dma.cb.source_ad = DMA_BUS_MEM(uart_dma.words);
+    uart_dma.cb.dest_ad   = DMA_BUS_PERIPH(&UART_0_REG_BLK->DR);
+    uart_dma.cb.txfr_len  = (u32_t) (len * sizeof(u32_t));
+    uart_dma.cb.stride    = 0;
+    uart_dma.cb.nextconbk = 0;
+
+    dma_cache_clean(uart_dma.words, len * sizeof(u32_t));
+
+    daif = irq_save();
+    uart_barrier();
+    uart_dma.state = UART_DMA_PENDING;
+    uart_barrier();
+    uart_tx_kick(platform_core());
+    irq_restore(daif);
+
+    return 0;
+}
+
+void uart_dma_irq(void) {
+    uart_dma_done_fn done;
+    void *arg;
+
+    if (!dma_irq_clear(UART_DMA_CHANNEL) || 
+        UART_DMA_RUNNING != uart_dma.state) 
+    {
+        return;
+    }
+
+    done = uart_dma.done;
+    arg  = uart_dma.arg;
+
+    uart_barrier();
+    uart_dma.state = UART_DMA_IDLE;
+    uart_barrier();
+
+    if (done) {
+        done(arg);
+    }
+
+//Resume output queued while DMA was sending.
+    uart_tx_fifo();
+}
+
+void uart_flush(void) {
+    u64_t core = platform_core();
+    u64_t daif, i, tail;
+
+    if (!uart_tx_irq_on) {
+        return;
+    }
+
+    daif = irq_save();
+    if (0 == core) {
+        for (i = 0; i < PLATFORM_CORES; ++i) {
+            while (uart_tx_rings[i].head != uart_tx_rings[i].tail) {
+                uart_tx_fifo();
+            }
+        }
+    } else {
+//Give up if core 0 stops taking output. It may be waiting for this
+//core with interrupts masked.
+        tail = uart_tx_rings[core].tail;
+        for (i = 0; i < UART_TX_STALL_SPINS && 
+                    uart_tx_rings[core].head != uart_tx_rings[core].tail; ++i) 
+        {
+            irq_mbox_send(0);
+            if (tail != uart_tx_rings[core].tail) {
+                tail = uart_tx_rings[core].tail;
+                i    = 0;
             }
-        } else if (0 == b) {
-            b = 1;
         }
-        uart_send(uart_tohex(byte));
     }
-    uart_send(uart_tohex(val));
+
+    while (UART_DMA_IDLE != uart_dma.state && dma_active(UART_DMA_CHANNEL)) {}
+    irq_restore(daif);
+}
+
+u64_t uart_tx_drops(u64_t core) {
+    return uart_tx_rings[core].drops;
+}
+
+void uart_write(const char *buf, u64_t len) {
+    uart_tx(buf, len, 0);
+}
+
+void uart_send(char c) {
+    uart_tx(&c, 1, 0);
+}
+
+void uart_puts(const char *str) {
+    uart_tx(str, 0xFFFFFFFFFFFFFFFF, 1);
+}
+
+void uart_nputs(char *str, u32_t numch) {
+    uart_tx(str, numch, 1);
+}
+
+void uart_u64hex(u64_t val) {
+    char buf[18];
+
+    buf[0] = '0';
+    buf[1] = 'x';
+    uart_write(buf, 2 + fmt_u64(&buf[2], val, 16, 16));
+}
+
+void uart_u64hex_s(u64_t val) {
+    char buf[18];
+
+    buf[0] = '0';
+    buf[1] = 'x';
+    uart_write(buf, 2 + fmt_u64(&buf[2], val, 16, 1));
+}
+
+FMT_VARARGS
+void uart_printf(const char *fmt, ...) {
+    char buf[UART_PRINTF_MAX];
+    fmt_va_list ap;
+    u64_t n;
+
+    fmt_va_start(ap, fmt);
+    n = fmt_vsnprintf(buf, sizeof(buf), fmt, ap);
+    fmt_va_end(ap);
+
+    uart_tx(buf, n, 1);
 }
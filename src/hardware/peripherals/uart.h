@@ -36,13 +36,165 @@
 
 #include "platform.h"
 
+//
+//UART_BAUD
+// Baud rate set by uart_init(). Build with UART_BAUD=N to change.
+//
+#ifndef UART_BAUD
+#define UART_BAUD 115200
+#endif
+
+//
+//UART_TX_RING_SZ
+// Bytes in each core's transmit ring. Must be a power of two.
+//
+#define UART_TX_RING_SZ 1024
+
+//
+//UART_RX_RING_SZ
+// Bytes in the receive ring. Must be a power of two.
+//
+#define UART_RX_RING_SZ 1024
+
+//
+//UART_PRINTF_MAX
+// Buffer on the stack for one uart_printf().
+//
+#define UART_PRINTF_MAX 160
+
+//
+//UART_DMA_CHANNEL
+// DMA channel used by uart_dma_write(). Not used by the firmware.
+//
+#define UART_DMA_CHANNEL 5
+
+//
+//UART_DMA_MAX
+// Most bytes sent by one uart_dma_write().
+//
+#define UART_DMA_MAX 4096
+
+//
+//uart_dma_done_fn()
+// Called on core 0 with interrupts disabled when a DMA transfer has 
+// been sent.
+//
+typedef void (*uart_dma_done_fn)(void *arg);
+
 //
 //uart_init()
-// Initialze uart.
+// Initialze uart at UART_BAUD.
 // Returns: -1 on error, 0 on success.
 //
 int uart_init(void);
 
+//
+//uart_init_baud()
+// Initialize uart at any baud rate up to 3000000. Rates above 115200 
+// reprogram the UART clock through the mailbox.
+// Returns: -1 on error, 0 on success.
+//
+int uart_init_baud(u64_t baud);
+
+//
+//uart_tx_irq_init()
+// Called once on core 0. From now on output is queued in a ring on the
+// writing core and moved to the hardware FIFO by the transmit 
+// interrupt on core 0. Other cores signal new output through core 0's
+// mailbox. The caller routes UART0 and mailbox 0 interrupts on core 0
+// to uart_tx_irq().
+//
+void uart_tx_irq_init(void);
+
+//
+//uart_tx_irq()
+// Called on core 0 with interrupts disabled for a UART0 or mailbox 0
+// interrupt. Refills the hardware FIFO.
+//
+void uart_tx_irq(void);
+
+//
+//uart_rx_irq_init()
+// Called once on core 0. Received bytes are moved to the receive ring
+// by the receive interrupt on core 0 which the caller routes to 
+// uart_rx_irq().
+//
+void uart_rx_irq_init(void);
+
+//
+//uart_rx_irq()
+// Called on core 0 with interrupts disabled for a UART0 interrupt. 
+// Empties the receive FIFO into the ring. Bytes are dropped if the 
+// ring is full.
+// Returns: Number of bytes received.
+//
+u64_t uart_rx_irq(void);
+
+//
+//uart_rx_available()
+// Non-zero if the receive ring is not empty.
+//
+u64_t uart_rx_available(void);
+
+//
+//uart_read()
+// Copy up to 'len' received bytes to 'buf'. Never waits. Only one 
+// core may read at a time.
+// Returns: Number of bytes copied.
+//
+u64_t uart_read(char *buf, u64_t len);
+
+//
+//uart_dma_init()
+// Called once on core 0 after uart_tx_irq_init(). The caller routes 
+// interrupts from DMA channel UART_DMA_CHANNEL to uart_dma_irq().
+// Returns: -1 if output is not interrupt driven, 0 on success.
+//
+int uart_dma_init(void);
+
+//
+//uart_dma_write()
+// Send up to UART_DMA_MAX bytes by DMA. No newline conversion. The 
+// bytes are copied so 'buf' may be reused on return. Core 0 starts the
+// transfer between lines and feeds no other output to the FIFO until 
+// it is sent. 'done' is then called with 'arg'. One transfer at a 
+// time. Only one core may call at a time.
+// Returns: -1 if DMA is busy or not initialized, 0 if queued.
+//
+int uart_dma_write(const void *buf, u64_t len, 
+                   uart_dma_done_fn done, void *arg);
+
+//
+//uart_dma_irq()
+// Called on core 0 with interrupts disabled for a DMA channel 
+// UART_DMA_CHANNEL interrupt.
+//
+void uart_dma_irq(void);
+
+//
+//uart_flush()
+// Wait until all output queued by the calling core has been moved to
+// the hardware FIFO and a running DMA transfer has finished. Used when
+// interrupts will not be taken again. Cores 1-3 give up if core 0 
+// stops taking their output.
+//
+void uart_flush(void);
+
+//
+//uart_tx_drops()
+// Bytes dropped because the transmit ring of 'core' was full. Only
+// cores 1-3 drop. Core 0 waits for the FIFO instead.
+//
+u64_t uart_tx_drops(u64_t core);
+
+//
+//uart_write()
+// Send 'len' bytes. No newline conversion. Returns once the bytes are
+// queued. Only waits on core 0 if the ring is full. Cores 1-3 drop
+// what does not fit.
+//
+void uart_write(const char *buf, u64_t len);
+
 //
 //uart_send()
 // Send one character over the UART interface.
@@ -63,14 +215,21 @@ void uart_puts(const char *str);
 
 //
 //uart_u64hex()
-// Writes 64 bit number as hex.
+// Writes 64 bit number as hex. Always 16 digits.
 //
 void uart_u64hex(u64_t val);
 
 //
 //uart_u64hex_s()
-// Writes 64 bit number as hex.
+// Writes 64 bit number as hex without leading zeros.
 //
 void uart_u64hex_s(u64_t val);
 
+//
+//uart_printf()
+// Format with fmt_snprintf() (see fmt.h) and send the result in one 
+// write. Output is cut at UART_PRINTF_MAX - 1 characters.
+//
+void uart_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
 #endif
@@ -57,6 +57,28 @@ typedef double              f64_t;
 //
 #define ENTRY_POINT 0x00080000 //Code begins execution here.
 
+//
+//Number of Cortex-A53 cores.
+//
+#define PLATFORM_CORES 4
+
+//
+//Spin table. Firmware parks cores 1-3 reading their entry address from
+//0xE0, 0xE8 and 0xF0. Writing an address followed by 'sev' releases
+//the core.
+//
+#define PLATFORM_SPIN_TABLE(core) ((volatile u64_t *) (0xD8 + 8 * (core)))
+
+//
+//platform_core()
+// Number of the core executing this code (0-3).
+//
+inline u64_t platform_core(void) {
+    u64_t mpidr;
+    asm volatile ("mrs %0, mpidr_el1\n" : "=r"(mpidr) :: );
+    return mpidr & 0x3;
+}
+
 //
 //The stack spans between end of read only code area and 4MB boundary.
 //
@@ -0,0 +1,137 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//acct.c
+// CPU time accounting. The kernel charges the physical counter ticks
+// between switches to whatever was running: a task, the kernel 
+// servicing tasks (task0), interrupt handlers or idle. Each core
+// accounts for the tasks it runs. A stolen task takes its run time
+// with it.
+//
+
+#include "kernel.h"
+
+#define LOG_MODULE LOG_MOD_ACCT
+#include "log.h"
+
+//
+//Emitted where kernel_acct_switch() is not inlined.
+//
+extern u64_t *kernel_acct_switch(kernel *k, u64_t *to);
+
+void kernel_acct_init(kernel *k) {
+    u64_t i;
+
+    for (i = 0; i < KERNEL_TASKS_MAX; ++i) {
+        k->tasks[i].runtime = 0;
+    }
+
+    k->irq_time  = 0;
+    k->idle_time = 0;
+    k->acct      = &k->tasks[0].runtime;
+    asm volatile ("mrs %0, cntpct_el0\n" : "=r"(k->acct_stamp) :: );
+    k->acct_start   = k->acct_stamp;
+    k->acct_summary = KERNEL_ACCT_SUMMARY_TICKS;
+}
+
+u64_t kernel_acct_cpu_time(kernel *k, u64_t which) {
+    kernel *owner;
+    u64_t count;
+
+//Bring the caller's core up to date.
+    kernel_acct_switch(k, k->acct);
+
+    switch (which) {
+        case KERNEL_CPU_TIME_IRQ:
+            count = k->irq_time;
+        break;
+
+        case KERNEL_CPU_TIME_IDLE:
+            count = k->idle_time;
+        break;
+
+        case KERNEL_CPU_TIME_WALL:
+            count = k->acct_stamp - k->acct_start;
+        break;
+
+        default:
+            if (which >= k->num_tasks) {
+                return 0;
+            }
+
+//Tasks are accounted on the core which runs them. Task0 is the 
+//caller's kernel.
+            owner = which ? kernel_get_core_pointer(kernel_task_core(which)) : k;
+            if (!owner) {
+                return 0;
+            }
+            count = owner->tasks[which].runtime;
+        break;
+    }
+
+    return hrtimer_count_to_ns(&k->hrtimers, count);
+}
+
+void kernel_acct_service(kernel *k) {
+    u64_t i, wall;
+
+    if (!KERNEL_ACCT_SUMMARY_TICKS || k->time < k->acct_summary) {
+        return;
+    }
+
+    k->acct_summary = k->time + KERNEL_ACCT_SUMMARY_TICKS;
+    kernel_acct_switch(k, k->acct);
+
+    wall = k->acct_stamp - k->acct_start;
+    if (!wall) {
+        return;
+    }
+
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_acct_service(): CPU time on core "
+                         "%llu in counter ticks. Wall time 0x%llX.\n", 
+                         k->core, wall);
+
+//Names are part of the format strings so LOG_BINARY builds can log
+//them. Percentage of wall time is decimal.
+    for (i = 1; i < k->num_tasks; ++i) {
+        if (kernel_task_core(i) == k->core) {
+            LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_acct_service(): Task %llu "
+                                 "time 0x%llX (%llu%%)\n", i, 
+                                 k->tasks[i].runtime, 
+                                 k->tasks[i].runtime * 100 / wall);
+        }
+    }
+
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_acct_service(): Kernel time "
+                         "0x%llX (%llu%%)\n", k->tasks[0].runtime, 
+                         k->tasks[0].runtime * 100 / wall);
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_acct_service(): IRQ time 0x%llX "
+                         "(%llu%%)\n", k->irq_time, k->irq_time * 100 / wall);
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_acct_service(): Idle time 0x%llX "
+                         "(%llu%%)\n", k->idle_time, k->idle_time * 100 / wall);
+
+//PMU counts of the same tasks when built with KERNEL_PMU.
+    kernel_pmu_print(k);
+}
@@ -22,15 +22,18 @@
  * SOFTWARE.
  */
 
-#include "uart.h"
 #include "kernel.h"
 
+#define LOG_MODULE LOG_MOD_EXC
+#include "log.h"
+
 //
 //ESR_EL1 Exception syndrome register contains information about what
 //        triggered the exception.
 //
 #define EXCEPTIONS_ESR_EL1_EC               0xFC000000       //EC (Exception Class) bits [31:26]
 #define EXCEPTIONS_ESR_EL1_EC_AARCH64_SVC   (0b010101 << 26) //Exception was a service call.
+#define EXCEPTIONS_ESR_EL1_EC_FP_SIMD       (0b000111 << 26) //FP/SIMD access trapped by CPACR_EL1.
 #define EXCEPTIONS_ESR_EL1_ISS              0x1FFFFFF        //ISS bits [24:0]
 
 //
@@ -40,12 +43,16 @@
 u64_t current_el0_synchronous(void)     { return 0; }
 u64_t current_el0_serror(void)          { return 0; }
 
-void current_elx_synchronous(u64_t arg) {
-    u64_t *sp_ptr;
-    u64_t sp;
+kernel_switch current_elx_synchronous(u64_t arg, u64_t x1, u64_t x2, 
+                                      u64_t x3, kernel_frame *frame) 
+{
+    kernel *k = kernel_get_pointer();
+    kernel_switch sw = { 0, 0 };
     u64_t esr; //Exception class.
 
-    uart_puts("rpi3rtos::current_elx_synchronous(): An exception has occurred.\n");
+    kernel_lock_acquire(&k->lock);
+
+    LOG_PUTS(LOG_DEBUG, "rpi3rtos::current_elx_synchronous(): An exception has occurred.\n");
 
 //Load the contents of the exception syndrome register.
     asm volatile ( "mrs %0, esr_el1\n" : "=r"(esr) :: );
@@ -53,56 +60,57 @@ void current_elx_synchronous(u64_t arg) {
 //Determine what caused the exception.
     switch (esr & EXCEPTIONS_ESR_EL1_EC) {
         case EXCEPTIONS_ESR_EL1_EC_AARCH64_SVC: //Syscall from task.
-            sp_ptr = kernel_get_cur_task_sp_ptr();
-            sp = kernel_get_sp();
+            kernel_trace_psh(&k->trace, KERNEL_TRACE_SYSCALL_ENTER, k->task, 
+                             esr & EXCEPTIONS_ESR_EL1_ISS);
+            ++g_kernel_stats.tasks[k->task].syscalls;
 
-            uart_puts("rpi3rtos::current_elx_synchronous(): "
-                      "Exception is a syscall from task ");
-            uart_u64hex_s(kernel_get_pointer()->task);
-            uart_puts(".\n");
+//Syscalls which never block return straight to the caller.
+            if (!kernel_syscall_fast(k, esr & EXCEPTIONS_ESR_EL1_ISS, 
+                                     arg, frame)) 
+            {
+                kernel_trace_psh(&k->trace, KERNEL_TRACE_SYSCALL_EXIT, k->task, 
+                                 esr & EXCEPTIONS_ESR_EL1_ISS);
+                break;
+            }
 
-            kernel_get_pointer()->syscall = (esr & EXCEPTIONS_ESR_EL1_ISS); //Syscall number in ISS.
-            kernel_get_pointer()->sysarg.value = arg; //Argument passed in x0.
+            LOG_PRINTF(LOG_DEBUG, "rpi3rtos::current_elx_synchronous(): "
+                                  "Exception is a syscall from task 0x%llX.\n",
+                                  k->task);
 
-            uart_puts("rpi3rtos::current_elx_synchronous(): Syscall is ");
-            uart_u64hex_s(kernel_get_pointer()->syscall);
-            uart_puts(".\n");
+            k->syscall = (esr & EXCEPTIONS_ESR_EL1_ISS); //Syscall number in ISS.
+            k->sysarg.value = arg; //Argument passed in x0.
 
-            uart_puts("rpi3rtos::current_elx_synchronous(): Sysarg is ");
-            uart_u64hex_s(kernel_get_pointer()->sysarg.value);
-            uart_puts(".\n");
+            LOG_PRINTF(LOG_DEBUG, "rpi3rtos::current_elx_synchronous(): "
+                                  "Syscall is 0x%llX.\n", k->syscall);
 
-//             uart_puts("rpi3rtos::current_elx_synchronous(): "
-//                       "Pointer to current kernel task SP located at ");
-//             uart_u64hex_s((u64_t) sp_ptr);
-//             uart_puts("\n");
-// 
-//             uart_puts("rpi3rtos::current_elx_synchronous(): Kernel SP is ");
-//             uart_u64hex_s(sp);
-//             uart_puts("\n");
+            LOG_PRINTF(LOG_DEBUG, "rpi3rtos::current_elx_synchronous(): Sysarg "
+                                  "is 0x%llX.\n", k->sysarg.value);
 
-            uart_puts("rpi3rtos::current_elx_synchronous(): "
-                      "Exception handled. Switching to kernel task.\n");
+            LOG_PUTS(LOG_DEBUG, "rpi3rtos::current_elx_synchronous(): "
+                                "Exception handled. Switching to kernel task.\n");
 
 //
 //Exception handler stub expects the following conditions after return:
-// x0 Pointer to the kernel task SP where current task SP will be 
-//    saved.
-// x1 kernel context stack pointer which will be restored.
+// x0 Pointer where current task SP will be saved.
+// x1 Kernel context stack pointer which will be restored.
 //
-            asm volatile (
-                "mov x0, %0\n"
-                "mov x1, %1\n" 
-                :: "r"(sp_ptr), "r"(sp) :
-            );
-        return;
+            sw = kernel_schedule(k);
+        break;
+
+        case EXCEPTIONS_ESR_EL1_EC_FP_SIMD: //Task used FP/SIMD registers.
+//Load task's FP/SIMD state and retry the trapped instruction.
+            kernel_fp_trap(k);
+        break;
 
         default:
+            LOG_PUTS(LOG_ERROR, "current_elx_synchronous(): Exception is not handled. Panic.\n");
+            kernel_panic();
         break;
     }
 
-    uart_puts("current_elx_synchronous(): Exception is not handled. Panic.\n");
-    kernel_panic();
+    kernel_lock_release(&k->lock);
+
+    return sw;
 }
 
 u64_t current_elx_serror(void)          { return 0; }
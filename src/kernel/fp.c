@@ -0,0 +1,111 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//fp.c
+// Lazy floating point and SIMD context switching. Registers are only
+// saved and restored when a task uses them while another task's state
+// is loaded. Tasks which never use FP/SIMD pay nothing.
+//
+// The kernel (task0) is built with -mgeneral-regs-only and never uses
+// FP/SIMD registers.
+//
+
+#include "kernel.h"
+
+#define LOG_MODULE LOG_MOD_FP
+#include "log.h"
+
+//
+//KERNEL_FP_CPACR_FPEN
+// CPACR_EL1 bits [21:20]. 0b11 FP/SIMD access allowed. 0b00 traps.
+//
+#define KERNEL_FP_CPACR_FPEN (0x3 << 20)
+
+//
+//kernel_fp_enable()
+//
+static inline void kernel_fp_enable(u64_t enable) {
+    u64_t cpacr;
+
+    asm volatile ("mrs %0, cpacr_el1\n" : "=r"(cpacr) :: );
+    if (enable) {
+        cpacr |= KERNEL_FP_CPACR_FPEN;
+    } else {
+        cpacr &= ~KERNEL_FP_CPACR_FPEN;
+    }
+    asm volatile (
+        "msr cpacr_el1, %0\n"
+        "isb\n"
+        :: "r"(cpacr) :
+    );
+}
+
+void kernel_fp_init(kernel *k) {
+    u64_t i;
+
+//Task0 never uses FP/SIMD. Its save area holds the initial state.
+    for (i = 0; i < 64; ++i) {
+        k->tasks[0].fp.q[i] = 0;
+    }
+    k->tasks[0].fp.fpcr = 0;
+    k->tasks[0].fp.fpsr = 0;
+
+    k->fp_owner = 0;
+    kernel_fp_enable(0);
+}
+
+void kernel_fp_switch(kernel *k, u64_t task) {
+    kernel_fp_enable(task && task == k->fp_owner);
+}
+
+void kernel_fp_trap(kernel *k) {
+    u64_t task = k->task;
+
+    if (!task) {
+        LOG_PUTS(LOG_ERROR, "rpi3rtos::kernel_fp_trap(): Kernel used FP/SIMD. Panic.\n");
+        kernel_panic();
+    }
+
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_fp_trap(): Task 0x%llX takes "
+                          "FP/SIMD registers from task 0x%llX.\n",
+                          task, k->fp_owner);
+
+    kernel_fp_enable(1);
+
+    if (k->fp_owner) {
+        __fp_context_save(&k->tasks[k->fp_owner].fp);
+    }
+
+    if (k->tasks[task].flags & KERNEL_TASK_FLAG_FP_USED) {
+        __fp_context_restore(&k->tasks[task].fp);
+    } else {
+//First use. Start with clean registers rather than another task's.
+        k->tasks[task].flags |= KERNEL_TASK_FLAG_FP_USED;
+        k->tasks[task].header->flags |= TASK_HEADER_FLAG_FP_USED;
+        __fp_context_restore(&k->tasks[0].fp);
+    }
+
+    k->fp_owner = task;
+}
@@ -0,0 +1,167 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//hrtimer.c
+// High resolution timers kept in a binary min-heap ordered by 
+// deadline. Start, cancel and expire are O(log n). The earliest 
+// deadline is O(1).
+//
+
+#include "hrtimer.h"
+
+//
+//hrtimer_heap_set()
+// Put timer at heap position 'i'.
+//
+static inline void hrtimer_heap_set(hrtimer_base *b, u64_t i, hrtimer *t) {
+    b->heap[i] = t;
+    t->index   = i;
+}
+
+//
+//hrtimer_heap_up()
+// Move timer at 'i' toward the root until its parent is earlier.
+//
+static void hrtimer_heap_up(hrtimer_base *b, u64_t i) {
+    hrtimer *t = b->heap[i];
+
+    while (i > 0) {
+        u64_t parent = (i - 1) / 2;
+        if (b->heap[parent]->deadline <= t->deadline) {
+            break;
+        }
+        hrtimer_heap_set(b, i, b->heap[parent]);
+        i = parent;
+    }
+
+    hrtimer_heap_set(b, i, t);
+}
+
+//
+//hrtimer_heap_down()
+// Move timer at 'i' toward the leaves until its children are later.
+//
+static void hrtimer_heap_down(hrtimer_base *b, u64_t i) {
+    hrtimer *t = b->heap[i];
+
+    while (1) {
+        u64_t child = 2 * i + 1;
+
+        if (child >= b->count) {
+            break;
+        }
+
+        if ((child + 1 < b->count) &&
+            (b->heap[child + 1]->deadline < b->heap[child]->deadline))
+        {
+            ++child;
+        }
+
+        if (t->deadline <= b->heap[child]->deadline) {
+            break;
+        }
+
+        hrtimer_heap_set(b, i, b->heap[child]);
+        i = child;
+    }
+
+    hrtimer_heap_set(b, i, t);
+}
+
+void hrtimer_base_init(hrtimer_base *b, u64_t freq) {
+    b->freq  = freq;
+    b->count = 0;
+}
+
+void hrtimer_init(hrtimer *t, hrtimer_fn fn, u64_t arg) {
+    t->deadline = 0;
+    t->period   = 0;
+    t->fn       = fn;
+    t->arg      = arg;
+    t->index    = HRTIMER_IDLE;
+}
+
+int hrtimer_start(hrtimer_base *b, hrtimer *t) {
+    if (HRTIMER_IDLE != t->index) {
+        hrtimer_cancel(b, t);
+    }
+
+    if (b->count >= HRTIMER_MAX) {
+        return -1;
+    }
+
+    hrtimer_heap_set(b, b->count, t);
+    ++b->count;
+    hrtimer_heap_up(b, t->index);
+
+    return 0;
+}
+
+void hrtimer_cancel(hrtimer_base *b, hrtimer *t) {
+    u64_t i = t->index;
+
+    if (HRTIMER_IDLE == i) {
+        return;
+    }
+
+    t->index = HRTIMER_IDLE;
+    --b->count;
+
+//Fill the hole with the last timer and restore heap order.
+    if (i != b->count) {
+        hrtimer *last = b->heap[b->count];
+        hrtimer_heap_set(b, i, last);
+        hrtimer_heap_up(b, i);
+        hrtimer_heap_down(b, last->index);
+    }
+}
+
+u64_t hrtimer_next(hrtimer_base *b) {
+    return b->count ? b->heap[0]->deadline : HRTIMER_NEVER;
+}
+
+hrtimer *hrtimer_expired(hrtimer_base *b, u64_t now) {
+    hrtimer *t;
+
+    if ((0 == b->count) || (b->heap[0]->deadline > now)) {
+        return 0;
+    }
+
+    t = b->heap[0];
+    hrtimer_cancel(b, t);
+    return t;
+}
+
+u64_t hrtimer_count_to_ns(hrtimer_base *b, u64_t count) {
+//Split to avoid overflowing 64 bits.
+    return (count / b->freq) * HRTIMER_NS_PER_SEC +
+           ((count % b->freq) * HRTIMER_NS_PER_SEC) / b->freq;
+}
+
+u64_t hrtimer_ns_to_count(hrtimer_base *b, u64_t ns) {
+    return (ns / HRTIMER_NS_PER_SEC) * b->freq +
+           ((ns % HRTIMER_NS_PER_SEC) * b->freq + HRTIMER_NS_PER_SEC - 1) / 
+           HRTIMER_NS_PER_SEC;
+}
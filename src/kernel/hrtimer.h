@@ -0,0 +1,145 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+//
+//hrtimer.h
+// High resolution timers. Any number of timers with nanosecond 
+// absolute deadlines are kept in a binary min-heap so a single 
+// hardware comparator can be programmed with the earliest deadline.
+// Hardware independent. The kernel reads the counter and programs the
+// comparator.
+//
+
+#include "platform.h"
+
+//
+//HRTIMER_MAX
+// Maximum number of pending timers.
+//
+#define HRTIMER_MAX 256
+
+//
+//HRTIMER_NEVER
+// Returned by hrtimer_next() when no timers are pending.
+//
+#define HRTIMER_NEVER 0xFFFFFFFFFFFFFFFF
+
+//
+//HRTIMER_IDLE
+// Heap index of a timer which is not pending.
+//
+#define HRTIMER_IDLE 0xFFFFFFFFFFFFFFFF
+
+//
+//HRTIMER_NS_PER_SEC
+// Nanoseconds in a second.
+//
+#define HRTIMER_NS_PER_SEC 1000000000ULL
+
+struct _hrtimer;
+
+//
+//hrtimer_fn()
+// Signature of the function called when a timer expires.
+//
+typedef void (*hrtimer_fn)(struct _hrtimer *);
+
+//
+//hrtimer{}
+// A timer. Deadlines are absolute times in nanoseconds.
+//
+typedef struct _hrtimer {
+    u64_t deadline;  //Absolute time in nanoseconds timer expires.
+    u64_t period;    //Nanoseconds. Non-zero restarts timer on expiry.
+    hrtimer_fn fn;   //Called on expiry.
+    u64_t arg;       //Argument for the expiry function.
+    u64_t index;     //Position in heap or HRTIMER_IDLE.
+} hrtimer;
+
+//
+//hrtimer_base{}
+// Pending timers sorted by deadline in a binary min-heap.
+//
+typedef struct _hrtimer_base {
+    u64_t freq;                 //Counter frequency in Hz.
+    u64_t count;                //Number of pending timers.
+    hrtimer *heap[HRTIMER_MAX]; //Earliest deadline first.
+} hrtimer_base;
+
+//
+//hrtimer_base_init()
+// Initialize with the frequency of the hardware counter.
+//
+void hrtimer_base_init(hrtimer_base *b, u64_t freq);
+
+//
+//hrtimer_init()
+// Initialize a timer which is not pending.
+//
+void hrtimer_init(hrtimer *t, hrtimer_fn fn, u64_t arg);
+
+//
+//hrtimer_start()
+// Add timer using its deadline. A pending timer is moved to its new
+// deadline.
+// Returns: -1 if too many timers are pending, 0 on success.
+//
+int hrtimer_start(hrtimer_base *b, hrtimer *t);
+
+//
+//hrtimer_cancel()
+// Remove timer if pending.
+//
+void hrtimer_cancel(hrtimer_base *b, hrtimer *t);
+
+//
+//hrtimer_next()
+// Earliest pending deadline or HRTIMER_NEVER.
+//
+u64_t hrtimer_next(hrtimer_base *b);
+
+//
+//hrtimer_expired()
+// Remove and return the earliest timer if it expires on or before
+// 'now'. Returns 0 when there are no more expired timers.
+//
+hrtimer *hrtimer_expired(hrtimer_base *b, u64_t now);
+
+//
+//hrtimer_count_to_ns()
+// Convert counter value to nanoseconds.
+//
+u64_t hrtimer_count_to_ns(hrtimer_base *b, u64_t count);
+
+//
+//hrtimer_ns_to_count()
+// Convert nanoseconds to counter value. Rounds up so a comparator
+// never fires before the deadline.
+//
+u64_t hrtimer_ns_to_count(hrtimer_base *b, u64_t ns);
+
+#endif
@@ -22,54 +22,84 @@
  * SOFTWARE.
  */
 
-#include "uart.h"
 #include "irq.h"
 #include "timer.h"
 #include "kernel.h"
 
+#define LOG_MODULE LOG_MOD_IRQ
+#include "log.h"
+
 u64_t current_el0_irq(void) { return 0; }
 u64_t current_el0_fiq(void) { return 0; }
 
-void current_elx_irq(void) {
+kernel_switch current_elx_irq(void) {
+    kernel *k = kernel_get_pointer();
+    kernel_switch sw;
+    u64_t *acct;
+    u64_t src;
+
+    kernel_lock_acquire(&k->lock);
+    acct = kernel_acct_switch(k, &k->irq_time);
+    kernel_trace_psh(&k->trace, KERNEL_TRACE_IRQ_ENTER, k->task, 0);
+    ++g_kernel_stats.cores[k->core].irqs;
+
+    LOG_PUTS(LOG_DEBUG, "rpi3rtos::current_elx_irq(): An interrupt has occurred.\n");
+
+    src = *TIMER_IRQSRC_CORE(k->core);
+
+    if (src & TIMER_IRQSRC_PMU) {
+//Profiler sample. ELR_EL1 still holds the interrupted PC.
+        kernel_prof_sample(k);
+    }
+
+    if (src & TIMER_IRQSRC_MBOX0) {
+        irq_mbox_clear(k->core);
+//Another core queued uart output.
+        if (0 == k->core) {
+            uart_tx_irq();
+        }
+//Core 0 received uart data or sent DMA for a task waiting here.
+        if (k->rx_waiters) {
+            kernel_service_uart_rx(k);
+        }
+        kernel_service_uart_dma(k);
+    }
 
-    uart_puts("rpi3rtos::current_elx_irq(): An interrupt has occurred.\n");
+    if ((src & TIMER_IRQSRC_GPU) && 
+        (IRQ_REG_BLK->PENDING_2 & IRQ_PENDING_2_UART0)) 
+    {
+//Uart transmit FIFO needs refilling or data was received.
+        uart_tx_irq();
+        kernel_uart_rx_irq(k);
+    }
 
+    if ((src & TIMER_IRQSRC_GPU) && 
+        (IRQ_REG_BLK->PENDING_1 & IRQ_PENDING_1_DMA(UART_DMA_CHANNEL))) 
+    {
+//Uart DMA transfer has been sent.
+        uart_dma_irq();
+    }
 
-    if (*TIMER_CTL_AND_STATUS & TIMER_CTL_AND_STATUS_INT_FLG) {
-        uart_puts("rpi3rtos::current_elx_irq(): Timer has expired. Clear and reload.\n");
-        timer_clr_and_reload();
-        ++kernel_get_pointer()->ticks;
+    if (src & TIMER_IRQSRC_CNTPNS) {
+        LOG_PUTS(LOG_DEBUG, "rpi3rtos::current_elx_irq(): Timer has expired. Service timers.\n");
+        kernel_service_hrtimers(k);
     }
-    
+
 //
 //IRQ handler stub expects the following conditions after return:
-// x0 Pointer to the kernel task SP where current task SP will be 
-//    saved. If 0 skip.
-// x1 kernel context stack pointer which will be restored.
+// x0 Pointer where current task SP will be saved. If 0 skip.
+// x1 Task stack pointer which will be restored.
 //
-    if (kernel_get_pointer()->task) {
-        u64_t *sp_ptr = kernel_get_cur_task_sp_ptr();
-        u64_t sp = kernel_get_sp();
-
-        uart_puts("rpi3rtos::current_elx_irq(): ");
-        uart_puts("Interrupt handled. Switching to kernel task.\n");
-
-        asm volatile (
-            "mov x0, %0\n"
-            "mov x1, %1\n" 
-            :: "r"(sp_ptr), "r"(sp) :
-        );
-    } else { //Task0 is kernel task. No need to switch.
-        uart_puts("rpi3rtos::current_elx_irq(): ");
-        uart_puts("Interrupt handled. Resuming kernel task.\n");
-
-        asm volatile (
-            "mov x0, 0\n"
-            "mov x1, 0\n"
-        );
+    sw = kernel_schedule(k);
+    kernel_trace_psh(&k->trace, KERNEL_TRACE_IRQ_EXIT, k->task, 0);
+
+//Without a switch charge whatever was interrupted again.
+    if (&k->irq_time == k->acct) {
+        kernel_acct_switch(k, acct);
     }
+    kernel_lock_release(&k->lock);
 
-    return;
+    return sw;
 }
 
 u64_t current_elx_fiq(void) { return 0; }
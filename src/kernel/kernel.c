@@ -26,8 +26,11 @@
 
 #include "irq.h"
 #include "mmu.h"
-#include "uart.h"
 #include "timer.h"
+#include "uart.h"
+
+#define LOG_MODULE LOG_MOD_KERNEL
+#include "log.h"
 
 
 //
@@ -41,28 +44,34 @@
 extern u64_t __kernel_pointer;
 
 //
-//Global kernel pointer.
+//Global kernel pointer for each core.
 //
-kernel *g_kernel_pointer
+kernel *g_kernel_pointer[PLATFORM_CORES]
     __attribute__ ((section (".kernel_pointer"))) 
-    __attribute__ ((__used__)) = 0;
+    __attribute__ ((__used__)) = { 0 };
+
+//
+//Serializes DMA transfers requested by tasks on different cores.
+//
+static kernel_lock kernel_uart_dma_lock;
 
 kernel *kernel_get_pointer() {
-    return g_kernel_pointer;
+    return g_kernel_pointer[platform_core()];
+}
+
+kernel *kernel_get_core_pointer(u64_t core) {
+    return g_kernel_pointer[core];
 }
 
 u64_t *kernel_get_cur_task_sp_ptr() {
     kernel *k = kernel_get_pointer();
 
-    uart_puts("rpi3rtos::kernel_get_cur_task_sp_ptr(): "
-              "current task is ");
-    uart_u64hex_s(k->task);
-    uart_puts("\n");
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_get_cur_task_sp_ptr(): current "
+                          "task is 0x%llX\n", k->task);
 
-    uart_puts("rpi3rtos::kernel_get_cur_task_sp_ptr(): "
-              "Pointer to kernel task SP located at ");
-    uart_u64hex_s((u64_t) &k->tasks[k->task].sp);
-    uart_puts("\n");
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_get_cur_task_sp_ptr(): Pointer to "
+                          "kernel task SP located at 0x%llX\n",
+                          (u64_t) &k->tasks[k->task].sp);
 
     return &k->tasks[k->task].sp;
 }
@@ -76,394 +85,256 @@ extern u64_t __task_context_save(u64_t);
 // Infinite loop.
 //
 void kernel_panic() {
-    while(1) {
-        asm("wfe":::);
-    }
-}
-
-//
-//kernel_task_flags_print()
-// Helper function prints kernel task flags.
-//
-void kernel_task_flags_print(u64_t flags) {
-    uart_puts("rpi3rtos::kernel_task_flags_print(): Task flags: \n");
+    kernel *k = kernel_get_pointer();
 
-    if (flags & KERNEL_TASK_FLAG_SUSPENDED) {
-        uart_puts("rpi3rtos::kernel_task_flags_print(): KERNEL_TASK_FLAG_SUSPENDED\n");
+//Print what is left in the log ring.
+    while (k && kernel_log_pending(&k->log)) {
+        kernel_log_drain(&k->log);
     }
 
-    if (flags & KERNEL_TASK_FLAG_SLEEPING) {
-        uart_puts("rpi3rtos::kernel_task_flags_print(): KERNEL_TASK_FLAG_SLEEPING\n");
-    }
+//Interrupts will not be taken again. Send queued uart output.
+    uart_flush();
 
-    if (flags & KERNEL_TASK_FLAG_WAKEUP_POST_INIT) {
-        uart_puts("rpi3rtos::kernel_task_flags_print(): KERNEL_TASK_FLAG_WAKEUP_POST_INIT\n");
-    }
-
-    if (flags & KERNEL_TASK_FLAG_WAKEUP_POST_RESET) {
-        uart_puts("rpi3rtos::kernel_task_flags_print(): KERNEL_TASK_FLAG_WAKEUP_POST_RESET\n");
+    while(1) {
+        asm("wfe":::);
     }
 }
 
 //*********************************************************************
-// Kernel Task Node Routines
-//  Tasks are sorted and managed using referent nodes in data 
-//  structures. Currently all structures are doubly linked lists. Other 
-//  possibilities might include binary heaps or btrees.
+// Kernel Queue Task Routines
+//  Helper functions remove code duplication.
 //*********************************************************************
 
-//
-//kernel_queue_task_node_priority_gte()
-// Returns non-zero if task a is greater than or equal in priority to
-// task b.
-//
-inline u64_t kernel_queue_task_node_priority_gte(kernel *k, i64_t a, i64_t b) {
-    return (k->tasks[a].priority >= k->tasks[b].priority);
-}
-
-//
-//kernel_queue_task_node_priority_lt()
-// Returns non-zero if task a priority is less than task b.
-//
-inline u64_t kernel_queue_task_node_priority_lt(kernel *k, i64_t a, i64_t b) {
-    return (k->tasks[a].priority < k->tasks[b].priority);
-}
+void kernel_queue_task_read_and_update(kernel *k, u64_t task) {
+//Count the waiter before looking at the ring. kernel_uart_rx_irq() 
+//fills the ring before looking at the count so one of us sees the other.
+    ++k->rx_waiters;
+    asm volatile ("dmb sy\n" ::: "memory");
 
-//
-//kernel_task_node_psh()
-// Push a task node onto the provided linked list.
-//
-void kernel_task_node_psh(kernel *k, kernel_nd_item **head, u64_t task) {
-    kernel_nd_item *nd = &k->tasks[task].node;
-    if(*head) {
-        nd->next = *head;
-        (*head)->prev = nd;
+    if (uart_rx_available()) {
+//Data arrived after the fast path looked. Task retries the read.
+        --k->rx_waiters;
+        return;
     }
-    *head = nd;
+
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_queue_task_read_and_update(): Task "
+                          "0x%llX waits for uart data.\n", task);
+
+    k->tasks[task].flags |= KERNEL_TASK_FLAG_WAKEUP_UART0_RX;
+    kernel_trace_psh(&k->trace, KERNEL_TRACE_SUSPEND, task, 
+                     KERNEL_TASK_FLAG_WAKEUP_UART0_RX);
+    kernel_queue_task_node_rmv(k, task);     //Remove from queue.
+    kernel_suspend_task_node_add(k, task);   //Add to suspend list.
 }
 
 //
-//kernel_task_node_rmv()
-// Remove a task node from the provided linked list.
+//kernel_uart_dma_done()
+// Called on core 0 when a DMA transfer started for a task on kernel 
+// 'arg' has been sent.
 //
-void kernel_task_node_rmv(kernel *k, kernel_nd_item **head, u64_t task) {
-    kernel_nd_item *nd = &k->tasks[task].node;
-
-    if(nd->prev) {
-        nd->prev->next = nd->next;
-        nd->prev = 0;
-    } else {
-        *head = nd->next;
-    }
-
-    if (nd->next) {
-        nd->next->prev = nd->prev;
-        nd->next = 0;
-    }
-}
+static void kernel_uart_dma_done(void *arg) {
+    kernel *k = (kernel *) arg;
 
-//*********************************************************************
-// Kernel Task Node List Routines
-//  Tasks are sorted and managed using referent nodes in data 
-//  structures. Currently all structures are doubly linked lists. Other 
-//  possibilities might include binary heaps or btrees.
-//*********************************************************************
+    k->dma_done = 1;
+    asm volatile ("dmb sy\n" ::: "memory");
 
-void kernel_task_node_list_tail_psh(kernel *k,
-                                    kernel_nd_lst *list, 
-                                    u64_t task) 
-{
-    kernel_nd_item *nd = &k->tasks[task].node;
-    if (list->tail) {
-        list->tail->next = nd;
-        nd->prev = list->tail;
-        nd->next = 0;
-        list->tail = nd;
+    if (k == kernel_get_pointer()) {
+        kernel_service_uart_dma(k);
     } else {
-        nd->prev = 0;
-        nd->next = 0;
-        list->tail = nd;
-        list->head = nd;
+        irq_mbox_send(k->core);
     }
 }
 
-void kernel_task_node_list_rmv(kernel *k, 
-                               kernel_nd_lst *list, 
-                               u64_t task) 
-{
-    kernel_nd_item *nd = &k->tasks[task].node;
+void kernel_queue_task_dma_and_update(kernel *k, u64_t task) {
+    kernel_frame *frame = (kernel_frame *) k->tasks[task].sp;
+    int err;
 
-    if(nd->prev) {
-        nd->prev->next = nd->next;
-    } else {
-        list->head = nd->next;
-    }
+//Tasks on any core may send.
+    kernel_lock_acquire(&kernel_uart_dma_lock);
+    err = uart_dma_write((const void *) (u64_t) k->sysarg.lo, k->sysarg.hi,
+                         kernel_uart_dma_done, k);
+    kernel_lock_release(&kernel_uart_dma_lock);
 
-    if (nd->next) {
-        nd->next->prev = nd->prev;
-    } else {
-        list->tail = nd->prev;
+    if (err) {
+        frame->x[0] = 0;
+        return;
     }
 
-    nd->next = 0;
-    nd->prev = 0;
+    frame->x[0] = k->sysarg.hi;
+
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_queue_task_dma_and_update(): Task "
+                          "0x%llX waits for uart DMA.\n", task);
+
+//The transfer ends in an interrupt which is masked until the kernel is
+//done here.
+    k->tasks[task].flags |= KERNEL_TASK_FLAG_WAKEUP_UART0_TX;
+    kernel_trace_psh(&k->trace, KERNEL_TRACE_SUSPEND, task, 
+                     KERNEL_TASK_FLAG_WAKEUP_UART0_TX);
+    kernel_queue_task_node_rmv(k, task);     //Remove from queue.
+    kernel_suspend_task_node_add(k, task);   //Add to suspend list.
 }
 
-void kernel_task_node_list_validate(kernel_nd_lst *list) {
-    kernel_nd_item *cur = list->head;
-    kernel_nd_item *prev = 0;
-    u64_t i = 0;
-
-    if(list->head) {
-        if (list->tail) {
-            if (list->tail->next) {
-                uart_puts("rpi3rtos::kernel_task_node_list_validate(): "
-                        "tail->next set. Panic.\n");
-                kernel_panic();
-            }
-        } else {
-            uart_puts("rpi3rtos::kernel_task_node_list_validate(): "
-                      "Head set but not tail. Panic.\n");
-            kernel_panic();
-        }
-        if (list->head->prev) {
-            uart_puts("rpi3rtos::kernel_task_node_list_validate(): "
-                    "head->prev set. Panic.\n");
-            kernel_panic();
-        }
-    } else if(list->tail) {
-        uart_puts("rpi3rtos::kernel_task_node_list_validate(): "
-                  "Tail set but not head. Panic.\n");
-        kernel_panic();
-    }
+void kernel_queue_task_usleep_and_update(kernel *k, u64_t task) {
+    hrtimer *t = &k->tasks[task].timer;
 
-    while(cur) {
-        uart_puts("rpi3rtos::kernel_task_node_list_validate(): Task ");
-        uart_u64hex_s(cur->task);
-        uart_puts("\n");
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_queue_task_usleep_and_update(): "
+                          "Putting task 0x%llX to sleep for 0x%llX us.\n",
+                          task, k->sysarg.value);
 
-        ++i;
-        prev = cur;
-        cur  = cur->next;
-        if(cur) {
-            if (cur->prev != prev) {
-                uart_puts("rpi3rtos::kernel_task_node_list_validate(): "
-                "cur->prev does not match prev. Panic.\n");
-                kernel_panic();
-            }
-        }
+//Set absolute wakeup time in nanoseconds.
+    t->deadline = kernel_now_ns(k) + k->sysarg.value * 1000;
+    kernel_trace_psh(&k->trace, KERNEL_TRACE_SLEEP, task, k->sysarg.value);
+
+    if (hrtimer_start(&k->hrtimers, t)) {
+        LOG_PUTS(LOG_ERROR, "rpi3rtos::kernel_queue_task_usleep_and_update(): Too many timers. Panic.\n");
+        kernel_panic();
     }
 
-    uart_puts("rpi3rtos::kernel_task_node_list_validate(): List length is ");
-    uart_u64hex_s(i);
-    uart_puts("\n");
+//Update queue. Timer puts task back on the queue.
+    LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_queue_task_usleep_and_update(): Remove from queue.\n");
+    k->tasks[task].flags |= KERNEL_TASK_FLAG_SLEEPING;
+    kernel_queue_task_node_rmv(k, task);     //Remove from queue.
 }
 
 
 //*********************************************************************
-// Kernel Queue Specific Task Node Routines
-//  Implements the priority queue operations for a given data 
-//  structure. Currently a doubly linked list.
+// Kernel High Resolution Timer Routines
+//  Pending timers share the core's generic timer comparator. See 
+//  hrtimer.c.
 //*********************************************************************
 
 //
-//kernel_queue_task_node_move_front()
-// Helper function for kernel_queue_task_update(). Moves a node toward
-// the front of the queue if its priority has raised.
+//kernel_now_ns()
+// Nanoseconds since the physical counter started.
 //
-void kernel_queue_task_node_move_front(kernel *k,
-                                       kernel_nd_item *cur, 
-                                       kernel_nd_item *nd) 
-{
-//Find first node with lower priority and insert before.
-    while(1) {
-        if (cur->prev) {
-            //Keep searching.
-            cur = cur->prev;
-        } else {
-//Remove node from queue and insert at front of queue.
-            kernel_task_node_rmv(k, &k->queue, nd->task);
-            nd->next  = cur;
-            nd->prev  = 0;
-            cur->prev = nd;
-            k->queue  = nd;
-            break;
-        }
-
-        if (kernel_queue_task_node_priority_gte(k, cur->task, nd->task)) {
-//Remove node from queue and insert after cur.
-            kernel_task_node_rmv(k, &k->queue, nd->task);
-            nd->next  = cur->next;
-            nd->prev  = cur;
-            cur->next = nd;
-
-            if (nd->next) {
-                nd->next->prev = nd;
-            }
-
-            break;
-        }
-    }
+u64_t kernel_now_ns(kernel *k) {
+    return hrtimer_count_to_ns(&k->hrtimers, timer_cntp_count());
 }
 
 //
-//kernel_queue_task_node_move_back()
-// Helper function for kernel_queue_task_update(). Moves a node toward
-// the back of the queue if its priority has lowered.
+//kernel_hrtimer_program()
+// Program the comparator with the earliest pending deadline. Stop the
+// timer if nothing is pending. A deadline already in the past fires
+// immediately.
 //
-void kernel_queue_task_node_move_back(kernel *k,
-                                    kernel_nd_item *cur, 
-                                    kernel_nd_item *nd) 
-{
-//Find first node with higher priority and insert after.
-    while(1) {
-        if (cur->next) { //Keep searching.
-            cur = cur->next;
-        } else {
-//Remove node from queue and insert at end of queue.
-            kernel_task_node_rmv(k, &k->queue, nd->task);
-            nd->next = 0;
-            nd->prev = cur;
-            cur->next = nd;
-            break;
-        }
+void kernel_hrtimer_program(kernel *k) {
+    u64_t next = hrtimer_next(&k->hrtimers);
 
-        if (kernel_queue_task_node_priority_lt(k, cur->task, nd->task)) {
-//Remove node from queue and insert before cur.
-            kernel_task_node_rmv(k, &k->queue, nd->task);
-            nd->next = cur;
-            nd->prev = cur->prev;
-            cur->prev = nd;
-
-            if (nd->prev) {
-                nd->prev->next = nd;
-            } else {
-                k->queue = nd;
-            }
-            break;
-        }
+    if (HRTIMER_NEVER == next) {
+        timer_cntp_stop();
+    } else {
+        timer_cntp_set(hrtimer_ns_to_count(&k->hrtimers, next));
     }
 }
 
 //
-//kernel_queue_task_node_pos_update()
-// A change in a task priority requires updating its position in the queue.
+//kernel_hrtimer_tick()
+// Tick timer expiry. A tickless kernel works out elapsed ticks from 
+// the counter so the timer only needs to wake the kernel.
 //
-void kernel_queue_task_node_pos_update(kernel *k, u64_t task) {
-    kernel_nd_item *nd = &k->tasks[task].node;
-
-//Look toward the front of the queue.
-    if(nd->prev) {
-        if (kernel_queue_task_node_priority_lt(k, nd->prev->task, task)) {
-            //Node task priority is higher and needs to be moved up.
-            kernel_queue_task_node_move_front(k, nd->prev, nd);
-            return;
-        }
-    }
-
-//Look toward the back of the queue.
-    if (nd->next) {
-        if (kernel_queue_task_node_priority_gte(k, nd->next->task, task)) {
-            //Node task priority is lower and needs to be moved down.
-            kernel_queue_task_node_move_back(k, nd->next, nd);
-            return;
-        }
-    }
-
-//Node is still where it belongs in the queue. Nothing to do.
-    return;
+void kernel_hrtimer_tick(hrtimer *t) {
+#ifndef KERNEL_TICKLESS
+    ++kernel_get_pointer()->ticks;
+#endif
 }
 
-
-//*********************************************************************
-// Kernel Specific Task Node Routines
-//  Tasks are sorted and managed using referent nodes in data 
-//  structures. These routines provide an API of sorts to decouple the
-//  data structure from the kernel task node operation.
-//*********************************************************************
-
 //
-//kernel_[queue,suspend,sleep]_node_[add, rmv]()
-// These are helper functions to provide an api of sorts to facilitate
-// experimentation with different data structures and algorithms.
+//kernel_hrtimer_wakeup()
+// Task timer expiry. Called with interrupts disabled while a task may
+// be running so the current task is left alone. Kernel picks the new
+// current task from the queue.
 //
+void kernel_hrtimer_wakeup(hrtimer *t) {
+    kernel *k = kernel_get_pointer();
 
-//kernel_*_task_node_add
-inline void kernel_queue_task_node_add(kernel *k, u64_t task) {
-    kernel_task_node_psh(k, &k->queue, task);
-    kernel_queue_task_node_pos_update(k, task);
-    k->task = k->queue ? k->queue->task : 0; //Update current task.
-}
-
-inline void kernel_suspend_task_node_add(kernel *k, u64_t task) {
-    k->tasks[task].flags |= KERNEL_TASK_FLAG_SUSPENDED;
-    kernel_task_node_list_tail_psh(k, &k->suspend, task);
+    k->tasks[t->arg].flags &= ~KERNEL_TASK_FLAG_SLEEPING;
+    kernel_queue_psh(k, t->arg);
+    kernel_trace_psh(&k->trace, KERNEL_TRACE_WAKEUP, t->arg, 0);
+    kernel_stats_wakeup(k, t->arg);
 }
 
-inline void kernel_sleep_task_node_add(kernel *k, u64_t task) {
-    k->tasks[task].flags |= KERNEL_TASK_FLAG_SLEEPING;
-    kernel_task_node_list_tail_psh(k, &k->sleep, task);
-}
+void kernel_service_uart_rx(kernel *k) {
+    kernel_nd_item *cur = k->suspend.head;
+    u64_t task;
 
-//kernel_*_task_node_rmv
-inline void kernel_queue_task_node_rmv(kernel *k, u64_t task) {
-    kernel_task_node_rmv(k, &k->queue, task);
-    k->task = k->queue ? k->queue->task : 0; //Update current task.
-}
+    while (cur) {
+        task = cur->task;
+        cur  = cur->next;
 
-inline void kernel_suspend_task_node_rmv(kernel *k, u64_t task) {
-    k->tasks[task].flags &= ~KERNEL_TASK_FLAG_SUSPENDED;
-    kernel_task_node_list_rmv(k, &k->suspend, task);
-}
+        if (!(k->tasks[task].flags & KERNEL_TASK_FLAG_WAKEUP_UART0_RX)) {
+            continue;
+        }
 
-inline void kernel_sleep_task_node_rmv(kernel *k, u64_t task) {
-    k->tasks[task].flags &= ~KERNEL_TASK_FLAG_SLEEPING;
-    kernel_task_node_list_rmv(k, &k->sleep, task);
+//A task may be running so the current task is left alone. Task retries
+//the read when it runs.
+        k->tasks[task].flags &= ~KERNEL_TASK_FLAG_WAKEUP_UART0_RX;
+        kernel_suspend_task_node_rmv(k, task);
+        kernel_queue_psh(k, task);
+        kernel_trace_psh(&k->trace, KERNEL_TRACE_WAKEUP, task, 0);
+        kernel_stats_wakeup(k, task);
+        --k->rx_waiters;
+    }
 }
 
-//*********************************************************************
-// Kernel Queue Task Routines
-//  Helper functions remove code duplication.
-//*********************************************************************
+void kernel_service_uart_dma(kernel *k) {
+    kernel_nd_item *cur = k->suspend.head;
+    u64_t task;
 
-void kernel_queue_task_suspend_and_update(kernel *k, u64_t task) {
-    uart_puts("rpi3rtos::kernel_queue_task_suspend_and_update(): Suspending task ");
-    uart_u64hex_s(task);
-    uart_puts(". Flags: \n");
-    kernel_task_flags_print(k->sysarg.value);
+    if (!k->dma_done) {
+        return;
+    }
+    k->dma_done = 0;
 
-//Update task flags.
-    k->tasks[task].flags |= k->sysarg.value;
+    while (cur) {
+        task = cur->task;
+        cur  = cur->next;
 
-//Update queue.
-    uart_puts("rpi3rtos::kernel_queue_task_suspend_and_update(): Remove from queue.\n");
-    kernel_queue_task_node_rmv(k, task);     //Remove from queue.
-    kernel_suspend_task_node_add(k, task);   //Add to suspend list.
-    kernel_task_node_list_validate(&k->suspend);
+        if (k->tasks[task].flags & KERNEL_TASK_FLAG_WAKEUP_UART0_TX) {
+            k->tasks[task].flags &= ~KERNEL_TASK_FLAG_WAKEUP_UART0_TX;
+            kernel_suspend_task_node_rmv(k, task);
+            kernel_queue_psh(k, task);
+            kernel_trace_psh(&k->trace, KERNEL_TRACE_WAKEUP, task, 0);
+            kernel_stats_wakeup(k, task);
+        }
+    }
 }
 
-void kernel_queue_task_sleep_and_update(kernel *k, u64_t task) {
-    u64_t wakeup = (k->sysarg.value + 
-                    KERNEL_TICK_DURATION_MS - 1) /
-                    KERNEL_TICK_DURATION_MS;
+void kernel_uart_rx_irq(kernel *k) {
+    kernel *other;
+    u64_t core;
 
-    uart_puts("rpi3rtos::kernel_queue_task_sleep_and_update(): Putting task ");
-    uart_u64hex_s(task);
-    uart_puts(" to sleep for ");
-    uart_u64hex_s(k->sysarg.value);
-    uart_puts(" ms rounded up to ");
-    uart_u64hex_s(wakeup);
-    uart_puts(" ticks.\n");
+    if (!uart_rx_irq()) {
+        return;
+    }
 
-//Set wakeup time in kernel ticks.
-    k->tasks[task].wakeup = wakeup;
+    for (core = 0; core < PLATFORM_CORES; ++core) {
+        other = kernel_get_core_pointer(core);
+        if (!other || !other->rx_waiters) {
+            continue;
+        }
 
-//Update queue.
-    uart_puts("rpi3rtos::kernel_queue_task_sleep_and_update(): Remove from queue.\n");
-    kernel_queue_task_node_rmv(k, task);     //Remove from queue.
-    kernel_sleep_task_node_add(k, task);     //Add to sleep list.
+        if (other == k) {
+            kernel_service_uart_rx(k);
+        } else {
+            irq_mbox_send(core);
+        }
+    }
+}
+
+void kernel_service_hrtimers(kernel *k) {
+    u64_t now = kernel_now_ns(k);
+    hrtimer *t;
 
-    kernel_task_node_list_validate(&k->sleep);
+    while ((t = hrtimer_expired(&k->hrtimers, now))) {
+        if (t->period) {
+//Periodic. Restart relative to the old deadline to avoid drift.
+            t->deadline += t->period;
+            hrtimer_start(&k->hrtimers, t);
+        }
+        t->fn(t);
+    }
+
+    kernel_hrtimer_program(k);
 }
 
 
@@ -481,43 +352,50 @@ int kernel_init(kernel *k, u64_t num_tasks) {
     u64_t i;
     u64_t base = task_get_base_addr(0);
 
-    uart_puts("rpi3rtos::kernel_init(): Initializing kernel (");
-    uart_u64hex_s((u64_t) k);
-    uart_puts(") ");
-    uart_u64hex_s(num_tasks);
-    uart_puts(" tasks...\n");
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_init(): Initializing kernel "
+                         "(0x%llX) 0x%llX tasks...\n", (u64_t) k, num_tasks);
+
+    k->core       = platform_core();
+    k->online     = 0;
+    kernel_trace_init(&k->trace, k->core, timer_cntp_freq());
+    kernel_log_init(&k->log);
+    k->steals     = 0;
+    k->migrations = 0;
+    kernel_lock_init(&k->lock);
 
-    uart_puts("rpi3rtos::kernel_init(): g_kernel_pointer located at ");
-    uart_u64hex_s((u64_t) &g_kernel_pointer);
-    uart_puts("\n");
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_init(): g_kernel_pointer located at "
+                         "0x%llX\n", (u64_t) &g_kernel_pointer[k->core]);
 
-    g_kernel_pointer = k;
+    g_kernel_pointer[k->core] = k;
 
-    uart_puts("rpi3rtos::kernel_init(): g_kernel_pointer set to ");
-    uart_u64hex_s((u64_t) g_kernel_pointer);
-    uart_puts("\n");
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_init(): g_kernel_pointer set to "
+                         "0x%llX\n", (u64_t) g_kernel_pointer[k->core]);
 
 //Make sure there aren't more tasks then we can handle.
     if (num_tasks > KERNEL_TASKS_MAX) {
-        uart_puts("rpi3rtos::kernel_init(): Number of tasks exceeds maximum allowed. Panic.\n");
+        LOG_PUTS(LOG_ERROR, "rpi3rtos::kernel_init(): Number of tasks exceeds maximum allowed. Panic.\n");
         kernel_panic();
     } else {
         k->num_tasks = num_tasks;
     }
 
 //Set exception handlers for EL1.
-    uart_puts("rpi3rtos::kernel_init(): Set exception handler vector to ");
-    uart_u64hex_s((u64_t) __exception_vectors_start + base);
-    uart_puts("\n");
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_init(): Set exception handler "
+                         "vector to 0x%llX\n",
+                         (u64_t) __exception_vectors_start + base);
     asm volatile ("msr  vbar_el1, %0\n" :: "r"(__exception_vectors_start + base) :);
 
 //Initialize kernel specifics.
     k->task    = 0; //Reset
     k->ticks   = 0; //Reset
+    k->caller  = 0; //Reset
     k->syscall = 0; //Reset
-    k->queue   = 0; //Reset
-    k->sleep.head   = 0; //Reset
-    k->sleep.tail   = 0; //Reset
+    kernel_queue_init(&k->queue); //Reset
+    k->time    = 0; //Reset
+    k->tick_base   = 0; //Reset
+    hrtimer_base_init(&k->hrtimers, timer_cntp_freq()); //Reset
+    hrtimer_init(&k->tick, kernel_hrtimer_tick, 0);      //Reset
+    kernel_sleep_init(&k->sleep, 0); //Reset
     k->suspend.head = 0; //Reset
     k->suspend.tail = 0; //Reset
     k->sysarg.value = 0; //Reset
@@ -531,9 +409,10 @@ int kernel_init(kernel *k, u64_t num_tasks) {
     k->tasks[0].node.next = 0;
     k->tasks[0].node.prev = 0;
     k->tasks[0].node.task = 0;
+    hrtimer_init(&k->tasks[0].timer, kernel_hrtimer_wakeup, 0);
 
 //Initialize and queue non-kernel tasks.
-    uart_puts("rpi3rtos::kernel_init(): Initializing kernel task headers...\n");
+    LOG_PUTS(LOG_INFO, "rpi3rtos::kernel_init(): Initializing kernel task headers...\n");
     for (i = 1; i < k->num_tasks; ++i) {
         task_header *tskhdr   = task_get_header(i);
         k->tasks[i].header    = tskhdr;
@@ -544,22 +423,38 @@ int kernel_init(kernel *k, u64_t num_tasks) {
         k->tasks[i].node.next = 0;
         k->tasks[i].node.prev = 0;
         k->tasks[i].node.task = i;
+        hrtimer_init(&k->tasks[i].timer, kernel_hrtimer_wakeup, i);
+
+        if (kernel_task_core(i) != k->core) {
+//Task runs on another core's kernel.
+            continue;
+        }
+
         kernel_queue_task_node_add(k, i);
-        uart_puts("rpi3rtos::kernel_init(): k->task = ");
-        uart_u64hex_s(k->task);
-        uart_puts("\n");        
+        LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_init(): k->task = 0x%llX\n",
+                             k->task);
     }
-    uart_puts("rpi3rtos::kernel_init(): Kernel task headers initialized.\n");
+    LOG_PUTS(LOG_INFO, "rpi3rtos::kernel_init(): Kernel task headers initialized.\n");
+
+//FP/SIMD registers are owned by no task. First use traps.
+    kernel_fp_init(k);
+
+//Start charging CPU time to the kernel.
+    kernel_acct_init(k);
+    kernel_pmu_init(k);
+    kernel_prof_init(k);
+    kernel_lat_init(k);
+    kernel_stats_init(k);
 
 //Initialize the actual tasks themselves.
-    uart_puts("rpi3rtos::kernel_init(): Initializing tasks ");
-    uart_u64hex_s(1);
-    uart_puts("-");
-    uart_u64hex_s(k->num_tasks - 1);
-    uart_puts("...\n");
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_init(): Initializing tasks "
+                         "0x%llX-0x%llX...\n", (u64_t) 1, k->num_tasks - 1);
 
     while (k->task) {
 //Switch to task context and call init.
+        kernel_acct_switch(k, &k->tasks[k->task].runtime);
+        kernel_pmu_switch(k, k->task);
+        kernel_fp_switch(k, k->task);
         __task_context_save_and_branch (
             &k->tasks[0].sp,                        //Kernel context stack pointer saved here.
             k->tasks[k->task].sp,                   //Context set to task stack pointer. 
@@ -567,12 +462,15 @@ int kernel_init(kernel *k, u64_t num_tasks) {
         );
 
 //Execution resumes here after task->init() initializes and calls task_suspend().
+        k->task   = k->caller;
+        k->caller = 0;
+
         if(KERNEL_SYSCALL_SUSPEND == k->syscall) {
             kernel_queue_task_suspend_and_update(k, k->task);
         } else {
-            uart_puts("rpi3rtos::kernel_init(): Task made unexpected syscall ");
-            uart_u64hex_s(k->syscall);
-            uart_puts(". Panic. \n");
+            LOG_PRINTF(LOG_ERROR, "rpi3rtos::kernel_init(): Task made "
+                                  "unexpected syscall 0x%llX. Panic. \n",
+                                  k->syscall);
             kernel_panic();
         }
 
@@ -580,230 +478,247 @@ int kernel_init(kernel *k, u64_t num_tasks) {
         k->sysarg.value = 0; //Reset
     }
 
-    uart_puts("rpi3rtos::kernel_init(): Kernel tasks initialized.\n");
-    uart_puts("rpi3rtos::kernel_init(): Kernel initialized.\n");
+    LOG_PUTS(LOG_INFO, "rpi3rtos::kernel_init(): Kernel tasks initialized.\n");
+    LOG_PUTS(LOG_INFO, "rpi3rtos::kernel_init(): Kernel initialized.\n");
 
     return 0;
 }
 
-//
-//kernel_service_sleeping()
-// If pending ticks then service the sleeping tasks. Remove ready to 
-// wake tasks from the sleeping list and insert in the priority queue.
-//
-void kernel_service_sleeping(kernel *k) {
-    kernel_nd_item *cur = k->sleep.head;
-
-    while(cur) {
-        if (k->tasks[cur->task].flags & KERNEL_SYSCALL_SLEEP) {
-//Decrement task wakeup counter and check for wake up.
-            k->tasks[cur->task].wakeup -= k->ticks;
-
-            if (0 == k->tasks[cur->task].wakeup) {
-//Wake up. Remove from sleep list and add to priority queue.
-                kernel_nd_item *nd = cur;
-                cur = cur->next;
-
-                uart_puts("rpi3rtos::kernel_service_sleeping(): Task ");
-                uart_u64hex_s(nd->task);
-                uart_puts(" is ready to wake up.\n");
-//Update queue.
-                k->tasks[nd->task].flags &= ~KERNEL_TASK_FLAG_SLEEPING;
-                kernel_sleep_task_node_rmv(k, nd->task); //Remove from sleep list.
-                kernel_queue_task_node_add(k, nd->task); //Add to queue.
-                k->task = k->queue->task;                //Update current task.
-
-                kernel_task_node_list_validate(&k->sleep);
-
-                continue;
-            } else if (k->tasks[cur->task].wakeup < 0) {
-//Wake up. Remove from sleep list and add to priority queue.
-                kernel_nd_item *nd = cur;
-                cur = cur->next;
-
-                uart_puts("rpi3rtos::kernel_service_sleeping(): Task ");
-                uart_u64hex_s(cur->task);
-                uart_puts(" overslept and is ready to wake up.\n");
-//Update queue.
-                k->tasks[nd->task].flags &= ~KERNEL_TASK_FLAG_SLEEPING;
-                k->tasks[nd->task].header->flags |= TASK_HEADER_FLAG_OVERSLEPT;
-                kernel_sleep_task_node_rmv(k, nd->task); //Remove from sleep list.
-                kernel_queue_task_node_add(k, nd->task); //Add to queue.
-                k->task = k->queue->task;                //Update current task.
-
-                kernel_task_node_list_validate(&k->sleep);
-
-                continue;
-            } else {
-                uart_puts("rpi3rtos::kernel_service_sleeping(): Task ");
-                uart_u64hex_s(cur->task);
-                uart_puts(" is asleep.\n");
-            }
-        }
-        cur = cur->next;
-    }
-}
-
-//
-//kernel_service_suspended()
-// Determine if conditions exist for task resume and if appropriate 
-// resume.
-//
-void kernel_service_suspended(kernel *k) {
-    kernel_nd_item *cur = k->suspend.head;
-
-    while(cur) {
-        uart_puts("rpi3rtos::kernel_service_suspended(): Servicing suspended task ");
-        uart_u64hex_s((u64_t) cur->task);
-        uart_puts(".\n");
-        kernel_task_flags_print(k->tasks[cur->task].flags);
-
-        if (k->tasks[cur->task].flags & KERNEL_SYSCALL_SUSPEND) {
-            if (k->tasks[cur->task].flags & 
-                KERNEL_TASK_FLAG_WAKEUP_POST_INIT)
-            {
-//Suspended after init. Remove from suspend list and add to priority queue.
-                uart_puts("rpi3rtos::kernel_service_suspended(): Ready to wake up.\n");
-
-                kernel_nd_item *nd = cur;
-                cur = cur->next;
-                k->tasks[nd->task].flags &= KERNEL_TASK_FLAG_WAKEUP_CLEAR_ALL;
-//Update queue.
-                kernel_suspend_task_node_rmv(k, nd->task); //Remove from suspend list.
-                kernel_queue_task_node_add(k, nd->task);   //Add to queue.
-                k->task = k->queue->task;                  //Update current task.
-
-                kernel_task_node_list_validate(&k->suspend);
-
-                continue;
-            }
-
-            if (k->tasks[cur->task].flags & 
-                KERNEL_TASK_FLAG_WAKEUP_POST_RESET)
-            {
-//Suspended after reset. Remove from suspend list and add to priority queue.
-                uart_puts("rpi3rtos::kernel_service_suspended(): Ready to wake up.\n");
-
-                kernel_nd_item *nd = cur;
-                cur = cur->next;
-
-                k->tasks[nd->task].flags &= KERNEL_TASK_FLAG_WAKEUP_CLEAR_ALL;
-//Update queue.
-                kernel_suspend_task_node_rmv(k, nd->task); //Remove from suspend list.
-                kernel_queue_task_node_add(k, nd->task);   //Add to queue.
-                k->task = k->queue->task;                  //Update current task.
-
-                kernel_task_node_list_validate(&k->suspend);
-
-                continue;
-            }
-        }
-        cur = cur->next;
-    }
-}
-
 void kernel_service_syscall(kernel *k) {
+    u64_t task = k->task;
+
     switch(k->syscall) {
         case 0: //No pending syscall. Done.
         break;
 
         case KERNEL_SYSCALL_SLEEP:
-            uart_puts("rpi3rtos::kernel_service_syscall(): Task ");
-            uart_u64hex_s(k->task);
-            uart_puts(" is requesting sleep...\n");
+            LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_service_syscall(): Task "
+                                  "0x%llX is requesting sleep...\n", k->task);
             kernel_queue_task_sleep_and_update(k, k->task);
         break;
 
+        case KERNEL_SYSCALL_USLEEP:
+            LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_service_syscall(): Task "
+                                  "0x%llX is requesting usleep...\n", k->task);
+            kernel_queue_task_usleep_and_update(k, k->task);
+        break;
+
         case KERNEL_SYSCALL_SUSPEND:
-            uart_puts("rpi3rtos::kernel_service_syscall(): Task ");
-            uart_u64hex_s(k->task);
-            uart_puts(" is requesting suspend...\n");
+            LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_service_syscall(): Task "
+                                  "0x%llX is requesting suspend...\n", k->task);
             kernel_queue_task_suspend_and_update(k, k->task);
         break;
 
         case KERNEL_SYSCALL_PRIORITY:
-            uart_puts("rpi3rtos::kernel_service_syscall(): Task ");
-            uart_u64hex_s(k->task);
-            uart_puts(" is requesting a priority change...\n");
-
-            uart_puts("rpi3rtos::kernel_service_syscall(): Change priority from ");
-            uart_u64hex_s(k->tasks[k->task].priority);
-            uart_puts(" to ");
-            uart_u64hex_s(k->sysarg.value);
-            uart_puts(".\n");
-
-            if (k->sysarg.lo) {
-                if (k->tasks[k->task].priority != k->sysarg.lo) {
-//Change task priority.
-                    uart_puts("rpi3rtos::kernel_service_syscall(): Update priority in queue.\n");
-                    k->tasks[k->task].priority = (u64_t) k->sysarg.lo;
-                    kernel_queue_task_node_pos_update(k, k->task);
-                    k->task = k->queue->task;
-                }
-            }
+            LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_service_syscall(): Task "
+                                  "0x%llX is requesting a priority change...\n",
+                                  k->task);
+            kernel_queue_task_priority_and_update(k, k->task);
+        break;
 
-            if (k->sysarg.hi) {
-//Change task queue options.
-                k->tasks[k->task].flags &= KERNEL_TASK_FLAG_QUEUE_CLEAR_ALL;
-                k->tasks[k->task].flags |= k->sysarg.hi;
-            }
+        case KERNEL_SYSCALL_TRACE_DUMP:
+            kernel_trace_dump(&k->trace);
+        break;
+
+        case KERNEL_SYSCALL_PROF_DUMP:
+            kernel_prof_dump(k);
+        break;
+
+        case KERNEL_SYSCALL_LATENCY_DUMP:
+            kernel_lat_dump(k);
+        break;
+
+        case KERNEL_SYSCALL_READ:
+            kernel_queue_task_read_and_update(k, k->task);
+            k->task = kernel_queue_first(k);
+        break;
+
+        case KERNEL_SYSCALL_WRITE_DMA:
+            kernel_queue_task_dma_and_update(k, k->task);
+            k->task = kernel_queue_first(k);
+        break;
+
+        case KERNEL_SYSCALL_YIELD:
+            kernel_queue_task_yield_and_update(k, k->task);
         break;
 
         default:
-            uart_puts("rpi3rtos::kernel_service_syscall(): Task ");
-            uart_u64hex_s(k->task);
-            uart_puts(" requested unrecognized syscall ");
-            uart_u64hex_s(k->syscall);            
-            uart_puts("Panic.\n");
+            LOG_PRINTF(LOG_ERROR, "rpi3rtos::kernel_service_syscall(): Task "
+                                  "0x%llX requested unrecognized syscall "
+                                  "0x%llXPanic.\n", k->task, k->syscall);
             kernel_panic();
         break;
     };
 
+    if (k->syscall) {
+        kernel_trace_psh(&k->trace, KERNEL_TRACE_SYSCALL_EXIT, task, k->syscall);
+    }
+
 //Clear syscall.
     k->syscall = 0;
     k->sysarg.value = 0;
 }
 
-void kernel_service_tick(kernel *k) {
-//Update current task. If no tasks on queue then current is kernel.
-    if (k->queue) {
-        if (k->queue->task == k->task) {
-            if (k->tasks[k->queue->task].flags & 
-                KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN) 
-            {
-//This should move the current task to the back of the list of tasks
-//with the same priority. Easy way to do round-robin prioritizing.
-                kernel_queue_task_node_pos_update(k, k->task);
-            }
-        }
-        k->task = k->queue->task;
-    } else {
-        k->task = 0;
+
+#ifdef KERNEL_TICKLESS
+//
+//kernel_tickless_elapsed()
+// A tickless kernel has no periodic interrupt. Add the number of whole
+// ticks that have passed since the start of the current tick.
+//
+void kernel_tickless_elapsed(kernel *k) {
+    u64_t ticks = (kernel_now_ns(k) - k->tick_base) / KERNEL_TICK_DURATION_NS;
+    k->ticks     += ticks;
+    k->tick_base += ticks * KERNEL_TICK_DURATION_NS;
+}
+
+//
+//kernel_tickless_program()
+// Start the one shot tick timer for the next event. This is either the 
+// earliest sleeping task expiry or the end of the running task's slice
+// if it is round-robin and shares its priority. Without an event the
+// timer is stopped.
+//
+void kernel_tickless_program(kernel *k) {
+    u64_t next = kernel_sleep_next(k);
+
+    if (k->task && 
+        (k->tasks[k->task].flags & KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN) &&
+        kernel_queue_has_peer(k, k->task))
+    {
+        next = k->time + 1;
+    }
+
+    if (!k->task && KERNEL_CORES > 1) {
+//Idle. Wake up every tick to look for tasks to steal.
+        next = k->time + 1;
+    }
+
+//Suspended tasks which only wait for the kernel to run.
+    if (kernel_suspend_wakeable(k)) {
+        next = k->time + 1;
+    }
+
+    if (KERNEL_SLEEP_NEVER == next) {
+        hrtimer_cancel(&k->hrtimers, &k->tick);
+        return;
+    }
+
+    if (next <= k->time) {
+        next = k->time + 1;
     }
+
+    k->tick.deadline = k->tick_base + (next - k->time) * KERNEL_TICK_DURATION_NS;
+    hrtimer_start(&k->hrtimers, &k->tick);
 }
+#endif
+
+kernel_switch kernel_schedule(kernel *k) {
+    kernel_switch sw = { 0, 0 };
+    u64_t cur = k->task;
+    u64_t next;
+
+    if (k->syscall) {
+//Blocking syscall. Defer to kernel. A kernel interrupted before it
+//serviced the syscall just resumes.
+        if (cur) {
+            kernel_trace_psh(&k->trace, KERNEL_TRACE_SWITCH, cur, 0);
+            kernel_acct_switch(k, &k->tasks[0].runtime);
+            kernel_pmu_switch(k, 0);
+            kernel_stats_switch_out(k, cur, KERNEL_STATS_KERNEL);
+            k->caller   = cur;
+            k->task     = 0;
+            sw.sp_saved = &k->tasks[cur].sp;
+            sw.sp_new   = k->tasks[0].sp;
+//Not stealable until the exception stub stores the stack pointer.
+            k->tasks[cur].sp = 0;
+        }
+        return sw;
+    }
+
+#ifdef KERNEL_TICKLESS
+    kernel_tickless_elapsed(k);
+#endif
+
+    if (k->ticks > 0) {
+        k->time += k->ticks;
+//Tasks suspended after init or reset wake on the next tick even if no
+//task enters the kernel. The running task stays current for the tick.
+        kernel_service_suspended(k);
+        k->task = cur;
+        kernel_service_sleeping(k);
+        kernel_service_tick(k);
+        k->ticks = 0;
+//Fold in event counts at least once a tick so 32 bit counters can not
+//wrap unseen.
+        kernel_pmu_switch(k, cur);
+        kernel_acct_service(k);
+    }
+
+//Timers may have woken tasks. Pick highest priority. None ready means
+//kernel which waits for interrupts.
+    next    = kernel_queue_first(k);
+    k->task = next;
+
+#ifdef KERNEL_TICKLESS
+    kernel_tickless_program(k);
+#endif
+    kernel_hrtimer_program(k);
+
+    if (next != cur) {
+        LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_schedule(): Switch from task "
+                              "0x%llX to task 0x%llX.\n", cur, next);
+
+        kernel_trace_psh(&k->trace, KERNEL_TRACE_SWITCH, cur, next);
+        kernel_acct_switch(k, &k->tasks[next].runtime);
+        kernel_pmu_switch(k, next);
+        kernel_stats_switch_out(k, cur, KERNEL_STATS_INVOLUNTARY);
+        kernel_stats_switch_in(k, next);
+        kernel_fp_switch(k, next);
+        sw.sp_saved = &k->tasks[cur].sp;
+        sw.sp_new   = k->tasks[next].sp;
+//The lock is released before the exception stub stores the stack 
+//pointer. Other cores must not steal the task until then.
+        k->tasks[cur].sp = 0;
+    }
 
+    return sw;
+}
 
 void kernel_main(kernel *k) {
     u64_t base = task_get_base_addr(0);
+    u64_t caller;
 
-    uart_puts("rpi3rtos::kernel_main(): Entering kernel_main(");
-    uart_u64hex_s((u64_t) k);
-    uart_puts(").\n");
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_main(): Entering "
+                         "kernel_main(0x%llX).\n", (u64_t) k);
 
 //Set exception handlers for EL1 in hardware.
-    uart_puts("rpi3rtos::kernel_main(): Rebased __exception_vectors_start: ");
-    uart_u64hex_s((u64_t) __exception_vectors_start + base);
-    uart_puts("\n");
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_main(): Rebased "
+                         "__exception_vectors_start: 0x%llX\n",
+                         (u64_t) __exception_vectors_start + base);
     asm volatile ("msr  vbar_el1, %0\n" :: "r"(__exception_vectors_start + base) :);
 
 //Set hardware timer for time slices.
-    uart_puts("rpi3rtos::kernel_main(): Setting slice timer...\n");
+    LOG_PUTS(LOG_INFO, "rpi3rtos::kernel_main(): Setting slice timer...\n");
     irq_disable();
-    timer_init_core0(KERNEL_TICK_DURATION_MS);
+    timer_init_cntp_core(k->core);
+    k->tick_base = kernel_now_ns(k);
+#ifndef KERNEL_TICKLESS
+//Periodic tick.
+    k->tick.period   = KERNEL_TICK_DURATION_NS;
+    k->tick.deadline = k->tick_base + KERNEL_TICK_DURATION_NS;
+    hrtimer_start(&k->hrtimers, &k->tick);
+#endif
+    kernel_hrtimer_program(k);
+//Mailbox interrupt wakes tasks waiting for uart data.
+    irq_mbox_enable(k->core);
     irq_enable();
 
-    uart_puts("rpi3rtos::kernel_main(): Done setting slice timer.\n");
-    uart_puts("rpi3rtos::kernel_main(): Entering main kernel loop.\n");
+//Other cores may steal queued tasks from now on.
+    k->online = 1;
+
+    LOG_PUTS(LOG_INFO, "rpi3rtos::kernel_main(): Done setting slice timer.\n");
+    LOG_PUTS(LOG_INFO, "rpi3rtos::kernel_main(): Entering main kernel loop.\n");
 
 //Main kernel loop.
     while(1) {
@@ -814,35 +729,96 @@ void kernel_main(kernel *k) {
 
 //Enter critical section.
         irq_disable();
+        kernel_lock_acquire(&k->lock);
+
+//Kernel is servicing tasks. Charge task0.
+        kernel_acct_switch(k, &k->tasks[0].runtime);
+        kernel_pmu_switch(k, 0);
+
+//Exception handlers leave k->task at 0 while the kernel runs. Restore
+//the task which entered the kernel.
+        k->task   = k->caller;
+        k->caller = 0;
+        caller    = k->task;
+
+#ifdef KERNEL_TICKLESS
+//No periodic tick. Work out elapsed ticks from the counter.
+        kernel_tickless_elapsed(k);
+#endif
 
 //Service the suspended tasks.
         kernel_service_suspended(k);
 
         if (k->ticks > 0) {
+            k->time += k->ticks;
 //Always service sleeping before syscalls to avoid premature wakeups.
             kernel_service_sleeping(k);
 //Tick has elapsed. Service priority queue.
             kernel_service_tick(k);
 //Reset tick counter.
             k->ticks = 0;
+//Print CPU time summary when due.
+            kernel_acct_service(k);
         }
 
 //Handle pending syscalls (Suspend, Sleep, Priority, Wakeup)
         kernel_service_syscall(k);
 
-        irq_enable();
-//Left critical section.
+#ifdef KERNEL_TICKLESS
+//Start the tick timer for the next event.
+        kernel_tickless_program(k);
+#endif
 
-        if (k->task) {
-//Switch to currently running task.
-            uart_puts("rpi3rtos::kernel_main(): Resume task ");
-            uart_u64hex_s(k->task);
-            uart_puts(".\n");
+//Timers may have been started or cancelled.
+        kernel_hrtimer_program(k);
 
+//Timer interrupts may have woken tasks. Run the highest priority task.
+        k->task = kernel_queue_first(k);
+
+//Caller blocked or yielded in its syscall.
+        if (caller && caller != k->task) {
+            kernel_stats_switch_out(k, caller, KERNEL_STATS_VOLUNTARY);
+        }
+
+        if (k->task) {
+//Switch to currently running task. Interrupts are enabled when the
+//task context is restored so the kernel can not be interrupted while
+//k->task names a task that is not running yet.
+            LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_main(): Resume task "
+                                  "0x%llX.\n", k->task);
+
+            kernel_trace_psh(&k->trace, KERNEL_TRACE_SWITCH, 0, k->task);
+            kernel_acct_switch(k, &k->tasks[k->task].runtime);
+            kernel_pmu_switch(k, k->task);
+            kernel_stats_switch_in(k, k->task);
+            kernel_fp_switch(k, k->task);
+            kernel_lock_release(&k->lock);
             __task_context_save_and_switch (
                 &k->tasks[0].sp,      //Kernel context stack pointer saved here.
                 k->tasks[k->task].sp  //Context set to task stack pointer. 
             );
+        } else {
+            kernel_lock_release(&k->lock);
+
+//Nothing to run. Take work from a busier core.
+            if (kernel_steal(k)) {
+                continue;
+            }
+
+//Print a log record with interrupts enabled so a woken task runs 
+//straight away. The kernel resumes here when next entered.
+            if (kernel_log_pending(&k->log)) {
+                irq_enable();
+                kernel_log_drain(&k->log);
+                continue;
+            }
+
+//Still nothing. Sleep until an interrupt. WFI wakes up on a pending 
+//interrupt even while interrupts are masked so none are missed.
+            kernel_acct_switch(k, &k->idle_time);
+            asm volatile ("wfi\n");
+            irq_enable();
+//Left critical section. Pending interrupt is taken here.
         }
    }
 }
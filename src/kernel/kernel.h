@@ -27,6 +27,24 @@
 
 #include "platform.h"
 #include "task.h"
+#include "hrtimer.h"
+#include "trace.h"
+
+//
+//KERNEL_CORES
+// Number of cores running tasks. Build with KERNEL_CORES=1 to run all
+// tasks on core 0.
+//
+#ifndef KERNEL_CORES
+#define KERNEL_CORES PLATFORM_CORES
+#endif
+
+//
+//KERNEL_CORE_STACK_SZ
+// Size of each core's kernel stack. Core N's stack starts at task0's
+// base address minus N times the size.
+//
+#define KERNEL_CORE_STACK_SZ 0x40000
 
 //
 //KERNEL_TICK_DURATION_MS
@@ -34,11 +52,137 @@
 //
 #define KERNEL_TICK_DURATION_MS 1000 //FIXME: One second for debugging.
 
+//
+//KERNEL_TICK_DURATION_NS
+// The duration of one tick in nanoseconds.
+//
+#define KERNEL_TICK_DURATION_NS (KERNEL_TICK_DURATION_MS * 1000000ULL)
+
+//
+//KERNEL_TICKLESS
+// Defined when building a tickless kernel (make KERNEL_TICKLESS=1).
+// There is no periodic tick. The tick timer is started one shot for 
+// the next event which is either the earliest sleeping task expiry or
+// the end of a round-robin slice. Elapsed ticks are worked out from the
+// physical counter whenever the kernel runs.
+//
+
+//
+//KERNEL_ACCT_SUMMARY_TICKS
+// Ticks between printing CPU time summaries. 0 never prints.
+//
+#ifndef KERNEL_ACCT_SUMMARY_TICKS
+#define KERNEL_ACCT_SUMMARY_TICKS 10
+#endif
+
+//
+//KERNEL_PMU
+// Defined when building with per task PMU counters (make KERNEL_PMU=1).
+// The cycle counter and KERNEL_PMU_EVENTS event counters are charged
+// to the running task at every switch. See pmu.c.
+//
+
+//
+//KERNEL_PMU_EVENT_*
+// Cortex-A53 PMU event numbers counted by event counters 0-5. Override
+// on the make command line to count other events, for example
+// make KERNEL_PMU=1 KERNEL_PMU_EVENT_1=0x04 (L1D_CACHE).
+//
+#ifndef KERNEL_PMU_EVENT_0
+#define KERNEL_PMU_EVENT_0 0x08 //INST_RETIRED
+#endif
+#ifndef KERNEL_PMU_EVENT_1
+#define KERNEL_PMU_EVENT_1 0x03 //L1D_CACHE_REFILL
+#endif
+#ifndef KERNEL_PMU_EVENT_2
+#define KERNEL_PMU_EVENT_2 0x17 //L2D_CACHE_REFILL
+#endif
+#ifndef KERNEL_PMU_EVENT_3
+#define KERNEL_PMU_EVENT_3 0x10 //BR_MIS_PRED
+#endif
+#ifndef KERNEL_PMU_EVENT_4
+#define KERNEL_PMU_EVENT_4 0xE1 //Cycles stalled on instruction cache misses.
+#endif
+#ifndef KERNEL_PMU_EVENT_5
+#define KERNEL_PMU_EVENT_5 0xE7 //Cycles stalled on data load misses.
+#endif
+
+//
+//KERNEL_PMU_EVENTS
+// Number of event counters used. The Cortex-A53 has six.
+//
+#define KERNEL_PMU_EVENTS 6
+
+//
+//KERNEL_PROF
+// Defined when building the sampling profiler (make KERNEL_PROF=1).
+// The cycle counter interrupts every KERNEL_PROF_PERIOD cycles and the
+// interrupted PC is counted in a histogram of the running task. See
+// prof.c and tools/prof.
+//
+
+//
+//KERNEL_PROF_PERIOD
+// Cycles between samples. Prime so sampling does not lock on to loops
+// of the same period.
+//
+#ifndef KERNEL_PROF_PERIOD
+#define KERNEL_PROF_PERIOD 1000003
+#endif
+
+//
+//KERNEL_PROF_BUCKETS
+// Histogram buckets per task. Each bucket covers the task's code size
+// divided by this rounded up to a power of two, at least 4 bytes.
+//
+#ifndef KERNEL_PROF_BUCKETS
+#define KERNEL_PROF_BUCKETS 512
+#endif
+
+//
+//KERNEL_LOG_RECORDS
+// Number of records in each core's log ring. Must be a power of two.
+//
+#ifndef KERNEL_LOG_RECORDS
+#define KERNEL_LOG_RECORDS 64
+#endif
+
+//
+//KERNEL_LOG_TEXT
+// Bytes of text in a log record. Longer messages continue in the next
+// record.
+//
+#define KERNEL_LOG_TEXT 48
+
 //
 //KERNEL_TASKS_MAX
-// Maximum number of tasks kernel can handle.
+// Maximum number of tasks kernel can handle. Host builds of the kernel
+// data structures (tools/bench) override this to test scaling.
 //
+#ifndef KERNEL_TASKS_MAX
 #define KERNEL_TASKS_MAX 8
+#endif
+
+//
+//KERNEL_QUEUE_LEVELS
+// Number of priority levels in the ready queue. Each level has a bit
+// in the queue bitmap so this can not be more than 64. Task priorities
+// outside of 0..KERNEL_QUEUE_LEVELS-1 are clamped.
+//
+#define KERNEL_QUEUE_LEVELS 64
+
+//
+//KERNEL_SLEEP_SLOTS
+// Number of slots in the sleep timer wheel. Must be a power of two.
+// Sleeping tasks are hashed into a slot by the tick they expire on.
+//
+#define KERNEL_SLEEP_SLOTS 256
+
+//
+//KERNEL_SLEEP_NEVER
+// Returned by kernel_sleep_next() when no tasks are sleeping.
+//
+#define KERNEL_SLEEP_NEVER 0xFFFFFFFFFFFFFFFF
 
 //*********************************************************************
 //
@@ -60,6 +204,13 @@
 //
 #define KERNEL_TASK_FLAG_SLEEPING (0x1 << 1)
 
+//
+//KERNEL_TASK_FLAG_FP_USED
+// Task has used floating point or SIMD registers. Its FP state is 
+// saved and restored.
+//
+#define KERNEL_TASK_FLAG_FP_USED (0x1 << 6)
+
 //*********************************************************************
 //
 //KERNEL_TASK_FLAG_WAKEUP_*
@@ -87,8 +238,10 @@
 //KERNEL_TASK_FLAG_WAKEUP_CLEAR_ALL
 // Logical and to clear all wakeup flags.
 //
-#define KERNEL_TASK_FLAG_WAKEUP_CLEAR_ALL (~(KERNEL_TASK_FLAG_WAKEUP_POST_INIT & \
-                                             KERNEL_TASK_FLAG_WAKEUP_POST_RESET))
+#define KERNEL_TASK_FLAG_WAKEUP_CLEAR_ALL (~(KERNEL_TASK_FLAG_WAKEUP_POST_INIT | \
+                                             KERNEL_TASK_FLAG_WAKEUP_POST_RESET | \
+                                             KERNEL_TASK_FLAG_WAKEUP_UART0_RX | \
+                                             KERNEL_TASK_FLAG_WAKEUP_UART0_TX))
 
 //*********************************************************************
 //
@@ -117,7 +270,7 @@
 //KERNEL_TASK_FLAG_QUEUE_CLEAR_ALL
 // Logical and to clear all queue flags.
 //
-#define KERNEL_TASK_FLAG_QUEUE_CLEAR_ALL (~(KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN & \
+#define KERNEL_TASK_FLAG_QUEUE_CLEAR_ALL (~(KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN | \
                                             KERNEL_TASK_FLAG_QUEUE_FIFO))
 
 
@@ -126,10 +279,18 @@
 //FIXME: these sources be serviced by privileged driver tasks instead 
 //FIXME: of the kernel?
 //
-// If UART0 (PLO11) received data wake task up.
+//KERNEL_TASK_FLAG_WAKEUP_UART0_RX
+// If UART0 (PLO11) received data wake task up. Set by 
+// KERNEL_SYSCALL_READ while the receive ring is empty.
+//
+#define KERNEL_TASK_FLAG_WAKEUP_UART0_RX (0x1 << 7)
+
 //
-//#define KERNEL_TASK_FLAG_WAKEUP_UART0_RX (0x2)
+//KERNEL_TASK_FLAG_WAKEUP_UART0_TX
+// If UART0 (PLO11) finished sending a DMA transfer wake task up. Set by
+// KERNEL_SYSCALL_WRITE_DMA.
 //
+#define KERNEL_TASK_FLAG_WAKEUP_UART0_TX (0x1 << 8)
 
 
 //*********************************************************************
@@ -169,6 +330,156 @@
 //
 #define KERNEL_SYSCALL_PRIORITY   0x3
 
+//
+//KERNEL_SYSCALL_USLEEP
+// Suspend task for a period of time in microseconds. Uses a high 
+// resolution timer rather than kernel ticks.
+//
+// x0 Contains the number of microseconds.
+//
+#define KERNEL_SYSCALL_USLEEP     0x4
+
+//
+//KERNEL_SYSCALL_TIME
+// Get time. Never blocks.
+//
+// Returns nanoseconds since the counter started in x0.
+//
+#define KERNEL_SYSCALL_TIME       0x5
+
+//
+//KERNEL_SYSCALL_TASK_ID
+// Get the id of the calling task. Never blocks.
+//
+// Returns task id in x0.
+//
+#define KERNEL_SYSCALL_TASK_ID    0x6
+
+//
+//KERNEL_SYSCALL_YIELD
+// Move the calling task behind tasks of the same priority. Returns
+// without a switch if no task of the same priority is ready.
+//
+#define KERNEL_SYSCALL_YIELD      0x7
+
+//
+//KERNEL_SYSCALL_TRACE_DUMP
+// Print the trace ring of the caller's core over the uart.
+//
+#define KERNEL_SYSCALL_TRACE_DUMP 0x8
+
+//
+//KERNEL_SYSCALL_CPU_TIME
+// Get CPU time consumed in nanoseconds. Never blocks.
+//
+// x0 Task id or one of the KERNEL_CPU_TIME_* values. Task 0 is time 
+//    the kernel spent servicing tasks.
+//
+// Returns nanoseconds in x0.
+//
+#define KERNEL_SYSCALL_CPU_TIME   0x9
+
+//
+//KERNEL_SYSCALL_LOG
+// Append a message to the log ring of the caller's core. Never blocks.
+// The message is dropped if the ring is full.
+//
+// x0 Address of a null terminated string.
+//
+#define KERNEL_SYSCALL_LOG        0xA
+
+//
+//KERNEL_SYSCALL_READ
+// Copy received UART0 bytes to a buffer. Suspends the caller until at
+// least one byte has been received.
+//
+// x0 bits [31..0]  Contain the buffer address.
+//    bits [63..32] Contain the buffer length.
+//
+// Returns the number of bytes copied in x0.
+//
+#define KERNEL_SYSCALL_READ       0xB
+
+//
+//KERNEL_SYSCALL_WRITE_DMA
+// Send a buffer over UART0 by DMA. Suspends the caller until the 
+// buffer has been sent. Other tasks run meanwhile.
+//
+// x0 bits [31..0]  Contain the buffer address.
+//    bits [63..32] Contain the buffer length. At most UART_DMA_MAX.
+//
+// Returns the number of bytes sent in x0. 0 if DMA was busy.
+//
+#define KERNEL_SYSCALL_WRITE_DMA  0xC
+
+//
+//KERNEL_SYSCALL_PMU
+// Get a PMU count of a task. Never blocks. Counts are 0 unless the
+// kernel was built with KERNEL_PMU.
+//
+// x0 bits [31..0]  Contain the task id. Task 0 is the kernel.
+//    bits [63..32] Contain one of the KERNEL_PMU_* counters.
+//
+// Returns the count in x0.
+//
+#define KERNEL_SYSCALL_PMU        0xD
+
+//
+//KERNEL_SYSCALL_PROF_DUMP
+// Print the profile histograms of the caller's core over the uart.
+//
+#define KERNEL_SYSCALL_PROF_DUMP  0xE
+
+//
+//KERNEL_SYSCALL_LATENCY
+// Get a wakeup latency percentile of a task. Never blocks.
+//
+// x0 bits [31..0]  Contain the task id.
+//    bits [63..32] Contain the percentile in tenths of a percent. 990
+//                  is p99 and 999 is p99.9. 1000 gets the longest 
+//                  latency and 0 the number of wakeups measured.
+//
+// Returns nanoseconds in x0. Upper bound of the histogram bucket
+// holding the percentile.
+//
+#define KERNEL_SYSCALL_LATENCY    0xF
+
+//
+//KERNEL_SYSCALL_LATENCY_DUMP
+// Print the wakeup latency histograms of the caller's core over the 
+// uart.
+//
+#define KERNEL_SYSCALL_LATENCY_DUMP 0x10
+
+//
+//KERNEL_SYSCALL_MAX
+// One past the highest syscall number.
+//
+#define KERNEL_SYSCALL_MAX        0x11
+
+//
+//KERNEL_CPU_TIME_*
+// Arguments to KERNEL_SYSCALL_CPU_TIME other than task ids. Apply to
+// the core of the calling task.
+//
+#define KERNEL_CPU_TIME_IRQ       0x10000 //Time in interrupt handlers.
+#define KERNEL_CPU_TIME_IDLE      0x10001 //Time waiting for interrupts.
+#define KERNEL_CPU_TIME_WALL      0x10002 //Time since accounting started.
+
+//
+//KERNEL_PMU_*
+// Counters for KERNEL_SYSCALL_PMU. Event counters count the events in
+// KERNEL_PMU_EVENT_0-5, which default to the ones named here.
+//
+#define KERNEL_PMU_CYCLES         0x0 //Processor cycles.
+#define KERNEL_PMU_INSTRUCTIONS   0x1 //Instructions retired.
+#define KERNEL_PMU_L1D_REFILLS    0x2 //L1 data cache refills.
+#define KERNEL_PMU_L2D_REFILLS    0x3 //L2 cache refills.
+#define KERNEL_PMU_BRANCH_MISSES  0x4 //Mispredicted branches.
+#define KERNEL_PMU_FETCH_STALLS   0x5 //Cycles stalled on instruction cache misses.
+#define KERNEL_PMU_LOAD_STALLS    0x6 //Cycles stalled on data load misses.
+#define KERNEL_PMU_COUNTERS       (1 + KERNEL_PMU_EVENTS)
+
 //
 //kernel_nd_item{}
 // Data structure representing items in a linked list or nodes in a
@@ -200,6 +511,30 @@ typedef struct _kernel_nd_lst {
     kernel_nd_item *tail;
 } kernel_nd_lst;
 
+//
+//kernel_queue{}
+// Ready queue. Each priority level is a FIFO of ready tasks. A bit is
+// set in the bitmap for every level which is not empty so the highest
+// priority ready task is found with a single count leading zeros.
+//
+typedef struct _kernel_queue {
+    u64_t bitmap;                              //Bit N set if level N not empty.
+    u64_t count;                               //Number of ready tasks.
+    kernel_nd_lst levels[KERNEL_QUEUE_LEVELS]; //FIFO for each priority level.
+} kernel_queue;
+
+//
+//kernel_sleep{}
+// Sleep timer wheel. Sleeping tasks are hashed on their absolute
+// expiry tick into one of the slots. Each slot is kept sorted by
+// expiry so servicing a tick only looks at tasks which expire.
+//
+typedef struct _kernel_sleep {
+    u64_t time;                              //Next tick to be serviced.
+    u64_t count;                             //Number of sleeping tasks.
+    kernel_nd_lst slots[KERNEL_SLEEP_SLOTS]; //Sorted by expiry.
+} kernel_sleep;
+
 //
 //kernel_sysarg{}
 // Arguments to syscalls may only need to be 32bits.
@@ -214,6 +549,129 @@ typedef struct _kernel_sysarg {
     };
 } kernel_sysarg;
 
+//
+//kernel_fp{}
+// Floating point and SIMD register state. Only saved when another task
+// uses the registers. Aligned for 128 bit loads and stores.
+//
+typedef struct _kernel_fp {
+    u64_t q[64];  //V0-V31. Two words each.
+    u64_t fpcr;   //Floating point control register.
+    u64_t fpsr;   //Floating point status register.
+} __attribute__ ((aligned (16))) kernel_fp;
+
+//
+//kernel_lock{}
+// Lamport's bakery lock shared between cores. Uses plain loads and 
+// stores so it works with the MMU and caches off where exclusive 
+// load/store instructions are not reliable.
+//
+typedef struct _kernel_lock {
+    volatile u64_t choosing[PLATFORM_CORES]; //Non-zero while core takes a ticket.
+    volatile u64_t ticket[PLATFORM_CORES];   //Non-zero while core waits or holds.
+} kernel_lock;
+
+//
+//kernel_log_record{}
+// Part of a log message. 64 bytes.
+//
+typedef struct _kernel_log_record {
+    u64_t time;                 //Counter value when message was started.
+    u16_t task;                 //Task which logged. 0 is kernel.
+    u16_t len;                  //Bytes of text.
+    u32_t cont;                 //Non-zero if continues previous record.
+    c8_t text[KERNEL_LOG_TEXT]; //Not null terminated.
+} kernel_log_record;
+
+//
+//kernel_log{}
+// Ring of log records for one core. Written by any code on the core
+// with interrupts masked and drained by the core's kernel when idle so
+// no locks are needed. Records are committed at the end of a line.
+//
+typedef struct _kernel_log {
+    volatile u64_t head; //Records committed.
+    volatile u64_t tail; //Records drained.
+    u64_t drops;         //Messages dropped because the ring was full.
+    u64_t dropping;      //Non-zero while the rest of a message is dropped.
+    u64_t partial;       //Non-zero if the last commit did not end a line.
+    u64_t drops_shown;   //Drops already reported.
+    u64_t tx_drops_shown; //uart_tx_drops() already reported.
+    u64_t bin_time;      //Counter at the last binary frame. 0 after a drop.
+    kernel_log_record recs[KERNEL_LOG_RECORDS];
+} kernel_log;
+
+//
+//KERNEL_LAT_SUB
+// Wakeup latency histogram buckets per power of two nanoseconds. Each
+// bucket is at most a quarter of its lower bound wide.
+//
+#define KERNEL_LAT_SUB     4
+
+//
+//KERNEL_LAT_BUCKETS
+// Wakeup latency histogram buckets per task. Covers up to 2^33ns. The
+// last bucket also counts anything longer.
+//
+#define KERNEL_LAT_BUCKETS (32 * KERNEL_LAT_SUB)
+
+//
+//KERNEL_STATS_MAGIC
+// First word of the statistics page. ASCII 'STAT'.
+//
+#define KERNEL_STATS_MAGIC 0x54415453
+
+//
+//KERNEL_STATS_*
+// Why a task was switched out. See kernel_stats_switch_out().
+//
+#define KERNEL_STATS_KERNEL      0 //Entered the kernel. Not a switch yet.
+#define KERNEL_STATS_VOLUNTARY   1 //Gave up the CPU in a blocking syscall.
+#define KERNEL_STATS_INVOLUNTARY 2 //Preempted by an interrupt.
+
+//
+//kernel_stats_task{}
+// Statistics of one task in the statistics page.
+//
+typedef struct _kernel_stats_task {
+    u64_t voluntary;   //Switches out in a blocking syscall.
+    u64_t involuntary; //Switches out because it was preempted.
+    u64_t syscalls;    //Syscalls made, fast or blocking.
+    u64_t runtime;     //Nanoseconds run up to the last switch out.
+    u64_t latency;     //Nanoseconds from the last wakeup until it ran.
+    u64_t core;        //Core it last ran on.
+} kernel_stats_task;
+
+//
+//kernel_stats_core{}
+// Statistics of one core in the statistics page.
+//
+typedef struct _kernel_stats_core {
+    u64_t irqs;        //IRQs taken.
+    u64_t ready;       //Tasks in the ready queue at the last switch.
+} kernel_stats_core;
+
+//
+//kernel_stats{}
+// Statistics page. One 4kB page updated in place by the kernels of all
+// cores and read by tasks without a syscall. Every field is written 
+// with a single 64 bit store so a reader never sees half a value but
+// fields may be from different moments. See stats.c.
+//
+typedef struct _kernel_stats {
+    u64_t magic;                              //KERNEL_STATS_MAGIC
+    u64_t num_tasks;                          //Entries used in tasks[].
+    u64_t num_cores;                          //Entries in cores[].
+    kernel_stats_core cores[PLATFORM_CORES];  //Indexed by core.
+    kernel_stats_task tasks[KERNEL_TASKS_MAX]; //Indexed by task.
+} __attribute__((aligned(4096))) kernel_stats;
+
+//
+//g_kernel_stats
+// The statistics page. Task headers hold its address.
+//
+extern kernel_stats g_kernel_stats;
+
 //
 //kernel_task{}
 // Task state information kept by the kernel.
@@ -223,8 +681,24 @@ typedef struct _kernel_task {
     i64_t priority;       //Task priority used to determine which gets slices of time.
     u64_t flags;          //Logical or of KERNEL_TASK_FLAG_*
     u64_t sp;             //Task stack pointer used to save/restore context.
-    i64_t wakeup;         //Number of slices before sleeping task put back on priority queue.
+    u64_t wakeup;         //Tick at which sleeping task is put back on priority queue.
     kernel_nd_item node;  //Node in priority queue.
+    hrtimer timer;        //Wakes task from a microsecond sleep.
+    u64_t runtime;        //Counter ticks spent running.
+    u64_t ready;          //Counter value when last woken. 0 once it runs.
+    u64_t lat_count;      //Wakeups measured.
+    u64_t lat_max;        //Longest wakeup latency in nanoseconds.
+    u32_t lat[KERNEL_LAT_BUCKETS]; //Wakeup latencies. See latency.c.
+#ifdef KERNEL_PMU
+    u64_t pmu[KERNEL_PMU_COUNTERS]; //PMU counts while running.
+#endif
+#ifdef KERNEL_PROF
+    u64_t prof_end;       //Code size. Samples at or past it are other.
+    u64_t prof_shift;     //Log2 of bytes per histogram bucket.
+    u64_t prof_other;     //Samples outside the code.
+    u32_t prof[KERNEL_PROF_BUCKETS]; //Samples per bucket of code.
+#endif
+    kernel_fp fp;         //FP/SIMD state while another task owns the registers.
 } kernel_task;
 
 //
@@ -232,17 +706,365 @@ typedef struct _kernel_task {
 // Kernel structure maintains task states.
 //
 typedef struct _kernel {
+    u64_t core;                 //Core this kernel runs on.
+    kernel_lock lock;           //Held while kernel code runs on this core.
+    u64_t online;               //Non-zero once tasks may be stolen.
+    u64_t steals;               //Tasks stolen from other cores.
+    u64_t migrations;           //Tasks stolen by other cores.
     u64_t task;                 //Currently running task.
     u64_t ticks;                //Number of ticks since kernel last serviced.
+    u64_t time;                 //Number of ticks since kernel started.
+    u64_t tick_base;            //Nanoseconds at start of current tick.
+    hrtimer tick;               //Tick timer. One shot when tickless.
+    hrtimer_base hrtimers;      //Pending high resolution timers.
+    u64_t caller;               //Task which entered the kernel.
+    u64_t fp_owner;             //Task whose state is in the FP/SIMD registers.
+    u64_t *acct;                //Run time being charged. See kernel_acct_switch().
+    u64_t acct_stamp;           //Counter value when acct was last charged.
+    u64_t acct_start;           //Counter value when accounting started.
+    u64_t acct_summary;         //Tick the next CPU time summary is printed.
+    u64_t irq_time;             //Counter ticks spent in interrupt handlers.
+    u64_t idle_time;            //Counter ticks spent waiting for interrupts.
+#ifdef KERNEL_PMU
+    u64_t pmu_task;             //Task being charged PMU counts.
+    u64_t pmu_stamp[KERNEL_PMU_COUNTERS]; //Counts when last charged.
+#endif
+#ifdef KERNEL_PROF
+    u64_t prof_samples;         //Samples taken on this core.
+#endif
+    volatile u64_t rx_waiters;  //Tasks suspended until UART0 receives data.
+    volatile u64_t dma_done;    //Non-zero when a task's UART0 DMA has been sent.
     u64_t syscall;              //Non-zero if syscall needs to be serviced.
     kernel_sysarg sysarg;       //Argument to syscall.
     u64_t num_tasks;            //Number of tasks. Set by loader.
-    kernel_nd_item *queue;      //Priority queue.
-    kernel_nd_lst  sleep;      //Sleeping tasks. FIFO.
+    kernel_queue   queue;      //Priority queue.
+    kernel_sleep   sleep;      //Sleeping tasks. Timer wheel.
     kernel_nd_lst  suspend;    //Suspended tasks. FIFO.
+    kernel_trace   trace;      //Trace ring for this core.
+    kernel_log     log;        //Log ring for this core.
     kernel_task tasks[KERNEL_TASKS_MAX]; //Tasks.
 } kernel;
 
+//
+//kernel_queue_task_read_and_update()
+// Suspend a task until UART0 receives data. Left on the queue if data
+// arrived since the fast path found the receive ring empty.
+//
+void kernel_queue_task_read_and_update(kernel *k, u64_t task);
+
+//
+//kernel_service_uart_rx()
+// Called with interrupts disabled on the core of tasks waiting for 
+// UART0 data. Moves them from the suspend list to the queue.
+//
+void kernel_service_uart_rx(kernel *k);
+
+//
+//kernel_uart_rx_irq()
+// Called on core 0 for a UART0 interrupt. Empties the receive FIFO and
+// wakes waiting tasks on this core directly and on other cores through
+// their mailbox interrupt.
+//
+void kernel_uart_rx_irq(kernel *k);
+
+//
+//kernel_queue_task_dma_and_update()
+// Start sending the task's buffer by DMA and suspend the task until it
+// has been sent. Left on the queue with 0 in x0 if DMA is busy.
+//
+void kernel_queue_task_dma_and_update(kernel *k, u64_t task);
+
+//
+//kernel_service_uart_dma()
+// Called with interrupts disabled on the core of a task waiting for 
+// its DMA transfer. Moves it from the suspend list to the queue.
+//
+void kernel_service_uart_dma(kernel *k);
+
+//
+//kernel_acct_switch()
+// Charge the counter ticks since the last switch to the run time being
+// charged and start charging 'to'. Called with interrupts masked.
+// Returns: The run time which was being charged.
+//
+inline u64_t *kernel_acct_switch(kernel *k, u64_t *to) {
+    u64_t *from = k->acct;
+    u64_t cnt;
+
+    asm volatile ("mrs %0, cntpct_el0\n" : "=r"(cnt) :: );
+
+    *from        += cnt - k->acct_stamp;
+    k->acct_stamp = cnt;
+    k->acct       = to;
+
+    return from;
+}
+
+//
+//kernel_acct_init()
+// Zero run times and start charging the kernel.
+//
+void kernel_acct_init(kernel *k);
+
+//
+//kernel_acct_cpu_time()
+// CPU time in nanoseconds for the KERNEL_SYSCALL_CPU_TIME argument.
+//
+u64_t kernel_acct_cpu_time(kernel *k, u64_t which);
+
+//
+//kernel_acct_service()
+// Called after ticks are serviced. Prints the CPU time summary every
+// KERNEL_ACCT_SUMMARY_TICKS ticks.
+//
+void kernel_acct_service(kernel *k);
+
+//
+//kernel_log_init()
+// Empty the log ring.
+//
+void kernel_log_init(kernel_log *l);
+
+//
+//kernel_log_append()
+// Append text to the open record of the ring. A newline commits the
+// message. Drops the message if the ring is full.
+//
+void kernel_log_append(kernel_log *l, u64_t task, const char *str);
+
+//
+//kernel_log_pending()
+// Non-zero if committed records are waiting to be drained.
+//
+inline u64_t kernel_log_pending(kernel_log *l) {
+    return l->head != l->tail;
+}
+
+//
+//kernel_log_drain()
+// Print the oldest committed record over the uart. Called by the 
+// kernel when idle with interrupts enabled.
+//
+void kernel_log_drain(kernel_log *l);
+
+//*********************************************************************
+//
+// Kernel Task Node Routines
+//  Tasks are sorted and managed using referent nodes in data 
+//  structures. See node.c, queue.c and sleep.c.
+//
+//*********************************************************************
+
+//
+//kernel_task_node_list_tail_psh()
+// Push a task node onto the tail of the provided list.
+//
+void kernel_task_node_list_tail_psh(kernel *k, kernel_nd_lst *list, u64_t task);
+
+//
+//kernel_task_node_list_rmv()
+// Remove a task node from the provided list.
+//
+void kernel_task_node_list_rmv(kernel *k, kernel_nd_lst *list, u64_t task);
+
+//
+//kernel_queue_init()
+// Empty the ready queue.
+//
+void kernel_queue_init(kernel_queue *q);
+
+//
+//kernel_queue_psh()
+// Push a task onto the tail of the FIFO for its priority level.
+//
+void kernel_queue_psh(kernel *k, u64_t task);
+
+//
+//kernel_queue_rmv()
+// Remove a task from the ready queue.
+//
+void kernel_queue_rmv(kernel *k, u64_t task);
+
+//
+//kernel_queue_first()
+// Returns the first task in the highest priority level or 0 (kernel) if
+// the queue is empty.
+//
+u64_t kernel_queue_first(kernel *k);
+
+//
+//kernel_queue_stealable()
+// Highest priority ready task which is not running or waiting on a 
+// syscall, has a saved context, does not hold the FP/SIMD registers
+// and may run on core. Returns 0 if none.
+//
+u64_t kernel_queue_stealable(kernel *k, u64_t core);
+
+//
+//kernel_queue_has_peer()
+// Returns non-zero if other tasks are queued at the same priority
+// level as 'task'.
+//
+u64_t kernel_queue_has_peer(kernel *k, u64_t task);
+
+//
+//kernel_sleep_init()
+// Empty the sleep timer wheel. 'time' is the next tick to be serviced.
+//
+void kernel_sleep_init(kernel_sleep *s, u64_t time);
+
+//
+//kernel_sleep_psh()
+// Add a task to the sleep timer wheel. The task's wakeup field holds
+// the absolute tick it should wake up on.
+//
+void kernel_sleep_psh(kernel *k, u64_t task);
+
+//
+//kernel_sleep_rmv()
+// Remove a task from the sleep timer wheel.
+//
+void kernel_sleep_rmv(kernel *k, u64_t task);
+
+//
+//kernel_sleep_expired()
+// Remove and return the next task which expires on or before tick
+// 'now'. Returns 0 when there are no more expired tasks.
+//
+u64_t kernel_sleep_expired(kernel *k, u64_t now);
+
+//
+//kernel_sleep_next()
+// Returns the earliest tick a sleeping task expires on or
+// KERNEL_SLEEP_NEVER.
+//
+u64_t kernel_sleep_next(kernel *k);
+
+//*********************************************************************
+//
+// Kernel Specific Task Node Routines
+//  Tasks are sorted and managed using referent nodes in data 
+//  structures. These routines provide an API of sorts to decouple the
+//  data structure from the kernel task node operation.
+//
+//*********************************************************************
+
+//
+//kernel_[queue,suspend,sleep]_node_[add, rmv]()
+// These are helper functions to provide an api of sorts to facilitate
+// experimentation with different data structures and algorithms.
+//
+
+//kernel_*_task_node_add
+inline void kernel_queue_task_node_add(kernel *k, u64_t task) {
+    kernel_queue_psh(k, task);
+    k->task = kernel_queue_first(k); //Update current task.
+}
+
+inline void kernel_suspend_task_node_add(kernel *k, u64_t task) {
+    k->tasks[task].flags |= KERNEL_TASK_FLAG_SUSPENDED;
+    kernel_task_node_list_tail_psh(k, &k->suspend, task);
+}
+
+inline void kernel_sleep_task_node_add(kernel *k, u64_t task) {
+    k->tasks[task].flags |= KERNEL_TASK_FLAG_SLEEPING;
+    kernel_sleep_psh(k, task);
+}
+
+//kernel_*_task_node_rmv
+inline void kernel_queue_task_node_rmv(kernel *k, u64_t task) {
+    kernel_queue_rmv(k, task);
+    k->task = kernel_queue_first(k); //Update current task.
+}
+
+inline void kernel_suspend_task_node_rmv(kernel *k, u64_t task) {
+    k->tasks[task].flags &= ~KERNEL_TASK_FLAG_SUSPENDED;
+    kernel_task_node_list_rmv(k, &k->suspend, task);
+}
+
+inline void kernel_sleep_task_node_rmv(kernel *k, u64_t task) {
+    k->tasks[task].flags &= ~KERNEL_TASK_FLAG_SLEEPING;
+    kernel_sleep_rmv(k, task);
+}
+
+//*********************************************************************
+//
+// Scheduler Routines
+//  Queue, sleep and suspend handling. See sched.c.
+//
+//*********************************************************************
+
+//
+//kernel_task_flags_print()
+// Print task flags at LOG_DEBUG.
+//
+void kernel_task_flags_print(u64_t flags);
+
+//
+//kernel_task_node_list_validate()
+// Check list links. Panics on a broken list. Only runs at LOG_DEBUG.
+//
+void kernel_task_node_list_validate(kernel_nd_lst *list);
+
+//
+//kernel_queue_task_node_pos_update()
+// Move a task to the back of the FIFO for its priority level.
+//
+void kernel_queue_task_node_pos_update(kernel *k, u64_t task);
+
+//
+//kernel_queue_task_suspend_and_update()
+// Move a task from the queue to the suspend list until one of the
+// KERNEL_TASK_FLAG_WAKEUP_* conditions in k->sysarg is met.
+//
+void kernel_queue_task_suspend_and_update(kernel *k, u64_t task);
+
+//
+//kernel_queue_task_sleep_and_update()
+// Move a task from the queue to the sleep timer wheel for k->sysarg
+// milliseconds rounded up to ticks.
+//
+void kernel_queue_task_sleep_and_update(kernel *k, u64_t task);
+
+//
+//kernel_queue_task_priority_and_update()
+// Apply the priority (k->sysarg.lo) and queue flags (k->sysarg.hi) of a
+// priority syscall. Zero leaves either unchanged.
+//
+void kernel_queue_task_priority_and_update(kernel *k, u64_t task);
+
+//
+//kernel_queue_task_yield_and_update()
+// Move a task behind the other tasks with the same priority.
+//
+void kernel_queue_task_yield_and_update(kernel *k, u64_t task);
+
+//
+//kernel_service_sleeping()
+// Move tasks which expire on or before k->time from the sleep timer
+// wheel to the queue.
+//
+void kernel_service_sleeping(kernel *k);
+
+//
+//kernel_service_suspended()
+// Move suspended tasks whose wake up conditions are met to the queue.
+//
+void kernel_service_suspended(kernel *k);
+
+//
+//kernel_suspend_wakeable()
+// Non-zero if kernel_service_suspended() would wake a task.
+//
+u64_t kernel_suspend_wakeable(kernel *k);
+
+//
+//kernel_service_tick()
+// Rotate a round-robin running task behind its peers and pick the
+// task to run.
+//
+void kernel_service_tick(kernel *k);
+
 //
 //__task_context_save_and_branch()
 // Save current context and store stack pointer in sp_saved. Switch to
@@ -260,6 +1082,277 @@ extern volatile void __task_context_save_and_branch(volatile u64_t *sp_saved,
 extern volatile void __task_context_save_and_switch(volatile u64_t *sp_saved, 
                                                     volatile u64_t sp_new);
 
+//
+//kernel_frame{}
+// Register frame saved on the task stack on exception entry. See 
+// SAVE_CONTEXT in vectors.S.
+//
+typedef struct _kernel_frame {
+    u64_t x[30];  //x0-x29.
+    u64_t elr;    //Exception return address (ELR_EL1).
+    u64_t lr;     //Link register (x30).
+    u64_t spsr;   //Saved program status (SPSR_EL1).
+    u64_t pad;    //Keeps stack 16 byte aligned.
+} kernel_frame;
+
+//
+//kernel_syscall_fast()
+// Syscall fast path called from the exception handler. Syscalls which
+// never block are completed without entering the kernel and their 
+// result written to the caller's x0 in the frame.
+// Returns: 0 if handled, non-zero if the kernel must service it.
+//
+int kernel_syscall_fast(kernel *k, u64_t syscall, u64_t arg, 
+                        kernel_frame *frame);
+
+//
+//kernel_switch{}
+// Returned by exception handlers in x0 and x1. See vectors.S.
+//
+typedef struct _kernel_switch {
+    u64_t *sp_saved;  //Current task SP saved here. If 0 no switch.
+    u64_t sp_new;     //Stack pointer of the next task context.
+} kernel_switch;
+
+//
+//kernel_schedule()
+// Called at the end of an exception handler with interrupts disabled.
+// Services elapsed ticks and switches straight to the highest priority
+// task. Task0 (kernel) is only entered when a syscall is pending or no
+// task is ready.
+//
+kernel_switch kernel_schedule(kernel *k);
+
+//
+//__fp_context_save()
+// Save V0-V31, FPCR and FPSR.
+//
+extern void __fp_context_save(kernel_fp *fp);
+
+//
+//__fp_context_restore()
+// Restore V0-V31, FPCR and FPSR.
+//
+extern void __fp_context_restore(kernel_fp *fp);
+
+//
+//kernel_fp_init()
+// No task owns the FP/SIMD registers. First use traps.
+//
+void kernel_fp_init(kernel *k);
+
+//
+//kernel_fp_switch()
+// Called before switching to task. FP/SIMD access traps unless the 
+// task owns the registers.
+//
+void kernel_fp_switch(kernel *k, u64_t task);
+
+//
+//kernel_fp_trap()
+// Called from the exception handler when the current task uses FP/SIMD
+// registers it does not own. Saves the owner's state, restores the
+// current task's state and enables access.
+//
+void kernel_fp_trap(kernel *k);
+
+//
+//kernel_stats_init()
+// Zero the statistics of this core and its tasks and point the task
+// headers at the statistics page.
+//
+void kernel_stats_init(kernel *k);
+
+//
+//kernel_stats_wakeup()
+// Called where a task is put back on the ready queue. Stamps the time
+// so the latency until it runs can be measured.
+//
+inline void kernel_stats_wakeup(kernel *k, u64_t task) {
+#ifndef KERNEL_HOST
+//Host builds (tools/bench) have no generic timer.
+    asm volatile ("mrs %0, cntpct_el0\n" : "=r"(k->tasks[task].ready) :: );
+#endif
+}
+
+//
+//kernel_stats_switch_out()
+// Called after kernel_acct_switch() away from 'task'. 'how' is one of
+// KERNEL_STATS_*. Publishes its run time and the ready queue depth.
+//
+void kernel_stats_switch_out(kernel *k, u64_t task, u64_t how);
+
+//
+//kernel_stats_switch_in()
+// Called when switching to 'task'. Publishes the latency since it was
+// woken and the ready queue depth.
+//
+void kernel_stats_switch_in(kernel *k, u64_t task);
+
+//
+//kernel_lat_init()
+// Empty the wakeup latency histograms.
+//
+void kernel_lat_init(kernel *k);
+
+//
+//kernel_lat_record()
+// Count a wakeup latency of 'ns' nanoseconds for 'task'. Called when
+// a woken task is switched to.
+//
+void kernel_lat_record(kernel *k, u64_t task, u64_t ns);
+
+//
+//kernel_lat_value()
+// KERNEL_SYSCALL_LATENCY. Latency at 'permille' of 'task' in 
+// nanoseconds.
+//
+u64_t kernel_lat_value(kernel *k, u64_t task, u64_t permille);
+
+//
+//kernel_lat_dump()
+// Print the histograms of the tasks on this core over the uart.
+//
+void kernel_lat_dump(kernel *k);
+
+#ifdef KERNEL_PMU
+//
+//kernel_pmu_init()
+// Zero task counts, program the event counters and start the PMU.
+//
+void kernel_pmu_init(kernel *k);
+
+//
+//kernel_pmu_switch()
+// Charge PMU counts since the last switch to the task being charged 
+// and start charging 'task'. Called with interrupts masked.
+//
+void kernel_pmu_switch(kernel *k, u64_t task);
+#else
+static inline void kernel_pmu_init(kernel *k) {}
+static inline void kernel_pmu_switch(kernel *k, u64_t task) {}
+#endif
+
+#ifdef KERNEL_PROF
+//
+//kernel_prof_init()
+// Zero histograms, size each task's buckets, start the cycle counter 
+// counting down to the first sample and route the PMU interrupt.
+//
+void kernel_prof_init(kernel *k);
+
+//
+//kernel_prof_sample()
+// Called from the IRQ handler on a cycle counter overflow. Counts the
+// interrupted PC and restarts the countdown.
+//
+void kernel_prof_sample(kernel *k);
+#else
+static inline void kernel_prof_init(kernel *k) {}
+static inline void kernel_prof_sample(kernel *k) {}
+#endif
+
+//
+//kernel_prof_dump()
+// Print the histograms of the tasks on this core over the uart. See 
+// tools/prof. Prints no tasks without KERNEL_PROF.
+//
+void kernel_prof_dump(kernel *k);
+
+//
+//kernel_pmu_count()
+// KERNEL_SYSCALL_PMU. 'counter' of 'task'. 0 without KERNEL_PMU.
+//
+u64_t kernel_pmu_count(kernel *k, u64_t task, u64_t counter);
+
+//
+//kernel_pmu_print()
+// Log counts of the tasks on this core. Called from the CPU time 
+// summary.
+//
+void kernel_pmu_print(kernel *k);
+
+//
+//__kernel_secondary_start()
+// Entry point of cores 1-3 when released through the spin table. Sets
+// the core's kernel stack and calls kernel_secondary_main().
+//
+// x0 Core number.
+//
+extern void __kernel_secondary_start(u64_t core);
+
+//
+//kernel_lock_init()
+//
+void kernel_lock_init(kernel_lock *l);
+
+//
+//kernel_lock_acquire()
+// Spin until the calling core holds the lock.
+//
+void kernel_lock_acquire(kernel_lock *l);
+
+//
+//kernel_lock_try_acquire()
+// Take the lock only if no other core holds it or is waiting for it.
+// Never waits.
+// Returns: Non-zero if the lock was taken.
+//
+u64_t kernel_lock_try_acquire(kernel_lock *l);
+
+//
+//kernel_lock_release()
+//
+void kernel_lock_release(kernel_lock *l);
+
+//
+//kernel_steal()
+// Called by an idle core without holding its own lock. Moves the 
+// highest priority stealable task from the core with the most ready
+// tasks to this core's queue. Gives up if that core's lock is busy.
+// Returns: Non-zero if a task was stolen.
+//
+u64_t kernel_steal(kernel *k);
+
+//
+//kernel_get_core_pointer()
+// Kernel running on core or 0 if not started.
+//
+kernel *kernel_get_core_pointer(u64_t core);
+
+//
+//kernel_smp_start()
+// Called on core 0 after loading. Assigns each task to a core and 
+// releases cores 1-3 to run their own kernel.
+//
+void kernel_smp_start(u64_t num_tasks);
+
+//
+//kernel_secondary_main()
+// Kernel entry on cores 1-3. Initializes the core's kernel with the
+// tasks assigned to it and enters kernel_main().
+//
+void kernel_secondary_main(u64_t core);
+
+//
+//kernel_task_core()
+// Core a task was assigned to at load time.
+//
+u64_t kernel_task_core(u64_t task);
+
+//
+//kernel_now_ns()
+// Nanoseconds since the physical counter started.
+//
+u64_t kernel_now_ns(kernel *k);
+
+//
+//kernel_service_hrtimers()
+// Called from the timer interrupt. Runs expired high resolution timers
+// and programs the comparator for the next deadline.
+//
+void kernel_service_hrtimers(kernel *k);
+
 //
 //kernel_init()
 // Initialize the provided kernel structure.
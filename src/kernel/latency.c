@@ -0,0 +1,192 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//latency.c
+// Wakeup latency histograms. A task is stamped when it is put back on
+// the ready queue by a sleep expiry, a resume from suspend or an 
+// interrupt, and the time until the kernel switches to it is counted
+// in a log-linear histogram of the task (see kernel_stats_switch_in()).
+// Each power of two nanoseconds has KERNEL_LAT_SUB buckets so tail
+// percentiles are within a quarter of their true value. A stolen task 
+// takes its histogram with it.
+//
+
+#include "kernel.h"
+#include "uart.h"
+
+//
+//kernel_lat_bucket()
+// Histogram bucket of 'ns'.
+//
+static inline u64_t kernel_lat_bucket(u64_t ns) {
+    u64_t msb, bucket;
+
+    if (ns < KERNEL_LAT_SUB) {
+        return ns;
+    }
+
+    msb    = 63 - __builtin_clzll(ns);
+    bucket = (msb - 1) * KERNEL_LAT_SUB + 
+             ((ns >> (msb - 2)) & (KERNEL_LAT_SUB - 1));
+
+    return bucket < KERNEL_LAT_BUCKETS ? bucket : KERNEL_LAT_BUCKETS - 1;
+}
+
+//
+//kernel_lat_bucket_lo()
+// Lowest nanoseconds counted in 'bucket'.
+//
+static u64_t kernel_lat_bucket_lo(u64_t bucket) {
+    if (bucket < KERNEL_LAT_SUB) {
+        return bucket;
+    }
+
+    return (KERNEL_LAT_SUB + bucket % KERNEL_LAT_SUB) << 
+           (bucket / KERNEL_LAT_SUB - 1);
+}
+
+//
+//kernel_lat_bucket_hi()
+// Highest nanoseconds counted in 'bucket'.
+//
+static u64_t kernel_lat_bucket_hi(u64_t bucket) {
+    return kernel_lat_bucket_lo(bucket + 1) - 1;
+}
+
+//
+//kernel_lat_pct()
+// Upper bound of the bucket holding 'permille' of the latencies of 't'.
+// Never more than the longest latency.
+//
+static u64_t kernel_lat_pct(kernel_task *t, u64_t permille) {
+    u64_t target, seen, i;
+
+    if (!t->lat_count) {
+        return 0;
+    }
+
+//Rank of the latency wanted. Rounded up so p99.9 of fewer than 1000 
+//wakeups is the longest.
+    target = (t->lat_count * permille + 999) / 1000;
+    if (!target) {
+        target = 1;
+    }
+
+    seen = 0;
+    for (i = 0; i < KERNEL_LAT_BUCKETS - 1; ++i) {
+        seen += t->lat[i];
+        if (seen >= target) {
+            break;
+        }
+    }
+
+    if (KERNEL_LAT_BUCKETS - 1 == i || kernel_lat_bucket_hi(i) > t->lat_max) {
+        return t->lat_max;
+    }
+
+    return kernel_lat_bucket_hi(i);
+}
+
+void kernel_lat_init(kernel *k) {
+    u64_t i, j;
+
+    for (i = 0; i < KERNEL_TASKS_MAX; ++i) {
+        k->tasks[i].lat_count = 0;
+        k->tasks[i].lat_max   = 0;
+        for (j = 0; j < KERNEL_LAT_BUCKETS; ++j) {
+            k->tasks[i].lat[j] = 0;
+        }
+    }
+}
+
+void kernel_lat_record(kernel *k, u64_t task, u64_t ns) {
+    kernel_task *t = &k->tasks[task];
+
+    ++t->lat[kernel_lat_bucket(ns)];
+    ++t->lat_count;
+    if (ns > t->lat_max) {
+        t->lat_max = ns;
+    }
+}
+
+u64_t kernel_lat_value(kernel *k, u64_t task, u64_t permille) {
+    kernel *owner;
+    kernel_task *t;
+
+//Kernel is never woken.
+    if (!task || task >= k->num_tasks) {
+        return 0;
+    }
+
+//Histograms are kept by the core which runs the task.
+    owner = kernel_get_core_pointer(kernel_task_core(task));
+    if (!owner) {
+        return 0;
+    }
+    t = &owner->tasks[task];
+
+    if (!permille) {
+        return t->lat_count;
+    }
+
+    if (permille >= 1000) {
+        return t->lat_max;
+    }
+
+    return kernel_lat_pct(t, permille);
+}
+
+void kernel_lat_dump(kernel *k) {
+    kernel_task *t;
+    u64_t i, j;
+
+    uart_printf("rpi3rtos::lat: begin core %llu\n", k->core);
+
+    for (i = 1; i < k->num_tasks; ++i) {
+        if (kernel_task_core(i) != k->core) {
+            continue;
+        }
+
+        t = &k->tasks[i];
+        uart_printf("rpi3rtos::lat: task %llu wakeups %llu p50 %llu p90 "
+                    "%llu p99 %llu p99.9 %llu max %llu ns\n", i, 
+                    t->lat_count, kernel_lat_pct(t, 500), 
+                    kernel_lat_pct(t, 900), kernel_lat_pct(t, 990), 
+                    kernel_lat_pct(t, 999), t->lat_max);
+
+//Only buckets with wakeups. Nanosecond range and count.
+        for (j = 0; j < KERNEL_LAT_BUCKETS; ++j) {
+            if (t->lat[j]) {
+                uart_printf("rpi3rtos::lat: %llu-%llu %llu\n",
+                            kernel_lat_bucket_lo(j),
+                            j < KERNEL_LAT_BUCKETS - 1 ? 
+                            kernel_lat_bucket_hi(j) : t->lat_max,
+                            (u64_t) t->lat[j]);
+            }
+        }
+    }
+
+    uart_puts("rpi3rtos::lat: end\n");
+}
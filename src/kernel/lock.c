@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//lock.c
+// Lamport's bakery lock. Cores take a ticket one higher than any they
+// see and enter in ticket order, ties broken by core number. Needs no
+// atomic instructions which are unreliable with the MMU and caches
+// off. Barriers order the plain loads and stores between cores.
+//
+
+#include "kernel.h"
+
+//
+//kernel_lock_barrier()
+//
+static inline void kernel_lock_barrier(void) {
+    asm volatile ("dmb sy\n" ::: "memory");
+}
+
+void kernel_lock_init(kernel_lock *l) {
+    u64_t i;
+    for (i = 0; i < PLATFORM_CORES; ++i) {
+        l->choosing[i] = 0;
+        l->ticket[i]   = 0;
+    }
+    kernel_lock_barrier();
+}
+
+//
+//kernel_lock_ticket()
+// Take a ticket higher than any in use.
+//
+static void kernel_lock_ticket(kernel_lock *l, u64_t me) {
+    u64_t i, max = 0;
+
+    l->choosing[me] = 1;
+    kernel_lock_barrier();
+
+    for (i = 0; i < PLATFORM_CORES; ++i) {
+        if (l->ticket[i] > max) {
+            max = l->ticket[i];
+        }
+    }
+
+    l->ticket[me] = max + 1;
+    kernel_lock_barrier();
+    l->choosing[me] = 0;
+    kernel_lock_barrier();
+}
+
+void kernel_lock_acquire(kernel_lock *l) {
+    u64_t me = platform_core();
+    u64_t i;
+
+    kernel_lock_ticket(l, me);
+
+//Wait for every core with a lower ticket.
+    for (i = 0; i < PLATFORM_CORES; ++i) {
+        if (i == me) {
+            continue;
+        }
+
+        while (l->choosing[i]) {}
+        kernel_lock_barrier();
+
+        while (l->ticket[i] && 
+               (l->ticket[i] < l->ticket[me] ||
+                (l->ticket[i] == l->ticket[me] && i < me))) {}
+    }
+
+    kernel_lock_barrier();
+}
+
+u64_t kernel_lock_try_acquire(kernel_lock *l) {
+    u64_t me = platform_core();
+    u64_t i;
+
+    kernel_lock_ticket(l, me);
+
+//Give up rather than wait for a core choosing or with a lower ticket.
+    for (i = 0; i < PLATFORM_CORES; ++i) {
+        if (i == me) {
+            continue;
+        }
+
+        if (l->choosing[i]) {
+            break;
+        }
+        kernel_lock_barrier();
+
+        if (l->ticket[i] && 
+            (l->ticket[i] < l->ticket[me] ||
+             (l->ticket[i] == l->ticket[me] && i < me))) 
+        {
+            break;
+        }
+    }
+
+    if (i < PLATFORM_CORES) {
+        kernel_lock_release(l);
+        return 0;
+    }
+
+    kernel_lock_barrier();
+    return 1;
+}
+
+void kernel_lock_release(kernel_lock *l) {
+    kernel_lock_barrier();
+    l->ticket[platform_core()] = 0;
+    kernel_lock_barrier();
+}
@@ -0,0 +1,274 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//log.c
+// Asynchronous kernel log. Messages are appended to a ring of records
+// on the logging core and printed over the uart by the core's kernel
+// when it has nothing to run. A full ring drops messages rather than
+// waiting on the uart.
+//
+
+#include "kernel.h"
+#include "fmt.h"
+#include "irq.h"
+#include "uart.h"
+
+#define LOG_MODULE LOG_MOD_ALL
+#include "log.h"
+
+//
+//Emitted where kernel_log_pending() is not inlined.
+//
+extern u64_t kernel_log_pending(kernel_log *l);
+
+void kernel_log_init(kernel_log *l) {
+    u64_t i;
+
+    l->head        = 0;
+    l->tail        = 0;
+    l->drops       = 0;
+    l->dropping    = 0;
+    l->partial     = 0;
+    l->drops_shown = 0;
+    l->tx_drops_shown = uart_tx_drops(platform_core());
+    l->bin_time    = 0;
+
+    for (i = 0; i < KERNEL_LOG_RECORDS; ++i) {
+        l->recs[i].len = 0;
+    }
+}
+
+void kernel_log_append(kernel_log *l, u64_t task, const char *str) {
+    u64_t daif = irq_save();
+    kernel_log_record *r;
+
+    for (; *str; ++str) {
+        if (l->dropping) {
+//Rest of a dropped message.
+            if ('\n' == *str) {
+                l->dropping = 0;
+            }
+            continue;
+        }
+
+        if (KERNEL_LOG_RECORDS == l->head - l->tail) {
+//Full. Record at head is still being drained.
+            ++l->drops;
+            l->dropping = ('\n' != *str);
+            continue;
+        }
+
+        r = &l->recs[l->head & (KERNEL_LOG_RECORDS - 1)];
+
+        if (!r->len) {
+//Start a record. Continues the previous one if it was not a full line.
+            asm volatile ("mrs %0, cntpct_el0\n" : "=r"(r->time) :: );
+            r->task = (u16_t) task;
+            r->cont = (u32_t) l->partial;
+        }
+
+        r->text[r->len++] = *str;
+
+        if ('\n' == *str || KERNEL_LOG_TEXT == r->len) {
+//Commit. Drain may print it from now on.
+            l->partial = ('\n' != *str);
+            asm volatile ("" ::: "memory");
+            ++l->head;
+        }
+    }
+
+    irq_restore(daif);
+}
+
+void kernel_log_drain(kernel_log *l) {
+    kernel_log_record *r;
+
+    if (l->drops != l->drops_shown) {
+        l->drops_shown = l->drops;
+        uart_printf("rpi3rtos::kernel_log_drain(): %llu messages dropped.\n",
+                    l->drops_shown);
+    }
+
+//Uart output of this core lost while core 0 was not taking it.
+    if (uart_tx_drops(platform_core()) != l->tx_drops_shown) {
+        l->tx_drops_shown = uart_tx_drops(platform_core());
+        uart_printf("rpi3rtos::kernel_log_drain(): %llu uart bytes "
+                    "dropped.\n", l->tx_drops_shown);
+    }
+
+    if (l->head == l->tail) {
+        return;
+    }
+
+    r = &l->recs[l->tail & (KERNEL_LOG_RECORDS - 1)];
+
+//One write per record. Binary frames carry their own time.
+    if (r->cont || LOG_BIN_START == r->text[0]) {
+        uart_nputs(r->text, r->len);
+    } else if (r->task) {
+        uart_printf("[0x%llX] task %u: %.*s", r->time, r->task, 
+                    (int) r->len, r->text);
+    } else {
+        uart_printf("[0x%llX] %.*s", r->time, (int) r->len, r->text);
+    }
+
+//Free the record.
+    r->len = 0;
+    asm volatile ("" ::: "memory");
+    ++l->tail;
+}
+
+//
+//kernel_log_puts()
+// Called by LOG_PUTS(). Synchronous until the core's kernel exists.
+//
+void kernel_log_puts(const char *str) {
+    kernel *k = kernel_get_pointer();
+
+    if (!k) {
+        uart_puts(str);
+        return;
+    }
+
+    kernel_log_append(&k->log, 0, str);
+}
+
+//
+//kernel_log_hex()
+// Called by LOG_HEX(). Same format as uart_u64hex_s().
+//
+void kernel_log_hex(u64_t val) {
+    c8_t buf[19];
+    u64_t n;
+
+    buf[0] = '0';
+    buf[1] = 'x';
+    n = 2 + fmt_u64(&buf[2], val, 16, 1);
+    buf[n] = 0;
+
+    kernel_log_puts(buf);
+}
+
+//
+//kernel_log_printf()
+// Called by LOG_PRINTF(). Longer messages take several records.
+//
+FMT_VARARGS
+void kernel_log_printf(const char *fmt, ...) {
+    c8_t buf[UART_PRINTF_MAX];
+    fmt_va_list ap;
+
+    fmt_va_start(ap, fmt);
+    fmt_vsnprintf(buf, sizeof(buf), fmt, ap);
+    fmt_va_end(ap);
+
+    kernel_log_puts(buf);
+}
+
+//
+//kernel_log_byte()
+// Append a byte to a binary frame, escaping bytes which would end or
+// split it. Returns the new end of the frame.
+//
+static c8_t *kernel_log_byte(c8_t *out, u64_t b) {
+    if (!b || '\n' == b || LOG_BIN_ESC == b || LOG_BIN_START == b) {
+        *out++ = LOG_BIN_ESC;
+        b ^= 0x20;
+    }
+    *out++ = (c8_t) b;
+
+    return out;
+}
+
+//
+//kernel_log_leb128()
+// Append val to a binary frame as unsigned LEB128.
+//
+static c8_t *kernel_log_leb128(c8_t *out, u64_t val) {
+    while (val > 0x7F) {
+        out = kernel_log_byte(out, 0x80 | (val & 0x7F));
+        val >>= 7;
+    }
+
+    return kernel_log_byte(out, val);
+}
+
+//
+//kernel_log_bin()
+// Called by LOG_BIN(). The string offset is the distance from the 
+// start of .logstr which is the same at link and run time. A frame has
+// no null or newline bytes before the newline which ends it so it goes
+// through the log ring like a line of text.
+//
+void kernel_log_bin(const char *fmt, u64_t nargs, const u64_t *args) {
+    extern const char __logstr_beg[];
+    kernel *k = kernel_get_pointer();
+    c8_t frame[1 + 2 * (1 + 2 + 10 * (1 + LOG_BIN_ARGS_MAX)) + 2];
+    c8_t *out = frame;
+    u64_t i, id, hdr, now, drops, daif;
+
+    if (nargs > LOG_BIN_ARGS_MAX) {
+        nargs = LOG_BIN_ARGS_MAX;
+    }
+
+    id  = (u64_t) (fmt - __logstr_beg);
+    hdr = nargs | (platform_core() << LOG_BIN_CORE_SHFT) | 
+          (LOG_IMAGE << LOG_BIN_IMG_SHFT);
+
+//Masked so the time delta is from the previous frame in the ring.
+    daif = irq_save();
+    asm volatile ("mrs %0, cntpct_el0\n" : "=r"(now) :: );
+
+    if (!k || !k->log.bin_time) {
+        hdr |= LOG_BIN_ABS_TIME;
+    }
+
+    *out++ = LOG_BIN_START;
+    out = kernel_log_byte(out, hdr);
+    out = kernel_log_byte(out, id & 0xFF);
+    out = kernel_log_byte(out, (id >> 8) & 0xFF);
+    out = kernel_log_leb128(out, (hdr & LOG_BIN_ABS_TIME) ? 
+                                 now : now - k->log.bin_time);
+
+    for (i = 0; i < nargs; ++i) {
+        out = kernel_log_leb128(out, args[i]);
+    }
+
+    *out++ = '\n';
+    *out   = 0;
+
+    if (!k) {
+        uart_puts(frame);
+        irq_restore(daif);
+        return;
+    }
+
+//The next frame has the full time if this one is dropped.
+    drops = k->log.drops;
+    kernel_log_append(&k->log, 0, frame);
+    k->log.bin_time = (drops == k->log.drops) ? now : 0;
+
+    irq_restore(daif);
+}
@@ -0,0 +1,248 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+//
+//log.h
+// Kernel logging with compile time levels and module masks. Messages
+// above LOG_LEVEL or from modules not in LOG_MODULES compile to 
+// nothing. Messages are appended to the core's log ring and printed 
+// when the core is idle (see log.c) unless built with LOG_SYNC. Errors
+// are always printed straight away since the kernel is about to panic.
+// Each source file defines LOG_MODULE before including this header. 
+// Example:
+//
+//  #define LOG_MODULE LOG_MOD_KERNEL
+//  #include "log.h"
+//
+//  LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_main(): Resume task %llu.\n", 
+//             k->task);
+//
+
+#include "uart.h"
+
+//*********************************************************************
+//
+//LOG_* levels
+// Lower is more severe. A build logs all levels up to LOG_LEVEL.
+//
+//*********************************************************************
+
+#define LOG_ERROR 1 //Kernel is about to panic.
+#define LOG_WARN  2 //Something went wrong but the kernel continues.
+#define LOG_INFO  3 //Start up and periodic summaries.
+#define LOG_DEBUG 4 //Scheduling, syscalls and interrupts. Very chatty.
+
+//*********************************************************************
+//
+//LOG_MOD_* modules
+// Bit for each source of log messages.
+//
+//*********************************************************************
+
+#define LOG_MOD_KERNEL 0x01 //kernel.c
+#define LOG_MOD_IRQ    0x02 //interrupts.c
+#define LOG_MOD_EXC    0x04 //exceptions.c
+#define LOG_MOD_FP     0x08 //fp.c
+#define LOG_MOD_SMP    0x10 //smp.c
+#define LOG_MOD_ACCT   0x20 //acct.c
+#define LOG_MOD_PMU    0x40 //pmu.c, prof.c
+#define LOG_MOD_ALL    0xFF
+
+//
+//LOG_LEVEL
+// Highest level logged. Build with LOG_LEVEL=2 for no uart output on
+// the scheduling path.
+//
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_INFO
+#endif
+
+//
+//LOG_MODULES
+// Logical or of LOG_MOD_* to log.
+//
+#ifndef LOG_MODULES
+#define LOG_MODULES LOG_MOD_ALL
+#endif
+
+#ifndef LOG_MODULE
+#error "Define LOG_MODULE before including log.h"
+#endif
+
+//
+//LOG_SYNC
+// Defined to print messages over the uart as they are logged.
+//
+
+//
+//LOG_BINARY
+// Defined to log binary frames instead of text. Format strings are
+// placed in the .logstr section which is in task0.elf but stripped 
+// from task0.img. A frame holds the offset of the format string in the
+// section, the counter value and the argument values. 
+// tools/log/logdecode.py prints the text on the host. Arguments must 
+// be integers. Errors and LOG_SYNC builds still print text.
+//
+
+//
+//LOG_IMAGE
+// Image number in binary frames. tools/log/logdecode.py looks up 
+// format strings in the ELF file at this position in its arguments.
+//
+#ifndef LOG_IMAGE
+#define LOG_IMAGE 0
+#endif
+
+//
+//LOG_BIN_*
+// Binary frame layout. A frame is a start byte, a header byte, the 
+// string offset (u16 little endian, so src/task0/link.ld fails the
+// build if .logstr grows past 64kB), the time since the core's 
+// previous frame and the arguments as unsigned LEB128 and a newline. 
+// LOG_BIN_ESC followed by the byte xor 0x20 replaces bytes which 
+// would end or split a frame.
+//
+#define LOG_BIN_START     0x1E //First byte of a frame.
+#define LOG_BIN_ESC       0x1B //Escapes the next byte.
+#define LOG_BIN_ARGS_MAX  7    //Header bits 0-2: Argument count.
+#define LOG_BIN_CORE_SHFT 3    //Header bits 3-4: Core.
+#define LOG_BIN_IMG_SHFT  5    //Header bits 5-6: LOG_IMAGE.
+#define LOG_BIN_ABS_TIME  0x80 //Time is the counter, not a delta.
+
+//
+//kernel_log_puts()
+// Append a string to the log ring of the calling core.
+//
+void kernel_log_puts(const char *str);
+
+//
+//kernel_log_hex()
+// Append a value in hex to the log ring of the calling core.
+//
+void kernel_log_hex(u64_t val);
+
+//
+//kernel_log_printf()
+// Format with fmt_snprintf() (see fmt.h) and append the result to the
+// log ring of the calling core.
+//
+void kernel_log_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+//
+//kernel_log_bin()
+// Append a binary frame to the log ring of the calling core. fmt is
+// in the .logstr section.
+//
+void kernel_log_bin(const char *fmt, u64_t nargs, const u64_t *args);
+
+//
+//kernel_log_check()
+// Not defined. Only appears in sizeof() so the compiler checks 
+// LOG_BINARY format strings against their arguments.
+//
+int kernel_log_check(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+//
+//LOG_ON()
+// Non-zero if messages at level are logged by this source file. A 
+// constant so disabled messages are removed by the compiler.
+//
+#define LOG_ON(level) ((level) <= LOG_LEVEL && (LOG_MODULE & LOG_MODULES))
+
+//
+//LOG_NOW()
+// Non-zero if messages at level are printed straight away.
+//
+#ifdef LOG_SYNC
+#define LOG_NOW(level) 1
+#else
+#define LOG_NOW(level) ((level) <= LOG_ERROR)
+#endif
+
+//
+//LOG_BIN()
+// Log a binary frame. fmt must be a string literal. Arguments are 
+// evaluated once each and converted to u64_t.
+//
+#define LOG_BIN(fmt, ...)                                            \
+    do {                                                             \
+        static const char log_fmt_[]                                 \
+            __attribute__((section(".logstr"), used)) = fmt;         \
+        const u64_t log_args_[] = { 0, ##__VA_ARGS__ };              \
+        (void) sizeof(kernel_log_check(fmt, ##__VA_ARGS__));         \
+        kernel_log_bin(log_fmt_, sizeof(log_args_) / 8 - 1,          \
+                       &log_args_[1]);                               \
+    } while (0)
+
+#ifdef LOG_BINARY
+#define LOG_PUTS_DEFERRED(str)  LOG_BIN(str)
+#define LOG_HEX_DEFERRED(val)   LOG_BIN("0x%llX", (u64_t) (val))
+#define LOG_PRINTF_DEFERRED(...) LOG_BIN(__VA_ARGS__)
+#else
+#define LOG_PUTS_DEFERRED(str)  kernel_log_puts(str)
+#define LOG_HEX_DEFERRED(val)   kernel_log_hex(val)
+#define LOG_PRINTF_DEFERRED(...) kernel_log_printf(__VA_ARGS__)
+#endif
+
+//
+//LOG_PUTS()
+// Log a string.
+//
+#define LOG_PUTS(level, str)                                         \
+    do {                                                             \
+        if (LOG_ON(level)) {                                         \
+            if (LOG_NOW(level)) { uart_puts(str); }                  \
+            else { LOG_PUTS_DEFERRED(str); }                         \
+        }                                                            \
+    } while (0)
+
+//
+//LOG_HEX()
+// Log a value in hex.
+//
+#define LOG_HEX(level, val)                                          \
+    do {                                                             \
+        if (LOG_ON(level)) {                                         \
+            if (LOG_NOW(level)) { uart_u64hex_s(val); }              \
+            else { LOG_HEX_DEFERRED(val); }                          \
+        }                                                            \
+    } while (0)
+
+//
+//LOG_PRINTF()
+// Log a formatted message in one call. Arguments are not evaluated 
+// unless the message is logged.
+//
+#define LOG_PRINTF(level, ...)                                       \
+    do {                                                             \
+        if (LOG_ON(level)) {                                         \
+            if (LOG_NOW(level)) { uart_printf(__VA_ARGS__); }        \
+            else { LOG_PRINTF_DEFERRED(__VA_ARGS__); }               \
+        }                                                            \
+    } while (0)
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//node.c
+// Linked list routines for kernel task nodes. Kept free of hardware
+// and uart dependencies so the data structures can also be built and
+// benchmarked on the host (see tools/bench).
+//
+
+#include "kernel.h"
+
+//*********************************************************************
+// Kernel Task Node List Routines
+//  Tasks are sorted and managed using referent nodes in data 
+//  structures. Lists are doubly linked and implement a FIFO.
+//*********************************************************************
+
+void kernel_task_node_list_tail_psh(kernel *k,
+                                    kernel_nd_lst *list, 
+                                    u64_t task) 
+{
+    kernel_nd_item *nd = &k->tasks[task].node;
+    nd->list = list;
+    if (list->tail) {
+        list->tail->next = nd;
+        nd->prev = list->tail;
+        nd->next = 0;
+        list->tail = nd;
+    } else {
+        nd->prev = 0;
+        nd->next = 0;
+        list->tail = nd;
+        list->head = nd;
+    }
+}
+
+void kernel_task_node_list_rmv(kernel *k, 
+                               kernel_nd_lst *list, 
+                               u64_t task) 
+{
+    kernel_nd_item *nd = &k->tasks[task].node;
+
+    if(nd->prev) {
+        nd->prev->next = nd->next;
+    } else {
+        list->head = nd->next;
+    }
+
+    if (nd->next) {
+        nd->next->prev = nd->prev;
+    } else {
+        list->tail = nd->prev;
+    }
+
+    nd->next = 0;
+    nd->prev = 0;
+    nd->list = 0;
+}
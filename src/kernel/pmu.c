@@ -0,0 +1,206 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//pmu.c
+// Per task PMU counts. The cycle counter and event counters run freely
+// and, like CPU time (acct.c), the counts since the last switch are 
+// charged to the task which was running. Counters are read at a switch
+// but never saved or restored. Interrupt handlers are charged to the
+// task they interrupted. The kernel and idle are charged to task0.
+//
+
+#include "kernel.h"
+
+#define LOG_MODULE LOG_MOD_PMU
+#include "log.h"
+
+#ifdef KERNEL_PMU
+
+//
+//KERNEL_PMU_PMCR_*
+// PMCR_EL0 bits.
+//
+#define KERNEL_PMU_PMCR_E  0x01 //Enable counters.
+#define KERNEL_PMU_PMCR_P  0x02 //Reset event counters.
+#define KERNEL_PMU_PMCR_C  0x04 //Reset cycle counter.
+#define KERNEL_PMU_PMCR_LC 0x40 //Cycle counter overflows at 64 bits.
+
+//
+//KERNEL_PMU_CNTEN
+// PMCNTENSET_EL0 bits. Cycle counter is bit 31.
+//
+#define KERNEL_PMU_CNTEN   (((u64_t) 1 << 31) | ((1 << KERNEL_PMU_EVENTS) - 1))
+
+//
+//kernel_pmu_read()
+// Current counter values. Event counters are 32 bits.
+//
+static inline void kernel_pmu_read(u64_t *cnt) {
+    asm volatile (
+        "mrs %0, pmccntr_el0\n"
+        "mrs %1, pmevcntr0_el0\n"
+        "mrs %2, pmevcntr1_el0\n"
+        "mrs %3, pmevcntr2_el0\n"
+        "mrs %4, pmevcntr3_el0\n"
+        "mrs %5, pmevcntr4_el0\n"
+        "mrs %6, pmevcntr5_el0\n"
+        : "=r"(cnt[0]), "=r"(cnt[1]), "=r"(cnt[2]), "=r"(cnt[3]),
+          "=r"(cnt[4]), "=r"(cnt[5]), "=r"(cnt[6])
+        :: 
+    );
+}
+
+void kernel_pmu_init(kernel *k) {
+    u64_t i, j;
+
+    for (i = 0; i < KERNEL_TASKS_MAX; ++i) {
+        for (j = 0; j < KERNEL_PMU_COUNTERS; ++j) {
+            k->tasks[i].pmu[j] = 0;
+        }
+    }
+
+//Count at EL1 and EL0. Kernel and tasks both run at EL1.
+    asm volatile (
+        "msr pmevtyper0_el0, %0\n"
+        "msr pmevtyper1_el0, %1\n"
+        "msr pmevtyper2_el0, %2\n"
+        "msr pmevtyper3_el0, %3\n"
+        "msr pmevtyper4_el0, %4\n"
+        "msr pmevtyper5_el0, %5\n"
+        "msr pmccfiltr_el0, xzr\n"
+        "msr pmcntenset_el0, %6\n"
+        "msr pmcr_el0, %7\n"
+        "isb\n"
+        :: "r"((u64_t) KERNEL_PMU_EVENT_0), "r"((u64_t) KERNEL_PMU_EVENT_1),
+           "r"((u64_t) KERNEL_PMU_EVENT_2), "r"((u64_t) KERNEL_PMU_EVENT_3),
+           "r"((u64_t) KERNEL_PMU_EVENT_4), "r"((u64_t) KERNEL_PMU_EVENT_5),
+           "r"(KERNEL_PMU_CNTEN),
+           "r"((u64_t) (KERNEL_PMU_PMCR_E | KERNEL_PMU_PMCR_P | 
+                        KERNEL_PMU_PMCR_C | KERNEL_PMU_PMCR_LC))
+        :
+    );
+
+    k->pmu_task = 0;
+    kernel_pmu_read(k->pmu_stamp);
+
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_pmu_init(): PMU counting events "
+                         "0x%llX 0x%llX 0x%llX 0x%llX 0x%llX 0x%llX on core "
+                         "%llu.\n", 
+                         (u64_t) KERNEL_PMU_EVENT_0, (u64_t) KERNEL_PMU_EVENT_1,
+                         (u64_t) KERNEL_PMU_EVENT_2, (u64_t) KERNEL_PMU_EVENT_3,
+                         (u64_t) KERNEL_PMU_EVENT_4, (u64_t) KERNEL_PMU_EVENT_5,
+                         k->core);
+}
+
+void kernel_pmu_switch(kernel *k, u64_t task) {
+    u64_t *from = k->tasks[k->pmu_task].pmu;
+    u64_t cnt[KERNEL_PMU_COUNTERS];
+    u64_t i;
+
+    kernel_pmu_read(cnt);
+
+    from[0] += cnt[0] - k->pmu_stamp[0];
+    k->pmu_stamp[0] = cnt[0];
+
+//Event counters wrap at 32 bits. Tasks are switched or the kernel is
+//entered far more often than that.
+    for (i = 1; i < KERNEL_PMU_COUNTERS; ++i) {
+        from[i] += (u32_t) (cnt[i] - k->pmu_stamp[i]);
+        k->pmu_stamp[i] = cnt[i];
+    }
+
+    k->pmu_task = task;
+}
+
+u64_t kernel_pmu_count(kernel *k, u64_t task, u64_t counter) {
+    kernel *owner;
+
+    if (task >= k->num_tasks || counter >= KERNEL_PMU_COUNTERS) {
+        return 0;
+    }
+
+//Bring the caller's core up to date.
+    kernel_pmu_switch(k, k->pmu_task);
+
+//Tasks are counted on the core which runs them. Task0 is the caller's
+//kernel.
+    owner = task ? kernel_get_core_pointer(kernel_task_core(task)) : k;
+    if (!owner) {
+        return 0;
+    }
+
+    return owner->tasks[task].pmu[counter];
+}
+
+void kernel_pmu_print(kernel *k) {
+    u64_t i, *c;
+
+    kernel_pmu_switch(k, k->pmu_task);
+
+//Instructions per cycle and misses per thousand instructions are 
+//printed in hundredths.
+    for (i = 0; i < k->num_tasks; ++i) {
+        if (i && kernel_task_core(i) != k->core) {
+            continue;
+        }
+
+        c = k->tasks[i].pmu;
+        if (!c[KERNEL_PMU_CYCLES] || !c[KERNEL_PMU_INSTRUCTIONS]) {
+            continue;
+        }
+
+//Two messages. Binary log frames hold at most LOG_BIN_ARGS_MAX values.
+        LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_pmu_print(): Task %llu cycles "
+                             "0x%llX instructions 0x%llX IPC %llu/100\n",
+                             i, c[KERNEL_PMU_CYCLES], 
+                             c[KERNEL_PMU_INSTRUCTIONS],
+                             c[KERNEL_PMU_INSTRUCTIONS] * 100 / 
+                             c[KERNEL_PMU_CYCLES]);
+        LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_pmu_print(): Task %llu MPKI "
+                             "L1D %llu/100 L2D %llu/100 branch %llu/100 "
+                             "stalled fetch %llu%% load %llu%%\n", i,
+                             c[KERNEL_PMU_L1D_REFILLS] * 100000 / 
+                             c[KERNEL_PMU_INSTRUCTIONS],
+                             c[KERNEL_PMU_L2D_REFILLS] * 100000 / 
+                             c[KERNEL_PMU_INSTRUCTIONS],
+                             c[KERNEL_PMU_BRANCH_MISSES] * 100000 / 
+                             c[KERNEL_PMU_INSTRUCTIONS],
+                             c[KERNEL_PMU_FETCH_STALLS] * 100 / 
+                             c[KERNEL_PMU_CYCLES],
+                             c[KERNEL_PMU_LOAD_STALLS] * 100 / 
+                             c[KERNEL_PMU_CYCLES]);
+    }
+}
+
+#else
+
+u64_t kernel_pmu_count(kernel *k, u64_t task, u64_t counter) {
+    return 0;
+}
+
+void kernel_pmu_print(kernel *k) {
+}
+
+#endif
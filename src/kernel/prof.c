@@ -0,0 +1,178 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//prof.c
+// Sampling profiler. The PMU cycle counter is started KERNEL_PROF_PERIOD
+// cycles before it overflows. The overflow interrupt counts the 
+// interrupted PC, as an offset into the running task's image, in that
+// task's histogram and starts the next countdown. Histograms live in 
+// kernel_task like run times so a stolen task takes its samples with
+// it. Samples taken while the kernel (task0) or idle run are counted
+// in task0's histogram on each core.
+//
+// tools/prof maps the buckets back to symbols in the task ELF files.
+//
+
+#include "kernel.h"
+#include "irq.h"
+#include "uart.h"
+
+#define LOG_MODULE LOG_MOD_PMU
+#include "log.h"
+
+#ifdef KERNEL_PROF
+
+//
+//KERNEL_PROF_CYCLES
+// PMCNTENSET_EL0, PMINTENSET_EL1 and PMOVSCLR_EL0 bit of the cycle 
+// counter.
+//
+#define KERNEL_PROF_CYCLES ((u64_t) 1 << 31)
+
+//
+//KERNEL_PROF_PMCR
+// PMCR_EL0 enable (E) and 64 bit cycle counter (LC) bits.
+//
+#define KERNEL_PROF_PMCR   0x41
+
+//
+//kernel_prof_rearm()
+// Start the cycle counter KERNEL_PROF_PERIOD cycles before overflow.
+// With KERNEL_PMU the cycles counted so far are charged first so the
+// rewrite does not show up in task cycle counts.
+//
+static inline void kernel_prof_rearm(kernel *k) {
+    u64_t start = -(u64_t) KERNEL_PROF_PERIOD;
+
+#ifdef KERNEL_PMU
+    kernel_pmu_switch(k, k->pmu_task);
+    k->pmu_stamp[KERNEL_PMU_CYCLES] = start;
+#endif
+
+    asm volatile (
+        "msr pmovsclr_el0, %0\n"
+        "msr pmccntr_el0, %1\n"
+        "isb\n"
+        :: "r"(KERNEL_PROF_CYCLES), "r"(start) :
+    );
+}
+
+void kernel_prof_init(kernel *k) {
+    u64_t i, j, pmcr;
+    kernel_task *t;
+
+    for (i = 0; i < KERNEL_TASKS_MAX; ++i) {
+        t = &k->tasks[i];
+        t->prof_end   = 0;
+        t->prof_shift = 2;
+        t->prof_other = 0;
+        for (j = 0; j < KERNEL_PROF_BUCKETS; ++j) {
+            t->prof[j] = 0;
+        }
+    }
+
+//Buckets cover the R/O code and data at the start of each image.
+    for (i = 0; i < k->num_tasks; ++i) {
+        t = &k->tasks[i];
+        t->prof_end = task_get_list_item(i)->ro_end;
+        while ((t->prof_end >> t->prof_shift) >= KERNEL_PROF_BUCKETS) {
+            ++t->prof_shift;
+        }
+    }
+
+    k->prof_samples = 0;
+
+//Count cycles at EL1 and EL0 and interrupt on overflow. Event counters
+//are left as kernel_pmu_init() set them.
+    asm volatile ("mrs %0, pmcr_el0\n" : "=r"(pmcr) :: );
+    asm volatile (
+        "msr pmccfiltr_el0, xzr\n"
+        "msr pmcntenset_el0, %0\n"
+        "msr pmintenset_el1, %0\n"
+        "msr pmcr_el0, %1\n"
+        :: "r"(KERNEL_PROF_CYCLES), "r"(pmcr | KERNEL_PROF_PMCR) :
+    );
+    kernel_prof_rearm(k);
+    irq_pmu_enable(k->core);
+
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_prof_init(): Sampling every "
+                         "%llu cycles on core %llu.\n", 
+                         (u64_t) KERNEL_PROF_PERIOD, k->core);
+}
+
+void kernel_prof_sample(kernel *k) {
+    kernel_task *t = &k->tasks[k->task];
+    u64_t pc;
+
+    asm volatile ("mrs %0, elr_el1\n" : "=r"(pc) :: );
+    pc -= task_get_base_addr(k->task);
+
+    if (pc < t->prof_end) {
+        ++t->prof[pc >> t->prof_shift];
+    } else {
+        ++t->prof_other;
+    }
+    ++k->prof_samples;
+
+    kernel_prof_rearm(k);
+}
+
+void kernel_prof_dump(kernel *k) {
+    kernel_task *t;
+    u64_t i, j;
+
+    uart_printf("rpi3rtos::prof: begin 0x%016llX 0x%016llX 0x%016llX\n",
+                k->core, (u64_t) KERNEL_PROF_PERIOD, k->prof_samples);
+
+    for (i = 0; i < k->num_tasks; ++i) {
+        if (i && kernel_task_core(i) != k->core) {
+            continue;
+        }
+
+        t = &k->tasks[i];
+        uart_printf("rpi3rtos::prof: task 0x%016llX 0x%016llX 0x%016llX\n",
+                    i, t->prof_shift, t->prof_other);
+
+//Only buckets with samples. Offset of the bucket in the task image.
+        for (j = 0; j < KERNEL_PROF_BUCKETS; ++j) {
+            if (t->prof[j]) {
+                uart_printf("rpi3rtos::prof: 0x%016llX 0x%08X\n",
+                            j << t->prof_shift, t->prof[j]);
+            }
+        }
+    }
+
+    uart_puts("rpi3rtos::prof: end\n");
+}
+
+#else
+
+void kernel_prof_dump(kernel *k) {
+    uart_printf("rpi3rtos::prof: begin 0x%016llX 0x%016llX 0x%016llX\n",
+                k->core, (u64_t) 0, (u64_t) 0);
+    uart_puts("rpi3rtos::prof: end\n");
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//queue.c
+// Ready queue. A fixed number of priority levels each with a FIFO of
+// ready tasks. A bitmap summarizes which levels hold tasks so every
+// operation is constant time regardless of the number of tasks.
+//
+
+#include "kernel.h"
+
+//
+//kernel_queue_level()
+// Clamp a task priority to a ready queue level.
+//
+static inline u64_t kernel_queue_level(i64_t priority) {
+    if (priority < 0) {
+        return 0;
+    } else if (priority >= KERNEL_QUEUE_LEVELS) {
+        return KERNEL_QUEUE_LEVELS - 1;
+    }
+    return (u64_t) priority;
+}
+
+void kernel_queue_init(kernel_queue *q) {
+    u64_t i;
+    q->bitmap = 0;
+    q->count  = 0;
+    for (i = 0; i < KERNEL_QUEUE_LEVELS; ++i) {
+        q->levels[i].head = 0;
+        q->levels[i].tail = 0;
+    }
+}
+
+void kernel_queue_psh(kernel *k, u64_t task) {
+    u64_t lvl = kernel_queue_level(k->tasks[task].priority);
+    kernel_task_node_list_tail_psh(k, &k->queue.levels[lvl], task);
+    k->queue.bitmap |= ((u64_t) 1 << lvl);
+    ++k->queue.count;
+}
+
+void kernel_queue_rmv(kernel *k, u64_t task) {
+//Node remembers which level it was pushed on. Priority may have been
+//changed since.
+    kernel_nd_lst *list = k->tasks[task].node.list;
+    u64_t lvl = list - k->queue.levels;
+
+    kernel_task_node_list_rmv(k, list, task);
+
+    if (0 == list->head) {
+        k->queue.bitmap &= ~((u64_t) 1 << lvl);
+    }
+    --k->queue.count;
+}
+
+u64_t kernel_queue_first(kernel *k) {
+    u64_t lvl;
+
+    if (0 == k->queue.bitmap) {
+        return 0;
+    }
+
+    lvl = 63 - __builtin_clzll(k->queue.bitmap);
+    return k->queue.levels[lvl].head->task;
+}
+
+u64_t kernel_queue_stealable(kernel *k, u64_t core) {
+    u64_t bitmap = k->queue.bitmap;
+    u64_t lvl, affinity;
+    kernel_nd_item *nd;
+
+//Highest priority level first.
+    while (bitmap) {
+        lvl = 63 - __builtin_clzll(bitmap);
+
+        for (nd = k->queue.levels[lvl].head; nd; nd = nd->next) {
+            affinity = k->tasks[nd->task].header->affinity;
+//A task is only saved once the exception stub has stored its stack
+//pointer. The caller of a blocking syscall waits for this kernel.
+            if (nd->task != k->task && nd->task != k->caller &&
+                nd->task != k->fp_owner && k->tasks[nd->task].sp &&
+                (!affinity || (affinity & ((u64_t) 1 << core))))
+            {
+                return nd->task;
+            }
+        }
+
+        bitmap &= ~((u64_t) 1 << lvl);
+    }
+
+    return 0;
+}
+
+u64_t kernel_queue_has_peer(kernel *k, u64_t task) {
+    kernel_nd_lst *list = k->tasks[task].node.list;
+    return list->head != list->tail;
+}
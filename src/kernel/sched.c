@@ -0,0 +1,357 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//sched.c
+// Scheduler core. Moves tasks between the ready queue, the sleep timer
+// wheel and the suspend list in response to syscalls and ticks. Has no
+// hardware dependencies so it is also built on the host (see 
+// tools/bench).
+//
+
+#include "kernel.h"
+
+#define LOG_MODULE LOG_MOD_KERNEL
+#include "log.h"
+
+//
+//Emitted where the task node helpers in kernel.h are not inlined.
+//
+extern void kernel_queue_task_node_add(kernel *k, u64_t task);
+extern void kernel_suspend_task_node_add(kernel *k, u64_t task);
+extern void kernel_sleep_task_node_add(kernel *k, u64_t task);
+extern void kernel_queue_task_node_rmv(kernel *k, u64_t task);
+extern void kernel_suspend_task_node_rmv(kernel *k, u64_t task);
+extern void kernel_sleep_task_node_rmv(kernel *k, u64_t task);
+
+//
+//kernel_task_flags_print()
+// Helper function prints kernel task flags.
+//
+void kernel_task_flags_print(u64_t flags) {
+    LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_task_flags_print(): Task flags: \n");
+
+    if (flags & KERNEL_TASK_FLAG_SUSPENDED) {
+        LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_task_flags_print(): KERNEL_TASK_FLAG_SUSPENDED\n");
+    }
+
+    if (flags & KERNEL_TASK_FLAG_SLEEPING) {
+        LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_task_flags_print(): KERNEL_TASK_FLAG_SLEEPING\n");
+    }
+
+    if (flags & KERNEL_TASK_FLAG_WAKEUP_POST_INIT) {
+        LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_task_flags_print(): KERNEL_TASK_FLAG_WAKEUP_POST_INIT\n");
+    }
+
+    if (flags & KERNEL_TASK_FLAG_WAKEUP_POST_RESET) {
+        LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_task_flags_print(): KERNEL_TASK_FLAG_WAKEUP_POST_RESET\n");
+    }
+
+    if (flags & KERNEL_TASK_FLAG_WAKEUP_UART0_RX) {
+        LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_task_flags_print(): KERNEL_TASK_FLAG_WAKEUP_UART0_RX\n");
+    }
+
+    if (flags & KERNEL_TASK_FLAG_WAKEUP_UART0_TX) {
+        LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_task_flags_print(): KERNEL_TASK_FLAG_WAKEUP_UART0_TX\n");
+    }
+}
+
+//*********************************************************************
+// Kernel Task Node List Routines
+//  List manipulation lives in node.c. Validation is a debugging aid.
+//  Only debug builds validate.
+//*********************************************************************
+
+void kernel_task_node_list_validate(kernel_nd_lst *list) {
+    kernel_nd_item *cur = list->head;
+    kernel_nd_item *prev = 0;
+    u64_t i = 0;
+
+    if (!LOG_ON(LOG_DEBUG)) {
+        return;
+    }
+
+    if(list->head) {
+        if (list->tail) {
+            if (list->tail->next) {
+                LOG_PUTS(LOG_ERROR, "rpi3rtos::kernel_task_node_list_validate(): "
+                                  "tail->next set. Panic.\n");
+                kernel_panic();
+            }
+        } else {
+            LOG_PUTS(LOG_ERROR, "rpi3rtos::kernel_task_node_list_validate(): "
+                                "Head set but not tail. Panic.\n");
+            kernel_panic();
+        }
+        if (list->head->prev) {
+            LOG_PUTS(LOG_ERROR, "rpi3rtos::kernel_task_node_list_validate(): "
+                              "head->prev set. Panic.\n");
+            kernel_panic();
+        }
+    } else if(list->tail) {
+        LOG_PUTS(LOG_ERROR, "rpi3rtos::kernel_task_node_list_validate(): "
+                            "Tail set but not head. Panic.\n");
+        kernel_panic();
+    }
+
+    while(cur) {
+        LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_task_node_list_validate(): "
+                              "Task 0x%llX\n", cur->task);
+
+        ++i;
+        prev = cur;
+        cur  = cur->next;
+        if(cur) {
+            if (cur->prev != prev) {
+                LOG_PUTS(LOG_ERROR, "rpi3rtos::kernel_task_node_list_validate(): "
+                          "cur->prev does not match prev. Panic.\n");
+                kernel_panic();
+            }
+        }
+    }
+
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_task_node_list_validate(): List "
+                          "length is 0x%llX\n", i);
+}
+
+//*********************************************************************
+// Kernel Queue Specific Task Node Routines
+//  Implements the priority queue operations. See queue.c.
+//*********************************************************************
+
+//
+//kernel_queue_task_node_pos_update()
+// A change in a task priority requires updating its position in the
+// queue. The task is moved to the back of the FIFO for its (possibly
+// new) priority level. Calling this without a priority change moves
+// the task behind the other tasks with the same priority which is how
+// round-robin is implemented.
+//
+void kernel_queue_task_node_pos_update(kernel *k, u64_t task) {
+    kernel_queue_rmv(k, task);
+    kernel_queue_psh(k, task);
+}
+
+//*********************************************************************
+// Kernel Queue Task Routines
+//  Helper functions remove code duplication.
+//*********************************************************************
+
+void kernel_queue_task_suspend_and_update(kernel *k, u64_t task) {
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_queue_task_suspend_and_update(): "
+                          "Suspending task 0x%llX. Flags: \n", task);
+    kernel_task_flags_print(k->sysarg.value);
+
+//Update task flags.
+    k->tasks[task].flags |= k->sysarg.value;
+
+//Update queue.
+    LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_queue_task_suspend_and_update(): Remove from queue.\n");
+    kernel_trace_psh(&k->trace, KERNEL_TRACE_SUSPEND, task, k->sysarg.value);
+    kernel_queue_task_node_rmv(k, task);     //Remove from queue.
+    kernel_suspend_task_node_add(k, task);   //Add to suspend list.
+    kernel_task_node_list_validate(&k->suspend);
+}
+
+void kernel_queue_task_sleep_and_update(kernel *k, u64_t task) {
+    u64_t wakeup = (k->sysarg.value + 
+                    KERNEL_TICK_DURATION_MS - 1) /
+                    KERNEL_TICK_DURATION_MS;
+
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_queue_task_sleep_and_update(): "
+                          "Putting task 0x%llX to sleep for 0x%llX ms rounded "
+                          "up to 0x%llX ticks.\n",
+                          task, k->sysarg.value, wakeup);
+
+//Set absolute wakeup time in kernel ticks.
+    k->tasks[task].wakeup = k->time + wakeup;
+    kernel_trace_psh(&k->trace, KERNEL_TRACE_SLEEP, task, k->sysarg.value * 1000);
+
+//Update queue.
+    LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_queue_task_sleep_and_update(): Remove from queue.\n");
+    kernel_queue_task_node_rmv(k, task);     //Remove from queue.
+    kernel_sleep_task_node_add(k, task);     //Add to sleep timer wheel.
+}
+
+void kernel_queue_task_priority_and_update(kernel *k, u64_t task) {
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_queue_task_priority_and_update(): "
+                          "Change priority of task 0x%llX from 0x%llX to "
+                          "0x%llX.\n", task, (u64_t) k->tasks[task].priority, 
+                          k->sysarg.value);
+
+    if (k->sysarg.lo) {
+        if (k->tasks[task].priority != k->sysarg.lo) {
+//Change task priority.
+            LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_queue_task_priority_and_update(): Update priority in queue.\n");
+            k->tasks[task].priority = (u64_t) k->sysarg.lo;
+            kernel_queue_task_node_pos_update(k, task);
+            k->task = kernel_queue_first(k);
+        }
+    }
+
+    if (k->sysarg.hi) {
+//Change task queue options.
+        k->tasks[task].flags &= KERNEL_TASK_FLAG_QUEUE_CLEAR_ALL;
+        k->tasks[task].flags |= k->sysarg.hi;
+    }
+}
+
+void kernel_queue_task_yield_and_update(kernel *k, u64_t task) {
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_queue_task_yield_and_update(): "
+                          "Task 0x%llX is yielding...\n", task);
+//Move behind tasks with the same priority.
+    kernel_queue_task_node_pos_update(k, task);
+    k->task = kernel_queue_first(k);
+}
+
+//*********************************************************************
+// Kernel Service Routines
+//  Called from the main kernel loop and kernel_schedule().
+//*********************************************************************
+
+//
+//kernel_service_sleeping()
+// If pending ticks then service the sleeping tasks. Remove ready to 
+// wake tasks from the sleep timer wheel and insert in the priority
+// queue. Only tasks which expire are visited.
+//
+void kernel_service_sleeping(kernel *k) {
+    u64_t task;
+
+    while ((task = kernel_sleep_expired(k, k->time))) {
+        if (k->tasks[task].wakeup < k->time) {
+//Kernel did not get around to servicing the tick the task should have
+//woken up on.
+            LOG_PRINTF(LOG_WARN, "rpi3rtos::kernel_service_sleeping(): Task "
+                                 "0x%llX overslept and is ready to wake up.\n",
+                                 task);
+            k->tasks[task].header->flags |= TASK_HEADER_FLAG_OVERSLEPT;
+        } else {
+            LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_service_sleeping(): Task "
+                                  "0x%llX is ready to wake up.\n", task);
+        }
+
+//Already removed from the timer wheel. Add to queue.
+        k->tasks[task].flags &= ~KERNEL_TASK_FLAG_SLEEPING;
+        kernel_queue_task_node_add(k, task);
+        kernel_trace_psh(&k->trace, KERNEL_TRACE_WAKEUP, task, 0);
+        kernel_stats_wakeup(k, task);
+    }
+}
+
+//
+//kernel_service_suspended()
+// Determine if conditions exist for task resume and if appropriate 
+// resume.
+//
+void kernel_service_suspended(kernel *k) {
+    kernel_nd_item *cur = k->suspend.head;
+
+    while(cur) {
+        LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_service_suspended(): Servicing "
+                              "suspended task 0x%llX.\n", (u64_t) cur->task);
+        kernel_task_flags_print(k->tasks[cur->task].flags);
+
+        if (k->tasks[cur->task].flags & KERNEL_SYSCALL_SUSPEND) {
+            if (k->tasks[cur->task].flags & 
+                KERNEL_TASK_FLAG_WAKEUP_POST_INIT)
+            {
+//Suspended after init. Remove from suspend list and add to priority queue.
+                LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_service_suspended(): Ready to wake up.\n");
+
+                kernel_nd_item *nd = cur;
+                cur = cur->next;
+                k->tasks[nd->task].flags &= KERNEL_TASK_FLAG_WAKEUP_CLEAR_ALL;
+//Update queue.
+                kernel_suspend_task_node_rmv(k, nd->task); //Remove from suspend list.
+                kernel_queue_task_node_add(k, nd->task);   //Add to queue.
+                k->task = kernel_queue_first(k);             //Update current task.
+                kernel_trace_psh(&k->trace, KERNEL_TRACE_WAKEUP, nd->task, 0);
+                kernel_stats_wakeup(k, nd->task);
+
+                kernel_task_node_list_validate(&k->suspend);
+
+                continue;
+            }
+
+            if (k->tasks[cur->task].flags & 
+                KERNEL_TASK_FLAG_WAKEUP_POST_RESET)
+            {
+//Suspended after reset. Remove from suspend list and add to priority queue.
+                LOG_PUTS(LOG_DEBUG, "rpi3rtos::kernel_service_suspended(): Ready to wake up.\n");
+
+                kernel_nd_item *nd = cur;
+                cur = cur->next;
+
+                k->tasks[nd->task].flags &= KERNEL_TASK_FLAG_WAKEUP_CLEAR_ALL;
+//Update queue.
+                kernel_suspend_task_node_rmv(k, nd->task); //Remove from suspend list.
+                kernel_queue_task_node_add(k, nd->task);   //Add to queue.
+                k->task = kernel_queue_first(k);             //Update current task.
+                kernel_trace_psh(&k->trace, KERNEL_TRACE_WAKEUP, nd->task, 0);
+                kernel_stats_wakeup(k, nd->task);
+
+                kernel_task_node_list_validate(&k->suspend);
+
+                continue;
+            }
+        }
+        cur = cur->next;
+    }
+}
+
+u64_t kernel_suspend_wakeable(kernel *k) {
+    kernel_nd_item *cur;
+
+    for (cur = k->suspend.head; cur; cur = cur->next) {
+        if ((k->tasks[cur->task].flags & KERNEL_SYSCALL_SUSPEND) &&
+            (k->tasks[cur->task].flags & (KERNEL_TASK_FLAG_WAKEUP_POST_INIT |
+                                          KERNEL_TASK_FLAG_WAKEUP_POST_RESET)))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void kernel_service_tick(kernel *k) {
+    u64_t first = kernel_queue_first(k);
+
+//Update current task. If no tasks on queue then current is kernel.
+    if (first) {
+        if (first == k->task) {
+            if (k->tasks[first].flags & 
+                KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN) 
+            {
+//This should move the current task to the back of the list of tasks
+//with the same priority. Easy way to do round-robin prioritizing.
+                kernel_queue_task_node_pos_update(k, k->task);
+            }
+        }
+        k->task = kernel_queue_first(k);
+    } else {
+        k->task = 0;
+    }
+}
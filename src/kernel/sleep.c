@@ -0,0 +1,145 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//sleep.c
+// Sleep timer wheel. Sleeping tasks are hashed into slots by the
+// absolute tick they expire on. Slots are sorted by expiry so each
+// tick only looks at the head of one slot and the tasks that actually
+// expire. The number of sleeping tasks is not limited by the wheel.
+//
+
+#include "kernel.h"
+
+#define KERNEL_SLEEP_SLOTS_MASK (KERNEL_SLEEP_SLOTS - 1)
+
+void kernel_sleep_init(kernel_sleep *s, u64_t time) {
+    u64_t i;
+    s->time  = time;
+    s->count = 0;
+    for (i = 0; i < KERNEL_SLEEP_SLOTS; ++i) {
+        s->slots[i].head = 0;
+        s->slots[i].tail = 0;
+    }
+}
+
+void kernel_sleep_psh(kernel *k, u64_t task) {
+    kernel_nd_lst  *slot;
+    kernel_nd_item *nd = &k->tasks[task].node;
+    kernel_nd_item *cur;
+
+//Ticks before the wheel position have already been serviced. Wake up
+//on the next one.
+    if (k->tasks[task].wakeup < k->sleep.time) {
+        k->tasks[task].wakeup = k->sleep.time;
+    }
+
+    slot = &k->sleep.slots[k->tasks[task].wakeup & KERNEL_SLEEP_SLOTS_MASK];
+
+//Search from the back. Sleeps of similar length are appended in O(1).
+    for (cur = slot->tail; cur; cur = cur->prev) {
+        if (k->tasks[cur->task].wakeup <= k->tasks[task].wakeup) {
+            break;
+        }
+    }
+
+    nd->list = slot;
+    nd->prev = cur;
+
+    if (cur) {
+        nd->next  = cur->next;
+        cur->next = nd;
+    } else {
+        nd->next   = slot->head;
+        slot->head = nd;
+    }
+
+    if (nd->next) {
+        nd->next->prev = nd;
+    } else {
+        slot->tail = nd;
+    }
+
+    ++k->sleep.count;
+}
+
+void kernel_sleep_rmv(kernel *k, u64_t task) {
+    kernel_task_node_list_rmv(k, k->tasks[task].node.list, task);
+    --k->sleep.count;
+}
+
+u64_t kernel_sleep_expired(kernel *k, u64_t now) {
+    kernel_sleep *s = &k->sleep;
+
+    if (0 == s->count) {
+        s->time = now + 1;
+        return 0;
+    }
+
+//One turn of the wheel visits every slot.
+    if (now + 1 - s->time > KERNEL_SLEEP_SLOTS) {
+        s->time = now + 1 - KERNEL_SLEEP_SLOTS;
+    }
+
+    while (s->time <= now) {
+        kernel_nd_item *nd = s->slots[s->time & KERNEL_SLEEP_SLOTS_MASK].head;
+
+        if (nd && k->tasks[nd->task].wakeup <= now) {
+            u64_t task = nd->task;
+            kernel_sleep_rmv(k, task);
+            return task;
+        }
+
+        ++s->time;
+    }
+
+    return 0;
+}
+
+u64_t kernel_sleep_next(kernel *k) {
+    kernel_sleep *s = &k->sleep;
+    u64_t t, min = KERNEL_SLEEP_NEVER;
+
+    if (0 == s->count) {
+        return KERNEL_SLEEP_NEVER;
+    }
+
+//Walk forward from the wheel position. A slot head expiring in this
+//turn of the wheel is the earliest. Otherwise every task expires in a
+//later turn and the earliest is the smallest slot head.
+    for (t = s->time; t < s->time + KERNEL_SLEEP_SLOTS; ++t) {
+        kernel_nd_item *nd = s->slots[t & KERNEL_SLEEP_SLOTS_MASK].head;
+
+        if (nd) {
+            u64_t wakeup = k->tasks[nd->task].wakeup;
+            if (wakeup == t) {
+                return t;
+            } else if (wakeup < min) {
+                min = wakeup;
+            }
+        }
+    }
+
+    return min;
+}
@@ -0,0 +1,203 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//smp.c
+// Multi-core start up. Each core runs its own kernel with its own 
+// stack, vector table, generic timer and ready queue. Tasks are 
+// assigned to a core at load time and stay there.
+//
+
+#include "kernel.h"
+
+#define LOG_MODULE LOG_MOD_SMP
+#include "log.h"
+
+//
+//Assigned core for each task. Written by core 0 before cores 1-3 are
+//released.
+//
+u64_t g_kernel_task_core[KERNEL_TASKS_MAX];
+
+//
+//Number of loaded tasks.
+//
+u64_t g_kernel_num_tasks = 0;
+
+//
+//Initial kernel stack pointer for each core. Read by 
+//__kernel_secondary_start.
+//
+u64_t g_kernel_core_sp[PLATFORM_CORES];
+
+u64_t kernel_task_core(u64_t task) {
+    return g_kernel_task_core[task];
+}
+
+//
+//kernel_smp_assign()
+// Assign each task to the allowed core with the fewest tasks.
+//
+void kernel_smp_assign(u64_t num_tasks) {
+    u64_t count[PLATFORM_CORES];
+    u64_t i, c, affinity, core;
+
+    for (c = 0; c < PLATFORM_CORES; ++c) {
+        count[c] = 0;
+    }
+
+//Task0 (kernel) runs on every core. Recorded as core 0.
+    g_kernel_task_core[0] = 0;
+
+    for (i = 1; i < num_tasks; ++i) {
+        affinity = task_get_header(i)->affinity & ((0x1 << KERNEL_CORES) - 1);
+        if (!affinity) {
+            affinity = (0x1 << KERNEL_CORES) - 1;
+        }
+
+        core = KERNEL_CORES;
+        for (c = 0; c < KERNEL_CORES; ++c) {
+            if ((affinity & (0x1 << c)) && 
+                (KERNEL_CORES == core || count[c] < count[core])) 
+            {
+                core = c;
+            }
+        }
+
+        ++count[core];
+        g_kernel_task_core[i] = core;
+
+        LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_smp_assign(): Task 0x%llX "
+                             "assigned to core 0x%llX.\n", i, core);
+    }
+}
+
+void kernel_smp_start(u64_t num_tasks) {
+    u64_t base = task_get_base_addr(0);
+    u64_t c;
+
+    g_kernel_num_tasks = num_tasks;
+    kernel_smp_assign(num_tasks);
+
+//Core 0 uses the stack it is already on.
+    for (c = 1; c < KERNEL_CORES; ++c) {
+        g_kernel_core_sp[c] = base - c * KERNEL_CORE_STACK_SZ;
+
+        LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_smp_start(): Releasing core "
+                             "0x%llX with stack at 0x%llX.\n",
+                             c, g_kernel_core_sp[c]);
+
+        *PLATFORM_SPIN_TABLE(c) = (u64_t) __kernel_secondary_start + base;
+    }
+
+//Make the writes visible then wake the parked cores.
+    asm volatile (
+        "dsb sy\n"
+        "sev\n"
+    );
+}
+
+void kernel_secondary_main(u64_t core) {
+    kernel k;
+
+    LOG_PRINTF(LOG_INFO, "rpi3rtos::kernel_secondary_main(): Core 0x%llX "
+                         "started.\n", core);
+
+    kernel_init(&k, g_kernel_num_tasks);
+    kernel_main(&k);
+}
+
+//
+//kernel_steal_victim()
+// Core with the most ready tasks which are not running. Read without
+// locks so only a hint. Returns 0 if there is none.
+//
+kernel *kernel_steal_victim(kernel *k) {
+    kernel *victim = 0;
+    kernel *peer;
+    u64_t c, ready, most = 1;
+
+    for (c = 0; c < KERNEL_CORES; ++c) {
+        peer = kernel_get_core_pointer(c);
+        if (c == k->core || !peer || !peer->online) {
+            continue;
+        }
+
+        ready = peer->queue.count - (peer->task ? 1 : 0);
+        if (ready >= most) {
+            most   = ready;
+            victim = peer;
+        }
+    }
+
+    return victim;
+}
+
+u64_t kernel_steal(kernel *k) {
+    kernel *victim = kernel_steal_victim(k);
+    u64_t task;
+
+    if (!victim) {
+        return 0;
+    }
+
+//Interrupts are masked so never wait for the victim. It may hold its 
+//lock for a long time, for example while waiting for room to print.
+//Only one lock is held at a time so cores stealing from each other can
+//not deadlock.
+    if (!kernel_lock_try_acquire(&victim->lock)) {
+        return 0;
+    }
+
+    task = kernel_queue_stealable(victim, k->core);
+    if (!task) {
+        kernel_lock_release(&victim->lock);
+        return 0;
+    }
+
+    kernel_queue_rmv(victim, task);
+    k->tasks[task] = victim->tasks[task];
+    ++victim->migrations;
+
+    kernel_lock_release(&victim->lock);
+
+//Not queued anywhere. Nothing else looks at the task until it is 
+//pushed on this core's queue.
+    k->tasks[task].node.list = 0;
+    k->tasks[task].node.next = 0;
+    k->tasks[task].node.prev = 0;
+    g_kernel_task_core[task] = k->core;
+
+    kernel_lock_acquire(&k->lock);
+    kernel_queue_psh(k, task);
+    ++k->steals;
+    kernel_trace_psh(&k->trace, KERNEL_TRACE_STEAL, task, victim->core);
+    kernel_lock_release(&k->lock);
+
+    LOG_PRINTF(LOG_DEBUG, "rpi3rtos::kernel_steal(): Core 0x%llX stole task "
+                          "0x%llX from core 0x%llX.\n",
+                          k->core, task, victim->core);
+
+    return 1;
+}
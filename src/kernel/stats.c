@@ -0,0 +1,117 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//stats.c
+// Shared statistics page. The kernels keep per task switch, syscall, 
+// run time and wakeup latency figures and per core IRQ counts and 
+// ready queue depths in one 4kB page which any task may read in place.
+// A monitoring task samples it without making syscalls. Each task's 
+// entry is written by the core running the task.
+//
+
+#include "kernel.h"
+
+//
+//Emitted where kernel_stats_wakeup() is not inlined.
+//
+extern void kernel_stats_wakeup(kernel *k, u64_t task);
+
+_Static_assert(sizeof(kernel_stats) == 0x1000, 
+               "Statistics must fit in one 4kB page.");
+
+kernel_stats g_kernel_stats;
+
+void kernel_stats_init(kernel *k) {
+    u64_t i;
+
+    g_kernel_stats.magic     = KERNEL_STATS_MAGIC;
+    g_kernel_stats.num_tasks = k->num_tasks;
+    g_kernel_stats.num_cores = PLATFORM_CORES;
+
+    g_kernel_stats.cores[k->core].irqs  = 0;
+    g_kernel_stats.cores[k->core].ready = k->queue.count;
+
+//Tasks of other cores may already be running.
+    for (i = 1; i < k->num_tasks; ++i) {
+        k->tasks[i].ready = 0;
+
+        if (kernel_task_core(i) != k->core) {
+            continue;
+        }
+
+        g_kernel_stats.tasks[i].voluntary   = 0;
+        g_kernel_stats.tasks[i].involuntary = 0;
+        g_kernel_stats.tasks[i].syscalls    = 0;
+        g_kernel_stats.tasks[i].runtime     = 0;
+        g_kernel_stats.tasks[i].latency     = 0;
+        g_kernel_stats.tasks[i].core        = k->core;
+
+//The MMU is off so tasks read the page at its physical address. With
+//the MMU on mmu_enable() maps it read-only at each task's 
+//MMU_SHARED_PAGE instead.
+        task_get_header(i)->stats = (u64_t) &g_kernel_stats;
+    }
+}
+
+void kernel_stats_switch_out(kernel *k, u64_t task, u64_t how) {
+    kernel_stats_task *s = &g_kernel_stats.tasks[task];
+
+    g_kernel_stats.cores[k->core].ready = k->queue.count;
+
+//Kernel is not a task.
+    if (!task) {
+        return;
+    }
+
+    if (KERNEL_STATS_VOLUNTARY == how) {
+        ++s->voluntary;
+    } else if (KERNEL_STATS_INVOLUNTARY == how) {
+        ++s->involuntary;
+    }
+
+    s->runtime = hrtimer_count_to_ns(&k->hrtimers, k->tasks[task].runtime);
+}
+
+void kernel_stats_switch_in(kernel *k, u64_t task) {
+    kernel_stats_task *s = &g_kernel_stats.tasks[task];
+    u64_t cnt;
+
+    g_kernel_stats.cores[k->core].ready = k->queue.count;
+
+    if (!task) {
+        return;
+    }
+
+    s->core = k->core;
+
+//Only the first run after a wakeup has a latency.
+    if (k->tasks[task].ready) {
+        asm volatile ("mrs %0, cntpct_el0\n" : "=r"(cnt) :: );
+        s->latency = hrtimer_count_to_ns(&k->hrtimers, 
+                                         cnt - k->tasks[task].ready);
+        k->tasks[task].ready = 0;
+        kernel_lat_record(k, task, s->latency);
+    }
+}
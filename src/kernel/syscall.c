@@ -0,0 +1,204 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//syscall.c
+// Syscall fast path. Syscalls which never block or change which task
+// runs are handled directly in the exception handler and return to the
+// caller without a context switch.
+//
+
+#include "kernel.h"
+
+#include "uart.h"
+
+//
+//Serializes readers of the uart receive ring.
+//
+static kernel_lock kernel_syscall_read_lock;
+
+//
+//kernel_syscall_fast_fn()
+// Fast path handler. Result is returned to the caller in x0. 'ret' 
+// points at the start of the caller's kernel_frame.
+// Returns: 0 if handled, non-zero to take the slow kernel path.
+//
+typedef int (*kernel_syscall_fast_fn)(kernel *k, u64_t arg, u64_t *ret);
+
+//
+//kernel_syscall_fast_time()
+//
+static int kernel_syscall_fast_time(kernel *k, u64_t arg, u64_t *ret) {
+    *ret = kernel_now_ns(k);
+    return 0;
+}
+
+//
+//kernel_syscall_fast_task_id()
+//
+static int kernel_syscall_fast_task_id(kernel *k, u64_t arg, u64_t *ret) {
+    *ret = k->task;
+    return 0;
+}
+
+//
+//kernel_syscall_fast_priority()
+// Only queue flags or the same priority. Moving in the queue is slow.
+//
+static int kernel_syscall_fast_priority(kernel *k, u64_t arg, u64_t *ret) {
+    kernel_sysarg sysarg;
+    sysarg.value = arg;
+
+    if (sysarg.lo && k->tasks[k->task].priority != sysarg.lo) {
+        return -1;
+    }
+
+    if (sysarg.hi) {
+//Change task queue options.
+        k->tasks[k->task].flags &= KERNEL_TASK_FLAG_QUEUE_CLEAR_ALL;
+        k->tasks[k->task].flags |= sysarg.hi;
+    }
+
+    return 0;
+}
+
+//
+//kernel_syscall_fast_yield()
+// Nothing to do unless a task of the same priority is ready.
+//
+static int kernel_syscall_fast_yield(kernel *k, u64_t arg, u64_t *ret) {
+    return kernel_queue_has_peer(k, k->task) ? -1 : 0;
+}
+
+//
+//kernel_syscall_fast_cpu_time()
+//
+static int kernel_syscall_fast_cpu_time(kernel *k, u64_t arg, u64_t *ret) {
+    *ret = kernel_acct_cpu_time(k, arg);
+    return 0;
+}
+
+//
+//kernel_syscall_fast_pmu()
+//
+static int kernel_syscall_fast_pmu(kernel *k, u64_t arg, u64_t *ret) {
+    kernel_sysarg sysarg;
+    sysarg.value = arg;
+
+    *ret = kernel_pmu_count(k, sysarg.lo, sysarg.hi);
+    return 0;
+}
+
+//
+//kernel_syscall_fast_latency()
+//
+static int kernel_syscall_fast_latency(kernel *k, u64_t arg, u64_t *ret) {
+    kernel_sysarg sysarg;
+    sysarg.value = arg;
+
+    *ret = kernel_lat_value(k, sysarg.lo, sysarg.hi);
+    return 0;
+}
+
+//
+//kernel_syscall_fast_log()
+// Message goes in the caller's core log ring. Always ends a line.
+//
+static int kernel_syscall_fast_log(kernel *k, u64_t arg, u64_t *ret) {
+    const char *str = (const char *) arg;
+    const char *end = str;
+
+    while (*end) {
+        ++end;
+    }
+
+    kernel_log_append(&k->log, k->task, str);
+    if (end == str || '\n' != end[-1]) {
+        kernel_log_append(&k->log, k->task, "\n");
+    }
+
+    return 0;
+}
+
+//
+//kernel_syscall_fast_read()
+// Copies received bytes if there are any. Otherwise the svc is rewound
+// so the read is retried when the kernel wakes the caller.
+//
+static int kernel_syscall_fast_read(kernel *k, u64_t arg, u64_t *ret) {
+    kernel_frame *frame = (kernel_frame *) ret;
+    kernel_sysarg sysarg;
+    u64_t n;
+    sysarg.value = arg;
+
+//Tasks on any core may read.
+    kernel_lock_acquire(&kernel_syscall_read_lock);
+    n = uart_read((char *) (u64_t) sysarg.lo, sysarg.hi);
+    kernel_lock_release(&kernel_syscall_read_lock);
+
+    if (!n) {
+        frame->elr -= 4;
+        return -1;
+    }
+
+    *ret = n;
+    return 0;
+}
+
+//
+//kernel_syscall_fast_tbl[]
+// Indexed by syscall number. Zero means always take the slow path.
+// Entries hold link time addresses and are rebased when called.
+//
+static const kernel_syscall_fast_fn 
+    kernel_syscall_fast_tbl[KERNEL_SYSCALL_MAX] = {
+    [KERNEL_SYSCALL_PRIORITY] = kernel_syscall_fast_priority,
+    [KERNEL_SYSCALL_TIME]     = kernel_syscall_fast_time,
+    [KERNEL_SYSCALL_TASK_ID]  = kernel_syscall_fast_task_id,
+    [KERNEL_SYSCALL_YIELD]    = kernel_syscall_fast_yield,
+    [KERNEL_SYSCALL_CPU_TIME] = kernel_syscall_fast_cpu_time,
+    [KERNEL_SYSCALL_LOG]      = kernel_syscall_fast_log,
+    [KERNEL_SYSCALL_READ]     = kernel_syscall_fast_read,
+    [KERNEL_SYSCALL_PMU]      = kernel_syscall_fast_pmu,
+    [KERNEL_SYSCALL_LATENCY]  = kernel_syscall_fast_latency,
+};
+
+int kernel_syscall_fast(kernel *k, u64_t syscall, u64_t arg, 
+                        kernel_frame *frame) 
+{
+    kernel_syscall_fast_fn fn;
+
+    if (syscall >= KERNEL_SYSCALL_MAX || !kernel_syscall_fast_tbl[syscall]) {
+        return -1;
+    }
+
+#ifdef KERNEL_HOST
+//Host builds (tools/test) run where they were linked.
+    fn = kernel_syscall_fast_tbl[syscall];
+#else
+    fn = (kernel_syscall_fast_fn) ((u64_t) kernel_syscall_fast_tbl[syscall] + 
+                                   task_get_base_addr(0));
+#endif
+    return fn(k, arg, &frame->x[0]);
+}
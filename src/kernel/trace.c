@@ -0,0 +1,67 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//trace.c
+// Kernel trace rings. Recording is inline in trace.h.
+//
+
+#include "trace.h"
+#include "uart.h"
+
+//
+//Emitted where kernel_trace_psh() is not inlined.
+//
+extern void kernel_trace_psh(kernel_trace *t, u64_t event, 
+                             u64_t task, u64_t arg);
+
+void kernel_trace_init(kernel_trace *t, u64_t core, u64_t freq) {
+    t->magic = KERNEL_TRACE_MAGIC;
+    t->core  = core;
+    t->freq  = freq;
+    t->size  = KERNEL_TRACE_RECORDS;
+    t->head  = 0;
+}
+
+void kernel_trace_dump(kernel_trace *t) {
+    u64_t head = t->head;
+    u64_t i    = 0;
+    kernel_trace_record *r;
+
+//Oldest record still in the ring.
+    if (head > KERNEL_TRACE_RECORDS) {
+        i = head - KERNEL_TRACE_RECORDS;
+    }
+
+    uart_printf("rpi3rtos::trace: begin 0x%016llX 0x%016llX 0x%016llX\n",
+                t->core, t->freq, head - i);
+
+    for (; i < head; ++i) {
+        r = &t->recs[i & (KERNEL_TRACE_RECORDS - 1)];
+        uart_printf("rpi3rtos::trace: 0x%016llX 0x%04X%04X%08X\n",
+                    r->time, r->event, r->task, r->arg);
+    }
+
+    uart_puts("rpi3rtos::trace: end\n");
+}
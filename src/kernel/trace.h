@@ -0,0 +1,138 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+//
+//trace.h
+// Kernel trace. Each core records scheduling events into its own ring
+// buffer of fixed size binary records timestamped with the physical
+// counter (CNTPCT_EL0). A ring is only written by its own core with
+// interrupts masked so recording takes no locks. The oldest records
+// are overwritten. Rings are dumped over the uart (task_trace_dump())
+// or read from a memory dump and decoded on the host. See tools/trace.
+//
+
+#include "platform.h"
+
+//
+//KERNEL_TRACE_RECORDS
+// Number of records in each core's ring. Must be a power of two.
+//
+#ifndef KERNEL_TRACE_RECORDS
+#define KERNEL_TRACE_RECORDS 1024
+#endif
+
+//
+//KERNEL_TRACE_MAGIC
+// Marks the start of a ring in memory. ASCII "RTOSTRCE".
+//
+#define KERNEL_TRACE_MAGIC 0x45435254534F5452
+
+//*********************************************************************
+//
+//KERNEL_TRACE_*
+// Trace events. Meaning of the task and argument fields for each.
+//
+//*********************************************************************
+
+#define KERNEL_TRACE_SWITCH        0x1 //Task switched out. Arg is next task.
+#define KERNEL_TRACE_SYSCALL_ENTER 0x2 //Task made syscall. Arg is syscall.
+#define KERNEL_TRACE_SYSCALL_EXIT  0x3 //Syscall serviced. Arg is syscall.
+#define KERNEL_TRACE_IRQ_ENTER     0x4 //Interrupt. Task is interrupted task.
+#define KERNEL_TRACE_IRQ_EXIT      0x5 //Interrupt handled. Task is resumed task.
+#define KERNEL_TRACE_WAKEUP        0x6 //Task put back on the ready queue.
+#define KERNEL_TRACE_SLEEP         0x7 //Task sleeps. Arg is microseconds.
+#define KERNEL_TRACE_SUSPEND       0x8 //Task suspended. Arg is wakeup flags.
+#define KERNEL_TRACE_STEAL         0x9 //Task stolen. Arg is core taken from.
+
+//
+//kernel_trace_record{}
+// One event. 16 bytes.
+//
+typedef struct _kernel_trace_record {
+    u64_t time;   //Physical counter value.
+    u16_t event;  //KERNEL_TRACE_*
+    u16_t task;   //Task the event applies to.
+    u32_t arg;    //Event specific.
+} kernel_trace_record;
+
+//
+//kernel_trace{}
+// Ring of records for one core. The header is 64 bytes so a memory
+// dump can be decoded without the kernel image.
+//
+typedef struct _kernel_trace {
+    u64_t magic;  //KERNEL_TRACE_MAGIC
+    u64_t core;   //Core which writes this ring.
+    u64_t freq;   //Counter frequency in Hz.
+    u64_t size;   //Number of records. KERNEL_TRACE_RECORDS.
+    volatile u64_t head; //Number of records ever written.
+    u64_t pad[3];
+    kernel_trace_record recs[KERNEL_TRACE_RECORDS];
+} kernel_trace;
+
+//
+//kernel_trace_init()
+// Empty the ring.
+//
+void kernel_trace_init(kernel_trace *t, u64_t core, u64_t freq);
+
+//
+//kernel_trace_psh()
+// Record an event. Called with interrupts masked on the core which
+// owns the ring. A counter read and two stores.
+//
+inline void kernel_trace_psh(kernel_trace *t, u64_t event, 
+                             u64_t task, u64_t arg) 
+{
+    kernel_trace_record *r = &t->recs[t->head & (KERNEL_TRACE_RECORDS - 1)];
+    u64_t cnt;
+
+#ifdef KERNEL_HOST
+//Host builds (tools/bench) have no generic timer.
+    cnt = t->head;
+#else
+    asm volatile ("mrs %0, cntpct_el0\n" : "=r"(cnt) :: );
+#endif
+
+    r->time  = cnt;
+    r->event = (u16_t) event;
+    r->task  = (u16_t) task;
+    r->arg   = (u32_t) arg;
+
+//Record is complete before it is counted.
+    asm volatile ("" ::: "memory");
+    ++t->head;
+}
+
+//
+//kernel_trace_dump()
+// Print the ring oldest record first over the uart. One line per
+// record. Decoded by tools/trace/trace2json.py.
+//
+void kernel_trace_dump(kernel_trace *t);
+
+#endif
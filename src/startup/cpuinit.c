@@ -28,6 +28,7 @@
 
 extern void _start(void);
 void startup(void);
+void startup_secondary(void);
 
 #define EL_BITS 0x0000000C
 //
@@ -60,6 +61,14 @@ void _cpuinit(void) {
             :: "r"(reg0) :
         );
 
+//Give EL1 every PMU event counter without traps (HPMN = PMCR_EL0.N).
+        asm volatile (
+            "mrs    %0, pmcr_el0\n"        //Read Performance Monitors Control Register
+            "ubfx   %0, %0, #11, #5\n"     //Number of event counters.
+            "msr    mdcr_el2, %0\n"        //Write Monitor Debug Configuration Register
+            : "=r"(reg0) : "r"(reg0) :
+        );
+
 //EL1 will be running in AARCH64 mode.
         asm volatile (
             "mrs    %0, hcr_el2\n"         //Read Hypervisor Configuration Register
@@ -78,14 +87,25 @@ void _cpuinit(void) {
             : "r"(reg0), "r"(reg1) :
         );
 
-//On ERET, execution will jump to location in elr_el2.
-        asm volatile (
-            "msr    elr_el2, %0\n" :: "r"(startup) :
-        ); 
+//On ERET, execution will jump to location in elr_el2. Core 0 loads
+//tasks. Cores 1-3 wait to be released by the kernel.
+        asm volatile ("mrs %0, mpidr_el1" : "=r"(reg0)::);
+
+        if (reg0 & 0x3) {
+            asm volatile (
+                "msr    elr_el2, %0\n" :: "r"(startup_secondary) :
+            ); 
+        } else {
+            asm volatile (
+                "msr    elr_el2, %0\n" :: "r"(startup) :
+            ); 
+        }
 
-//On ERET stack pointer is set to sp_el1
+//On ERET stack pointer is set to sp_el1. Keep the stack set in start.S.
         asm volatile (
-            "msr    sp_el1, %0\n" :: "r"(_start) :
+            "mov    %0, sp\n"
+            "msr    sp_el1, %0\n" 
+            : "=r"(reg0) : "r"(reg0) :
         );
 
 //On ERET go to EL1, set stack pointer to sp_el1 and jump to startup()
@@ -26,6 +26,7 @@
 #include "peripherals.h"
 #include "task.h"
 
+extern void _start(void);
 extern int __bss_end;
 extern int __startup_list_header;
 
@@ -118,7 +119,7 @@ u64_t startup_load_task_list(task_list_item *curitem, u64_t task) {
         uart_puts("rpi3rtos::startup_load_task_list(): End of list. Begin loading.\n");
         return task;
     } else {
-        u64_t i, cnt;
+        u64_t cnt;
         char *src;
         char *dst;
 
@@ -173,11 +174,7 @@ u64_t startup_load_task_list(task_list_item *curitem, u64_t task) {
         uart_u64hex_s(curitem->ro_end);
         uart_puts(" Bytes)\n");
 
-        for(i = 0; i < curitem->ro_end; ++i) {
-            *dst = *src;
-            ++src;
-            ++dst;
-        }
+        task_image_copy(dst, src, curitem->ro_end);
 
         src = (char *) ((u64_t) curitem + curitem->rw_beg);
         dst = (char *) (task_get_base_addr(task) + curitem->rw_beg);
@@ -191,11 +188,7 @@ u64_t startup_load_task_list(task_list_item *curitem, u64_t task) {
         uart_u64hex_s(curitem->rw_end - curitem->rw_beg);
         uart_puts(" Bytes)\n");
 
-        for(i = 0; i < curitem->rw_end - curitem->rw_beg; ++i) {
-            *dst = *src;
-            ++src;
-            ++dst;
-        }
+        task_image_copy(dst, src, curitem->rw_end - curitem->rw_beg);
 
         task_header_rebase(task);
         task_bss_zero(task);
@@ -204,6 +197,47 @@ u64_t startup_load_task_list(task_list_item *curitem, u64_t task) {
     }
 }
 
+//
+//startup_release_secondaries()
+// Firmware parks cores 1-3 on the spin table. Send them to _start so
+// they drop to EL1 and wait in startup_secondary(). Harmless if the
+// cores already started at _start.
+//
+void startup_release_secondaries(void) {
+    u64_t core;
+
+    for (core = 1; core < PLATFORM_CORES; ++core) {
+        *PLATFORM_SPIN_TABLE(core) = (u64_t) _start;
+    }
+
+    asm volatile (
+        "dsb sy\n"
+        "sev\n"
+    );
+}
+
+//
+//startup_secondary()
+// Cores 1-3 wait here at EL1 until the kernel writes its entry point to
+// the core's spin table slot. Entry is called with the core number.
+//
+void startup_secondary(void) {
+    u64_t core = platform_core();
+    u64_t entry;
+
+    while (1) {
+        entry = *PLATFORM_SPIN_TABLE(core);
+        if (entry && entry != (u64_t) _start) {
+            break;
+        }
+        asm volatile ("wfe\n");
+    }
+
+    ((void (*)(u64_t)) entry)(core);
+
+    startup_panic();
+}
+
 //
 //startup()
 // Load tasks into memory and jump to Task0.
@@ -239,6 +273,9 @@ void startup(void) {
         (task_list_item *) ((u64_t) lsthdr + sizeof(startup_list_header)), 0
     );
 
+//Cores 1-3 wait for the kernel.
+    startup_release_secondaries();
+
 //Task0 is the kernel. Set stack pointer and branch.
     task0 = task_get_header(0);
     asm ("mov sp, %0" :: "r"(task_get_base_addr(0)) : );
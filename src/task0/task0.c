@@ -39,6 +39,15 @@ void task0_panic() {
 void task0_init(u64_t num_tasks) {
     kernel k;
     uart_puts("rpi3rtos::task0_main(): Initialize and branch to kernel_main().\n");
+#ifndef UART_TX_POLLED
+//Output is queued and sent by the UART transmit interrupt on core 0.
+    uart_tx_irq_init();
+//Large buffers from task_write_dma() are sent by DMA.
+    uart_dma_init();
+#endif
+//Received data is queued by the UART receive interrupt on core 0.
+    uart_rx_irq_init();
+    kernel_smp_start(num_tasks);
     kernel_init(&k, num_tasks);
     kernel_main(&k);
 }
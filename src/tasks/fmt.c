@@ -0,0 +1,316 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//fmt.c
+// Freestanding formatter. See fmt.h.
+//
+
+#include "fmt.h"
+
+//
+//Digit tables. Pairs for two decimal digits at a time.
+//
+static const c8_t fmt_hex_upper[16] = "0123456789ABCDEF";
+static const c8_t fmt_hex_lower[16] = "0123456789abcdef";
+static const c8_t fmt_dec_pairs[200] = 
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+//
+//fmt_digits()
+// Write digits of 'val' backwards from 'end'.
+// Returns: Pointer to the first digit.
+//
+static c8_t *fmt_digits(c8_t *end, u64_t val, u64_t base, 
+                        const c8_t *hex) 
+{
+    const c8_t *pair;
+
+    if (16 == base) {
+        do {
+            *--end = hex[val & 0xF];
+            val >>= 4;
+        } while (val);
+        return end;
+    }
+
+    while (val >= 100) {
+        pair   = &fmt_dec_pairs[(val % 100) * 2];
+        val   /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+
+    if (val >= 10) {
+        pair   = &fmt_dec_pairs[val * 2];
+        *--end = pair[1];
+        *--end = pair[0];
+    } else {
+        *--end = (c8_t) ('0' + val);
+    }
+
+    return end;
+}
+
+u64_t fmt_u64(c8_t *buf, u64_t val, u64_t base, u64_t width) {
+    c8_t tmp[20];
+    c8_t *p = fmt_digits(&tmp[20], val, base, fmt_hex_upper);
+    u64_t n = 0;
+
+    if (width > 20) {
+        width = 20;
+    }
+    for (; width > (u64_t) (&tmp[20] - p); --width) {
+        buf[n++] = '0';
+    }
+    while (p < &tmp[20]) {
+        buf[n++] = *p++;
+    }
+
+    return n;
+}
+
+//
+//fmt_field()
+// Write 'pre' (a sign or 0x) and 'len' characters of 'str' padded to 
+// 'width' at 'out'. Zero padding goes between the two. Characters at 
+// or past 'lim' are dropped. Locals rather than a struct keep the 
+// position in a register across the character stores.
+// Returns: The new output position.
+//
+static c8_t *fmt_field(c8_t *out, c8_t *lim, const c8_t *pre, 
+                       const c8_t *str, u64_t len, u64_t width, 
+                       u64_t left, c8_t pad) 
+{
+    u64_t total = len;
+    u64_t fill;
+    const c8_t *p;
+
+    for (p = pre; *p; ++p) {
+        ++total;
+    }
+    fill = width > total ? width - total : 0;
+
+    if (!left && ' ' == pad) {
+        for (; fill && out < lim; --fill) {
+            *out++ = ' ';
+        }
+    }
+    for (p = pre; *p && out < lim; ++p) {
+        *out++ = *p;
+    }
+    if (!left) {
+        for (; fill && out < lim; --fill) {
+            *out++ = '0';
+        }
+    }
+    for (; len && out < lim; --len) {
+        *out++ = *str++;
+    }
+    for (; fill && out < lim; --fill) {
+        *out++ = ' ';
+    }
+
+    return out;
+}
+
+//
+//fmt_prec()
+// Apply an integer precision to the digits from 'p' to 'end': at least
+// 'prec' digits with leading zeros, none for 0 with precision 0. 'prec'
+// is (u64_t) -1 if not given. The digits must have FMT_INT_PREC_MAX 
+// characters of room before them.
+// Returns: Pointer to the first digit.
+//
+static c8_t *fmt_prec(c8_t *p, c8_t *end, u64_t prec) {
+    if ((u64_t) -1 == prec) {
+        return p;
+    }
+
+    if (!prec && 1 == end - p && '0' == *p) {
+        return end;
+    }
+
+    if (prec > FMT_INT_PREC_MAX) {
+        prec = FMT_INT_PREC_MAX;
+    }
+    while ((u64_t) (end - p) < prec) {
+        *--p = '0';
+    }
+
+    return p;
+}
+
+u64_t fmt_vsnprintf(c8_t *buf, u64_t size, const c8_t *fmt, fmt_va_list ap) {
+    c8_t *out = buf;
+    c8_t *lim = size ? buf + size - 1 : buf;
+    c8_t tmp[FMT_INT_PREC_MAX];
+    c8_t *p, *end = &tmp[FMT_INT_PREC_MAX];
+    const c8_t *s;
+    u64_t width, prec, left, wide, val, n;
+    c8_t pad;
+    i64_t sval;
+
+    for (; *fmt; ++fmt) {
+        if ('%' != *fmt) {
+//Copy the run of literal text. Only check for room once full.
+            while (out < lim && *fmt && '%' != *fmt) {
+                *out++ = *fmt++;
+            }
+            while (*fmt && '%' != *fmt) {
+                ++fmt;
+            }
+            if (!*fmt) {
+                break;
+            }
+        }
+
+//Flags, width, precision and length.
+        left = 0;
+        pad  = ' ';
+        for (++fmt; '-' == *fmt || '0' == *fmt; ++fmt) {
+            if ('-' == *fmt) {
+                left = 1;
+            } else {
+                pad = '0';
+            }
+        }
+
+        for (width = 0; *fmt >= '0' && *fmt <= '9'; ++fmt) {
+            width = width * 10 + (u64_t) (*fmt - '0');
+        }
+
+        prec = (u64_t) -1;
+        if ('.' == *fmt) {
+            ++fmt;
+            if ('*' == *fmt) {
+//A negative precision is taken as if it were not given.
+                sval = fmt_va_arg(ap, int);
+                prec = sval < 0 ? (u64_t) -1 : (u64_t) sval;
+                ++fmt;
+            } else {
+                for (prec = 0; *fmt >= '0' && *fmt <= '9'; ++fmt) {
+                    prec = prec * 10 + (u64_t) (*fmt - '0');
+                }
+            }
+        }
+
+        for (wide = 0; 'l' == *fmt; ++fmt) {
+            wide = 1;
+        }
+
+//Zero padding is ignored when an integer has a precision.
+        if ((u64_t) -1 != prec && 's' != *fmt) {
+            pad = ' ';
+        }
+
+        switch (*fmt) {
+            case 'd':
+            case 'i':
+                sval = wide ? fmt_va_arg(ap, i64_t) : fmt_va_arg(ap, int);
+                val  = sval < 0 ? (u64_t) 0 - (u64_t) sval : (u64_t) sval;
+                p    = fmt_prec(fmt_digits(end, val, 10, fmt_hex_upper), 
+                                end, prec);
+                out  = fmt_field(out, lim, sval < 0 ? "-" : "", p, 
+                                 (u64_t) (end - p), width, left, pad);
+            break;
+
+            case 'u':
+            case 'x':
+            case 'X':
+                val = wide ? fmt_va_arg(ap, u64_t) : fmt_va_arg(ap, u32_t);
+                p   = fmt_digits(end, val, 'u' == *fmt ? 10 : 16, 
+                                 'x' == *fmt ? fmt_hex_lower : fmt_hex_upper);
+                p   = fmt_prec(p, end, prec);
+                out = fmt_field(out, lim, "", p, (u64_t) (end - p), 
+                                width, left, pad);
+            break;
+
+            case 'p':
+                val = (u64_t) fmt_va_arg(ap, void *);
+                p   = fmt_digits(end, val, 16, fmt_hex_upper);
+                while (end - p < 16) {
+                    *--p = '0';
+                }
+                out = fmt_field(out, lim, "0x", p, (u64_t) (end - p), 
+                                width, left, ' ');
+            break;
+
+            case 's':
+                s = fmt_va_arg(ap, const c8_t *);
+                if (!s) {
+                    s = "(null)";
+                }
+                for (n = 0; n < prec && s[n]; ++n) {}
+                out = fmt_field(out, lim, "", s, n, width, left, ' ');
+            break;
+
+            case 'c':
+                tmp[0] = (c8_t) fmt_va_arg(ap, int);
+                out = fmt_field(out, lim, "", tmp, 1, width, left, ' ');
+            break;
+
+            case '%':
+                out = fmt_field(out, lim, "", "%", 1, 0, 0, ' ');
+            break;
+
+            case 0:
+//Format ends in '%'.
+                --fmt;
+            break;
+
+            default:
+//Unknown conversion is printed as is.
+                out = fmt_field(out, lim, "%", fmt, 1, 0, 0, ' ');
+            break;
+        }
+    }
+
+    if (size) {
+        *out = 0;
+    }
+
+    return (u64_t) (out - buf);
+}
+
+FMT_VARARGS
+u64_t fmt_snprintf(c8_t *buf, u64_t size, const c8_t *fmt, ...) {
+    fmt_va_list ap;
+    u64_t n;
+
+    fmt_va_start(ap, fmt);
+    n = fmt_vsnprintf(buf, size, fmt, ap);
+    fmt_va_end(ap);
+
+    return n;
+}
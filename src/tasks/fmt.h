@@ -0,0 +1,94 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FMT_H
+#define FMT_H
+
+//
+//fmt.h
+// Freestanding snprintf style formatter. Formats into a caller buffer
+// so a message goes to the uart in one write. Supports:
+//
+//  %[-][0][width][.prec][l|ll]{d,i,u,x,X,p,s,c,%}
+//
+// 'l' and 'll' both mean 64 bits. '.prec' may be '*', where a negative
+// argument means no precision. The precision is the most characters
+// taken from a %s string and the fewest digits of an integer, at most
+// FMT_INT_PREC_MAX. %p prints 0x and 16 hex digits
+// and ignores '.prec'. Digits come from lookup tables, two at a time 
+// for decimal.
+//
+
+#include "platform.h"
+
+//
+//FMT_INT_PREC_MAX
+// Largest precision of an integer conversion. Larger ones are cut to
+// this many digits.
+//
+#define FMT_INT_PREC_MAX 32
+
+//
+//FMT_VARARGS
+// Variadic functions would otherwise spill the FP/SIMD argument 
+// registers which trap in the kernel.
+//
+#define FMT_VARARGS __attribute__((target("general-regs-only")))
+
+//
+//FMT_PRINTF()
+// Compiler checks arguments against the format string.
+//
+#define FMT_PRINTF(fmt, args) __attribute__((format(printf, fmt, args)))
+
+typedef __builtin_va_list fmt_va_list;
+
+#define fmt_va_start(ap, last) __builtin_va_start(ap, last)
+#define fmt_va_arg(ap, type)   __builtin_va_arg(ap, type)
+#define fmt_va_end(ap)         __builtin_va_end(ap)
+
+//
+//fmt_u64()
+// Digits of 'val' in base 10 or 16 (upper case). At least 'width' 
+// digits with leading zeros. 'buf' holds at least 20 characters. Not
+// null terminated.
+// Returns: Number of characters written.
+//
+u64_t fmt_u64(c8_t *buf, u64_t val, u64_t base, u64_t width);
+
+//
+//fmt_vsnprintf()
+// Format into 'buf' which holds 'size' characters. Output is truncated
+// to fit and always null terminated if 'size' is not 0.
+// Returns: Number of characters written not counting the null.
+//
+u64_t fmt_vsnprintf(c8_t *buf, u64_t size, const c8_t *fmt, fmt_va_list ap);
+
+//
+//fmt_snprintf()
+// fmt_vsnprintf() with the arguments in place.
+//
+u64_t fmt_snprintf(c8_t *buf, u64_t size, const c8_t *fmt, ...) FMT_PRINTF(3, 4);
+
+#endif
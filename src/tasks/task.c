@@ -99,6 +99,16 @@ void task_bss_zero(u64_t task) {
     }
 }
 
+void task_image_copy(void *dst, const void *src, u64_t len) {
+    const char *s = (const char *) src;
+    char *d = (char *) dst;
+    u64_t i;
+
+    for (i = 0; i < len; ++i) {
+        d[i] = s[i];
+    }
+}
+
 //
 //task_suspend()
 //
@@ -121,6 +131,17 @@ void task_sleep(u64_t msecs) {
     );
 }
 
+//
+//task_usleep()
+//
+void task_usleep(u64_t usecs) {
+    asm volatile (
+        "mov    x0, %0\n"
+        "svc    4\n"        //Kernel service call 4 is usleep.
+        :: "r"(usecs): 
+    );
+}
+
 
 //
 //task_priority_set()
@@ -133,3 +154,150 @@ void task_priority_set(u64_t priority, u64_t flags) {
         :: "r"(sysarg): 
     );
 }
+
+//
+//task_time()
+//
+u64_t task_time(void) {
+    u64_t ns;
+    asm volatile (
+        "svc    5\n"        //Kernel service call 5 is time.
+        "mov    %0, x0\n"
+        : "=r"(ns) :: "x0"
+    );
+    return ns;
+}
+
+//
+//task_id()
+//
+u64_t task_id(void) {
+    u64_t id;
+    asm volatile (
+        "svc    6\n"        //Kernel service call 6 is task id.
+        "mov    %0, x0\n"
+        : "=r"(id) :: "x0"
+    );
+    return id;
+}
+
+//
+//task_yield()
+//
+void task_yield(void) {
+    asm volatile (
+        "svc    7\n"        //Kernel service call 7 is yield.
+    );
+}
+
+//
+//task_trace_dump()
+//
+void task_trace_dump(void) {
+    asm volatile (
+        "svc    8\n"        //Kernel service call 8 is trace dump.
+    );
+}
+
+//
+//task_prof_dump()
+//
+void task_prof_dump(void) {
+    asm volatile (
+        "svc    14\n"       //Kernel service call 14 is profile dump.
+    );
+}
+
+//
+//task_latency()
+//
+u64_t task_latency(u64_t task, u64_t permille) {
+    u64_t sysarg = task + (permille << 32);
+    u64_t ns;
+    asm volatile (
+        "mov    x0, %1\n"
+        "svc    15\n"       //Kernel service call 15 is wakeup latency.
+        "mov    %0, x0\n"
+        : "=r"(ns) : "r"(sysarg) : "x0"
+    );
+    return ns;
+}
+
+//
+//task_latency_dump()
+//
+void task_latency_dump(void) {
+    asm volatile (
+        "svc    16\n"       //Kernel service call 16 is latency dump.
+    );
+}
+
+//
+//task_cpu_time()
+//
+u64_t task_cpu_time(u64_t which) {
+    u64_t ns;
+    asm volatile (
+        "mov    x0, %1\n"
+        "svc    9\n"        //Kernel service call 9 is CPU time.
+        "mov    %0, x0\n"
+        : "=r"(ns) : "r"(which) : "x0"
+    );
+    return ns;
+}
+
+//
+//task_pmu()
+//
+u64_t task_pmu(u64_t task, u64_t counter) {
+    u64_t sysarg = task + (counter << 32);
+    u64_t n;
+    asm volatile (
+        "mov    x0, %1\n"
+        "svc    13\n"       //Kernel service call 13 is PMU count.
+        "mov    %0, x0\n"
+        : "=r"(n) : "r"(sysarg) : "x0"
+    );
+    return n;
+}
+
+//
+//task_log()
+//
+void task_log(const char *str) {
+    asm volatile (
+        "mov    x0, %0\n"
+        "svc    10\n"       //Kernel service call 10 is log.
+        :: "r"(str) : "x0", "memory"
+    );
+}
+
+//
+//task_write_dma()
+//
+u64_t task_write_dma(const char *buf, u64_t len) {
+    u64_t sysarg = (u64_t) buf + (len << 32);
+    u64_t n;
+    asm volatile (
+        "mov    x0, %1\n"
+        "svc    12\n"       //Kernel service call 12 is DMA write.
+        "mov    %0, x0\n"
+        : "=r"(n) : "r"(sysarg) : "x0", "memory"
+    );
+    return n;
+}
+
+//
+//task_read()
+//
+u64_t task_read(char *buf, u64_t len) {
+    u64_t sysarg = (u64_t) buf + (len << 32);
+    u64_t n;
+    asm volatile (
+        "mov    x0, %1\n"
+        "svc    11\n"       //Kernel service call 11 is read.
+        "mov    %0, x0\n"
+        : "=r"(n) : "r"(sysarg) : "x0", "memory"
+    );
+    return n;
+}
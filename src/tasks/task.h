@@ -71,6 +71,13 @@ typedef struct _task_list_item {
 //
 #define TASK_HEADER_FLAG_OVERSLEPT 0x1
 
+//
+//TASK_HEADER_FLAG_FP_USED
+// Kernel sets this flag the first time the task uses floating point or
+// SIMD registers.
+//
+#define TASK_HEADER_FLAG_FP_USED   0x2
+
 //
 //task_header{}
 // Header shared by kernel and task. This gets loaded into first block
@@ -83,6 +90,8 @@ typedef struct _task_header {
     i64_t priority_flgs; //Priority flags. Use task_priority_set() to change.
     taskfn init;         //Initialize task then suspend.
     taskfn reset;        //Reset the task then suspend.
+    u64_t affinity;      //Bit N set if task may run on core N. 0 is any core.
+    u64_t stats;         //Address of the kernel statistics page. Set by kernel.
 } task_header;
 
 //FIXME: Need macros to build & init task_list_item & task_header correctly.
@@ -124,6 +133,13 @@ void task_header_rebase(u64_t task);
 //
 void task_bss_zero(u64_t task);
 
+//
+//task_image_copy()
+// Copy part of a task image to its memory location. Used by the 
+// startup loader.
+//
+void task_image_copy(void *dst, const void *src, u64_t len);
+
 //
 //task_suspend()
 // Suspend current task and return control to kernel.
@@ -139,6 +155,13 @@ void task_suspend(u64_t wakeup);
 //
 void task_sleep(u64_t msecs);
 
+//
+//task_usleep()
+// Suspend task for a period of time in microseconds. Not rounded to
+// kernel ticks.
+//
+void task_usleep(u64_t usecs);
+
 //
 //task_priority_set()
 // Set the task's priority. Task may be suspended if priority change
@@ -147,4 +170,94 @@ void task_sleep(u64_t msecs);
 //
 void task_priority_set(u64_t priority, u64_t flags);
 
+//
+//task_time()
+// Nanoseconds since the counter started. Returns without a context
+// switch.
+//
+u64_t task_time(void);
+
+//
+//task_id()
+// Id of the calling task. Returns without a context switch.
+//
+u64_t task_id(void);
+
+//
+//task_yield()
+// Let tasks of the same priority run. Returns without a context 
+// switch if there are none.
+//
+void task_yield(void);
+
+//
+//task_cpu_time()
+// CPU time consumed in nanoseconds by task 'which' or one of the 
+// KERNEL_CPU_TIME_* values. Task 0 is time the kernel spent servicing
+// tasks. Returns without a context switch.
+//
+u64_t task_cpu_time(u64_t which);
+
+//
+//task_pmu()
+// PMU count of task 'task'. 'counter' is one of the KERNEL_PMU_* 
+// values. Always 0 unless the kernel was built with KERNEL_PMU. 
+// Returns without a context switch.
+//
+u64_t task_pmu(u64_t task, u64_t counter);
+
+//
+//task_log()
+// Log a line. The message is printed by the kernel when the core is 
+// idle and dropped if the log is full. Returns without a context 
+// switch.
+//
+void task_log(const char *str);
+
+//
+//task_write_dma()
+// Send up to UART_DMA_MAX (4096) bytes by DMA without newline 
+// conversion. Suspends until they have been sent while other tasks 
+// run. 'len' is truncated to 32 bits.
+// Returns: Number of bytes sent. 0 if DMA was busy or 'len' too large.
+//
+u64_t task_write_dma(const char *buf, u64_t len);
+
+//
+//task_read()
+// Read up to 'len' bytes received by UART0. Suspends until at least 
+// one byte has been received. 'len' is truncated to 32 bits.
+// Returns: Number of bytes read.
+//
+u64_t task_read(char *buf, u64_t len);
+
+//
+//task_trace_dump()
+// Print the kernel trace of the core the task runs on over the uart.
+// See tools/trace.
+//
+void task_trace_dump(void);
+
+//
+//task_prof_dump()
+// Print the profile histograms of the core the task runs on over the 
+// uart. Needs a kernel built with KERNEL_PROF. See tools/prof.
+//
+void task_prof_dump(void);
+
+//
+//task_latency()
+// Wakeup latency of task 'task' in nanoseconds at 'permille' tenths of
+// a percent. 990 is p99 and 999 is p99.9. 1000 is the longest and 0 
+// the number of wakeups measured. Returns without a context switch.
+//
+u64_t task_latency(u64_t task, u64_t permille);
+
+//
+//task_latency_dump()
+// Print the wakeup latency histograms of the core the task runs on 
+// over the uart.
+//
+void task_latency_dump(void);
+
 #endif
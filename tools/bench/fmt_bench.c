@@ -0,0 +1,170 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//fmt_bench.c
+// Host microbenchmark for the formatter (src/tasks/fmt.c). A typical 
+// kernel message is built the old way, one uart call per piece with a
+// switch per hex digit, and with fmt_snprintf() followed by one write.
+// The uart is replaced by a sink which copies to memory so the cost of
+// each call is what remains.
+//
+
+#include <stdio.h>
+#include <time.h>
+
+#include "fmt.h"
+
+#define BENCH_MESSAGES 2000000
+
+static c8_t sink_buf[256];
+static u64_t sink_len;
+static u64_t sink_calls;
+
+//
+//bench_now_ns()
+// Monotonic time in nanoseconds.
+//
+static u64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//
+//sink_write()
+// Stands in for the uart. Not inlined like a call into uart.c.
+//
+__attribute__((noinline)) static void sink_write(const c8_t *buf, u64_t len) {
+    ++sink_calls;
+    for (; len; --len) {
+        sink_buf[sink_len++ & 0xFF] = *buf++;
+    }
+}
+
+__attribute__((noinline)) static void sink_puts(const c8_t *str) {
+    u64_t len = 0;
+    while (str[len]) {
+        ++len;
+    }
+    sink_write(str, len);
+}
+
+//
+//old_tohex()
+// The per nibble switch uart_tohex() used.
+//
+__attribute__((noinline)) static c8_t old_tohex(u8_t val) {
+    switch (val & 0x0F) {
+        case 0x0: return '0';
+        case 0x1: return '1';
+        case 0x2: return '2';
+        case 0x3: return '3';
+        case 0x4: return '4';
+        case 0x5: return '5';
+        case 0x6: return '6';
+        case 0x7: return '7';
+        case 0x8: return '8';
+        case 0x9: return '9';
+        case 0xA: return 'A';
+        case 0xB: return 'B';
+        case 0xC: return 'C';
+        case 0xD: return 'D';
+        case 0xE: return 'E';
+        case 0xF: return 'F';
+        default:  return '?';
+    }
+}
+
+//
+//old_u64hex_s()
+// uart_u64hex_s() before the formatter. One uart call per digit.
+//
+static void old_u64hex_s(u64_t val) {
+    c8_t c;
+    int i;
+
+    sink_puts("0x");
+    for(i = 15; i > 0 && 0 == ((val >> i * 4) & 0xF); --i) {}
+    for(; i > -1; --i) {
+        c = old_tohex((u8_t) (val >> i * 4));
+        sink_write(&c, 1);
+    }
+}
+
+static void bench_old(u64_t i) {
+    sink_puts("rpi3rtos::kernel_schedule(): Switch from task ");
+    old_u64hex_s(i & 0xFF);
+    sink_puts(" to task ");
+    old_u64hex_s((i >> 8) & 0xFF);
+    sink_puts(" at ");
+    old_u64hex_s(i * 2654435761ULL);
+    sink_puts(".\n");
+}
+
+static void bench_fmt(u64_t i) {
+    c8_t buf[160];
+    u64_t n = fmt_snprintf(buf, sizeof(buf), 
+                           "rpi3rtos::kernel_schedule(): Switch from task "
+                           "0x%llX to task 0x%llX at 0x%llX.\n", 
+                           i & 0xFF, (i >> 8) & 0xFF, i * 2654435761ULL);
+    sink_write(buf, n);
+}
+
+static void bench_fmt_dec(u64_t i) {
+    c8_t buf[160];
+    u64_t n = fmt_snprintf(buf, sizeof(buf), 
+                           "rpi3rtos::kernel_schedule(): Switch from task "
+                           "%llu to task %llu at %llu.\n", 
+                           i & 0xFF, (i >> 8) & 0xFF, i * 2654435761ULL);
+    sink_write(buf, n);
+}
+
+//
+//bench_run()
+// Time BENCH_MESSAGES messages. Prints ns and uart calls per message.
+//
+static void bench_run(const char *name, void (*fn)(u64_t)) {
+    u64_t i, beg, end;
+
+    sink_calls = 0;
+    beg = bench_now_ns();
+    for (i = 0; i < BENCH_MESSAGES; ++i) {
+        fn(i);
+    }
+    end = bench_now_ns();
+
+    printf("%-22s %8.1f %10.1f\n", name, 
+           (double) (end - beg) / BENCH_MESSAGES, 
+           (double) sink_calls / BENCH_MESSAGES);
+}
+
+int main(void) {
+    printf("fmt_bench: one message with three values\n");
+    printf("%-22s %8s %10s\n", "method", "ns/msg", "calls/msg");
+    bench_run("puts + per digit hex", bench_old);
+    bench_run("fmt_snprintf hex", bench_fmt);
+    bench_run("fmt_snprintf decimal", bench_fmt_dec);
+    return 0;
+}
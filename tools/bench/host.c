@@ -0,0 +1,74 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//host.c
+// Stand-ins for the hardware and kernel routines the scheduler core 
+// (src/kernel/sched.c) calls so it can be built on the host. Output 
+// is discarded and a panic exits.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "kernel.h"
+
+#define LOG_MODULE LOG_MOD_ALL
+#include "log.h"
+
+//
+//Emitted where kernel_trace_psh() is not inlined.
+//
+extern void kernel_trace_psh(kernel_trace *t, u64_t event, u64_t task, u64_t arg);
+
+//
+//Emitted where kernel_stats_wakeup() is not inlined.
+//
+extern void kernel_stats_wakeup(kernel *k, u64_t task);
+
+void uart_puts(const char *str) {
+}
+
+void uart_u64hex_s(u64_t val) {
+}
+
+void uart_printf(const char *fmt, ...) {
+}
+
+void kernel_log_puts(const char *str) {
+}
+
+void kernel_log_hex(u64_t val) {
+}
+
+void kernel_log_printf(const char *fmt, ...) {
+}
+
+void kernel_log_bin(const char *fmt, u64_t nargs, const u64_t *args) {
+}
+
+void kernel_panic(void) {
+    fprintf(stderr, "kernel_panic() on the host.\n");
+    abort();
+}
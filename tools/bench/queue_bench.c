@@ -0,0 +1,191 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//queue_bench.c
+// Host microbenchmark for the kernel ready queue (src/kernel/queue.c).
+// Runs the same mix of scheduling operations against the bitmap ready
+// queue and against a sorted linked list like the one the kernel used
+// before, for increasing numbers of tasks. The cost per operation of
+// the ready queue should stay flat.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "kernel.h"
+
+#define BENCH_OPS        2000000
+#define BENCH_PRIORITIES 32
+
+static kernel k;
+
+//
+//bench_now_ns()
+// Monotonic time in nanoseconds.
+//
+static u64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//*********************************************************************
+// Reference Sorted List
+//  Tasks sorted by priority, highest first, new tasks inserted behind
+//  tasks with equal priority. Same behaviour as the original
+//  kernel_queue_task_node_pos_update().
+//*********************************************************************
+
+static kernel_nd_item *ref_head;
+
+static void ref_rmv(u64_t task) {
+    kernel_nd_item *nd = &k.tasks[task].node;
+    if (nd->prev) {
+        nd->prev->next = nd->next;
+    } else {
+        ref_head = nd->next;
+    }
+    if (nd->next) {
+        nd->next->prev = nd->prev;
+    }
+    nd->next = 0;
+    nd->prev = 0;
+}
+
+static void ref_psh(u64_t task) {
+    kernel_nd_item *nd  = &k.tasks[task].node;
+    kernel_nd_item *cur = ref_head;
+    kernel_nd_item *prv = 0;
+
+    while (cur && k.tasks[cur->task].priority >= k.tasks[task].priority) {
+        prv = cur;
+        cur = cur->next;
+    }
+
+    nd->prev = prv;
+    nd->next = cur;
+    if (cur) {
+        cur->prev = nd;
+    }
+    if (prv) {
+        prv->next = nd;
+    } else {
+        ref_head = nd;
+    }
+}
+
+static u64_t ref_first(void) {
+    return ref_head ? ref_head->task : 0;
+}
+
+//*********************************************************************
+// Benchmark
+//*********************************************************************
+
+typedef struct _bench_ops {
+    void  (*psh)(u64_t);
+    void  (*rmv)(u64_t);
+    u64_t (*first)(void);
+} bench_ops;
+
+static void queue_psh(u64_t task)  { kernel_queue_psh(&k, task); }
+static void queue_rmv(u64_t task)  { kernel_queue_rmv(&k, task); }
+static u64_t queue_first(void)     { return kernel_queue_first(&k); }
+
+static const bench_ops bench_queue = { queue_psh, queue_rmv, queue_first };
+static const bench_ops bench_ref   = { ref_psh,   ref_rmv,   ref_first   };
+
+//
+//bench_run()
+// Queue 'ntasks' tasks then run a mix of round-robin rotations of the
+// first task, wakeups (remove + add) and priority changes. Returns
+// nanoseconds per operation. The sum of the first task after every
+// operation is returned in 'sum' so implementations can be compared.
+//
+static double bench_run(const bench_ops *ops, u64_t ntasks, u64_t *check) {
+    u64_t i, beg, end, sum = 0;
+
+    srand(1);
+    kernel_queue_init(&k.queue);
+    ref_head = 0;
+
+    for (i = 1; i <= ntasks; ++i) {
+        k.tasks[i].priority  = 1 + rand() % BENCH_PRIORITIES;
+        k.tasks[i].node.task = i;
+        k.tasks[i].node.next = 0;
+        k.tasks[i].node.prev = 0;
+        ops->psh(i);
+    }
+
+    beg = bench_now_ns();
+
+    for (i = 0; i < BENCH_OPS; ++i) {
+        u64_t task;
+        switch (i & 3) {
+            case 0: //Round robin tick.
+            case 1:
+                task = ops->first();
+                ops->rmv(task);
+                ops->psh(task);
+            break;
+            case 2: //Sleep and wake up.
+                task = 1 + (i * 2654435761ULL) % ntasks;
+                ops->rmv(task);
+                ops->psh(task);
+            break;
+            case 3: //Priority change.
+                task = 1 + (i * 40503ULL) % ntasks;
+                ops->rmv(task);
+                k.tasks[task].priority = 1 + (i >> 2) % BENCH_PRIORITIES;
+                ops->psh(task);
+            break;
+        }
+        sum += ops->first();
+    }
+
+    end = bench_now_ns();
+
+    *check = sum;
+    return (double) (end - beg) / BENCH_OPS;
+}
+
+int main(void) {
+    u64_t n, qsum, rsum;
+
+    printf("%8s %16s %16s\n", "tasks", "queue ns/op", "sorted ns/op");
+
+    for (n = 8; n <= KERNEL_TASKS_MAX - 1; n *= 2) {
+        double q = bench_run(&bench_queue, n, &qsum);
+        double r = bench_run(&bench_ref, n, &rsum);
+        printf("%8llu %16.1f %16.1f\n", n, q, r);
+        if (qsum != rsum) {
+            printf("Scheduling order differs from sorted list. Fail.\n");
+            return 1;
+        }
+    }
+
+    return 0;
+}
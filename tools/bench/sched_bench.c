@@ -0,0 +1,196 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//sched_bench.c
+// Host microbenchmark for the scheduler core (src/kernel/sched.c). 
+// Drives the routines the kernel calls for yield, priority, sleep and
+// suspend syscalls and for ticks, for 8 to 4096 tasks. Half the tasks
+// are suspended waiting for uart data throughout, like tasks blocked
+// on I/O, so the suspend list is never empty. Hardware and logging are
+// stubbed out in host.c.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "kernel.h"
+
+#define BENCH_OPS        200000
+#define BENCH_PRIORITIES 32
+#define BENCH_SLEEP_MAX  64 //Ticks.
+#define BENCH_TICK_OPS   16 //Syscalls per tick in the mixed run.
+
+static kernel k;
+static task_header headers[KERNEL_TASKS_MAX];
+
+//
+//bench_now_ns()
+// Monotonic time in nanoseconds.
+//
+static u64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//
+//bench_hash()
+// Deterministic pseudo random numbers so every run does the same work.
+//
+static u64_t bench_hash(u64_t i) {
+    i *= 0x9E3779B97F4A7C15ULL;
+    return i ^ (i >> 29);
+}
+
+//
+//bench_reset()
+// Kernel with 'ntasks' queued tasks at pseudo random priorities. Every
+// other task is then suspended waiting for uart data which the 
+// benchmark never delivers.
+//
+static void bench_reset(u64_t ntasks) {
+    u64_t i;
+
+    memset(&k, 0, sizeof(k));
+    kernel_queue_init(&k.queue);
+    kernel_sleep_init(&k.sleep, 0);
+    k.num_tasks = ntasks + 1;
+
+    for (i = 1; i <= ntasks; ++i) {
+        k.tasks[i].header    = &headers[i];
+        k.tasks[i].priority  = 1 + bench_hash(i) % BENCH_PRIORITIES;
+        k.tasks[i].flags     = (i & 2) ? KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN :
+                                         KERNEL_TASK_FLAG_QUEUE_FIFO;
+        k.tasks[i].node.task = i;
+        kernel_queue_task_node_add(&k, i);
+    }
+
+    for (i = 2; i <= ntasks; i += 2) {
+        k.sysarg.value = KERNEL_TASK_FLAG_WAKEUP_UART0_RX;
+        kernel_queue_task_suspend_and_update(&k, i);
+    }
+
+    k.task = kernel_queue_first(&k);
+}
+
+//
+//bench_tick()
+// What the kernel does when a tick has elapsed.
+//
+static void bench_tick(void) {
+    ++k.time;
+    kernel_service_sleeping(&k);
+    kernel_service_tick(&k);
+}
+
+//
+//bench_syscall()
+// One kernel entry for syscall 'op' from the running task. Ticks until
+// a task is ready if every task is asleep.
+//
+static void bench_syscall(u64_t op, u64_t i) {
+    while (!k.task) {
+        bench_tick();
+    }
+
+    kernel_service_suspended(&k);
+
+    switch (op) {
+        case KERNEL_SYSCALL_YIELD:
+            kernel_queue_task_yield_and_update(&k, k.task);
+        break;
+
+        case KERNEL_SYSCALL_PRIORITY:
+            k.sysarg.lo = 1 + bench_hash(i) % BENCH_PRIORITIES;
+            k.sysarg.hi = 0;
+            kernel_queue_task_priority_and_update(&k, k.task);
+        break;
+
+        case KERNEL_SYSCALL_SLEEP:
+            k.sysarg.value = (1 + bench_hash(i) % BENCH_SLEEP_MAX) * 
+                             KERNEL_TICK_DURATION_MS;
+            kernel_queue_task_sleep_and_update(&k, k.task);
+        break;
+
+        case KERNEL_SYSCALL_SUSPEND:
+//Woken by kernel_service_suspended() on the next entry.
+            k.sysarg.value = KERNEL_TASK_FLAG_WAKEUP_POST_INIT;
+            kernel_queue_task_suspend_and_update(&k, k.task);
+        break;
+    }
+
+    k.sysarg.value = 0;
+    k.task = kernel_queue_first(&k);
+}
+
+//
+//bench_run()
+// Nanoseconds per syscall. 'op' 0 is a pseudo random mix with a tick
+// every BENCH_TICK_OPS syscalls.
+//
+static double bench_run(u64_t ntasks, u64_t op) {
+    static const u64_t mix[] = {
+        KERNEL_SYSCALL_YIELD, KERNEL_SYSCALL_PRIORITY,
+        KERNEL_SYSCALL_SLEEP, KERNEL_SYSCALL_SUSPEND
+    };
+    u64_t i, beg, end;
+
+    bench_reset(ntasks);
+    beg = bench_now_ns();
+
+    for (i = 0; i < BENCH_OPS; ++i) {
+        if (op) {
+            bench_syscall(op, i);
+        } else {
+            bench_syscall(mix[bench_hash(i) & 3], i);
+            if (BENCH_TICK_OPS - 1 == i % BENCH_TICK_OPS) {
+                bench_tick();
+            }
+        }
+    }
+
+    end = bench_now_ns();
+    return (double) (end - beg) / BENCH_OPS;
+}
+
+int main(void) {
+    u64_t n;
+
+    printf("sched_bench: ns per kernel entry, half the tasks blocked on I/O\n");
+    printf("%8s %10s %10s %10s %10s %10s\n", 
+           "tasks", "yield", "priority", "sleep", "suspend", "mix");
+
+    for (n = 8; n <= KERNEL_TASKS_MAX - 1; n *= 2) {
+        printf("%8llu", n);
+        printf(" %10.1f", bench_run(n, KERNEL_SYSCALL_YIELD));
+        printf(" %10.1f", bench_run(n, KERNEL_SYSCALL_PRIORITY));
+        printf(" %10.1f", bench_run(n, KERNEL_SYSCALL_SLEEP));
+        printf(" %10.1f", bench_run(n, KERNEL_SYSCALL_SUSPEND));
+        printf(" %10.1f\n", bench_run(n, 0));
+    }
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//sleep_bench.c
+// Host microbenchmark for the sleep timer wheel (src/kernel/sleep.c).
+// Every sleeping task wakes up and immediately goes back to sleep for
+// a pseudo random number of ticks. The timer wheel is compared with a
+// scan of every sleeper per tick like the kernel used before. Cost per
+// tick of the wheel depends on how many tasks expire, not on how many
+// are asleep.
+//
+
+#include <stdio.h>
+#include <time.h>
+
+#include "kernel.h"
+
+#define BENCH_TICKS     20000
+#define BENCH_SLEEP_MAX 1000
+
+static kernel k;
+static i64_t  ref_wakeup[KERNEL_TASKS_MAX];
+
+//
+//bench_now_ns()
+// Monotonic time in nanoseconds.
+//
+static u64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//
+//bench_sleep_ticks()
+// Deterministic sleep duration so both runs wake the same tasks.
+//
+static u64_t bench_sleep_ticks(u64_t task, u64_t time) {
+    return 1 + ((task * 2654435761ULL) ^ (time * 40503ULL)) % BENCH_SLEEP_MAX;
+}
+
+//
+//bench_wheel()
+// Sleep 'ntasks' tasks on the timer wheel and run for BENCH_TICKS.
+//
+static double bench_wheel(u64_t ntasks, u64_t *wakes) {
+    u64_t i, task, beg, end, time;
+
+    kernel_sleep_init(&k.sleep, 1);
+    *wakes = 0;
+
+    for (i = 1; i <= ntasks; ++i) {
+        k.tasks[i].node.task = i;
+        k.tasks[i].wakeup = bench_sleep_ticks(i, 0);
+        kernel_sleep_psh(&k, i);
+    }
+
+    beg = bench_now_ns();
+
+    for (time = 1; time <= BENCH_TICKS; ++time) {
+        while ((task = kernel_sleep_expired(&k, time))) {
+            ++*wakes;
+            k.tasks[task].wakeup = time + bench_sleep_ticks(task, time);
+            kernel_sleep_psh(&k, task);
+        }
+    }
+
+    end = bench_now_ns();
+    return (double) (end - beg) / BENCH_TICKS;
+}
+
+//
+//bench_scan()
+// Decrement every sleeper's remaining ticks on every tick.
+//
+static double bench_scan(u64_t ntasks, u64_t *wakes) {
+    u64_t i, beg, end, time;
+
+    *wakes = 0;
+
+    for (i = 1; i <= ntasks; ++i) {
+        ref_wakeup[i] = bench_sleep_ticks(i, 0);
+    }
+
+    beg = bench_now_ns();
+
+    for (time = 1; time <= BENCH_TICKS; ++time) {
+        for (i = 1; i <= ntasks; ++i) {
+            if (0 == --ref_wakeup[i]) {
+                ++*wakes;
+                ref_wakeup[i] = bench_sleep_ticks(i, time);
+            }
+        }
+    }
+
+    end = bench_now_ns();
+    return (double) (end - beg) / BENCH_TICKS;
+}
+
+int main(void) {
+    u64_t n, wwakes, swakes;
+
+    printf("%8s %16s %16s %12s\n", "sleepers", "wheel ns/tick", "scan ns/tick", "wakes/tick");
+
+    for (n = 8; n <= KERNEL_TASKS_MAX - 1; n *= 2) {
+        double w = bench_wheel(n, &wwakes);
+        double s = bench_scan(n, &swakes);
+        printf("%8llu %16.1f %16.1f %12.2f\n", n, w, s, (double) wwakes / BENCH_TICKS);
+        if (wwakes != swakes) {
+            printf("Timer wheel woke %llu tasks, scan woke %llu. Fail.\n", wwakes, swakes);
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,271 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2020 Richard Healy
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+
+#
+# logdecode.py
+# Print the text of a uart capture from a LOG_BINARY build of the 
+# kernel (src/kernel/log.h). Binary frames are decoded with the format
+# strings in the .logstr section of the ELF files. Text which is not in
+# a frame is passed through.
+#
+# Usage: logdecode.py <capture> <task0.elf> [image 1 elf ...]
+#
+
+import re
+import struct
+import sys
+
+LOG_BIN_START     = 0x1E
+LOG_BIN_ESC       = 0x1B
+LOG_BIN_ARGS_MAX  = 0x07
+LOG_BIN_CORE_SHFT = 3
+LOG_BIN_IMG_SHFT  = 5
+LOG_BIN_ABS_TIME  = 0x80
+
+CONV = re.compile(rb"%([-0]*)(\d+|\*)?(?:\.(\d+|\*))?(?:hh|h|ll|l|z)?([diuxXpcs%])")
+
+#
+# ELF64 little endian. Returns the contents of the .logstr section or
+# an empty string if the image has none.
+#
+
+def read_logstr(path):
+    with open(path, "rb") as f:
+        elf = f.read()
+
+    if elf[:4] != b"\x7fELF" or elf[4] != 2 or elf[5] != 1:
+        sys.exit("%s: not a little endian ELF64 file" % path)
+
+    shoff, = struct.unpack_from("<Q", elf, 0x28)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x3A)
+
+    def section(i):
+        name, kind, flags, addr, off, size = struct.unpack_from(
+            "<IIQQQQ", elf, shoff + i * shentsize)
+        return name, off, size
+
+    _, stroff, _ = section(shstrndx)
+
+    for i in range(shnum):
+        name, off, size = section(i)
+        end = elf.index(b"\0", stroff + name)
+        if elf[stroff + name:end] == b".logstr":
+            return elf[off:off + size]
+
+    return b""
+
+#
+# printf() for the conversions of src/tasks/fmt.c. Arguments are the
+# 64 bit words logged by the target.
+#
+
+def signed(val):
+    return val - (1 << 64) if val & (1 << 63) else val
+
+def format_c(fmt, args):
+    args = list(args)
+    out  = []
+    pos  = 0
+
+    def arg():
+        return args.pop(0) if args else 0
+
+    for m in CONV.finditer(fmt):
+        out.append(fmt[pos:m.start()].decode("latin-1"))
+        pos = m.end()
+        flags, width, prec, conv = m.groups()
+        conv = conv.decode()
+
+        if conv == "%":
+            out.append("%")
+            continue
+
+        width = arg() if width == b"*" else int(width or 0)
+        prec  = arg() if prec == b"*" else (int(prec) if prec else None)
+        val   = arg()
+
+        if conv in "di":
+            text = "%d" % signed(val)
+        elif conv == "u":
+            text = "%d" % val
+        elif conv == "x":
+            text = "%x" % val
+        elif conv == "X":
+            text = "%X" % val
+        elif conv == "p":
+            text = "0x%x" % val
+        elif conv == "c":
+            text = chr(val & 0xFF)
+        else:
+            text = "<%%s 0x%x>" % val # Strings are not logged.
+
+        if prec is not None and conv in "diuxX":
+            neg  = text.startswith("-")
+            text = text.lstrip("-").rjust(prec, "0")
+            text = "-" + text if neg else text
+
+        if b"-" in flags:
+            text = text.ljust(width)
+        elif b"0" in flags and prec is None and conv not in "cs":
+            neg  = text.startswith("-")
+            pre  = "-" if neg else ("0x" if conv == "p" else "")
+            body = text[len(pre):]
+            text = pre + body.rjust(width - len(pre), "0")
+        else:
+            text = text.rjust(width)
+
+        out.append(text)
+
+    out.append(fmt[pos:].decode("latin-1"))
+    return "".join(out)
+
+#
+# Frames. Returns (header, id, time, args) or None if the frame was cut
+# short, for example by a message dropped from a full log ring.
+#
+
+def unescape(raw):
+    out = bytearray()
+    esc = False
+
+    for b in raw:
+        if esc:
+            out.append(b ^ 0x20)
+            esc = False
+        elif b == LOG_BIN_ESC:
+            esc = True
+        else:
+            out.append(b)
+
+    return bytes(out)
+
+def leb128(data, pos):
+    val   = 0
+    shift = 0
+
+    while True:
+        b = data[pos]
+        pos += 1
+        val |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return val, pos
+
+def parse_frame(raw):
+    data = unescape(raw)
+
+    try:
+        hdr = data[0]
+        fid = data[1] | data[2] << 8
+        time, pos = leb128(data, 3)
+        args = []
+        for i in range(hdr & LOG_BIN_ARGS_MAX):
+            val, pos = leb128(data, pos)
+            args.append(val)
+    except IndexError:
+        return None
+
+    if pos != len(data):
+        return None
+
+    return hdr, fid, time, args
+
+#
+# Decoder. Messages logged in several calls are joined per core and 
+# printed with the time of their first frame like kernel_log_drain().
+#
+
+def stamp(time):
+    return "[?] " if time is None else "[0x%X] " % time
+
+def decode(capture, images, out):
+    last  = {} # Core: counter at its previous frame.
+    lines = {} # Core: (time, text) of a message without its newline yet.
+    pos   = 0
+
+    while pos < len(capture):
+        start = capture.find(bytes([LOG_BIN_START]), pos)
+        if start < 0:
+            out.write(capture[pos:].decode("latin-1"))
+            break
+
+        out.write(capture[pos:start].decode("latin-1"))
+        end = capture.find(b"\n", start)
+        if end < 0:
+            end = len(capture)
+        pos = end + 1
+
+        frame = parse_frame(capture[start + 1:end])
+        if frame is None:
+            out.write("logdecode: bad frame %s\n" % capture[start:end].hex())
+            continue
+
+        hdr, fid, time, args = frame
+        core  = (hdr >> LOG_BIN_CORE_SHFT) & 0x3
+        image = (hdr >> LOG_BIN_IMG_SHFT) & 0x3
+
+        if hdr & LOG_BIN_ABS_TIME:
+            last[core] = time
+        elif core in last:
+            last[core] += time
+        else:
+            last[core] = None # Capture started after the last full time.
+        time = last[core]
+
+        strings = images[image] if image < len(images) else b""
+        if fid >= len(strings):
+            text = "<image %u string 0x%x>\n" % (image, fid)
+        else:
+            text = format_c(strings[fid:strings.index(b"\0", fid)], args)
+
+        if core in lines:
+            first, prev = lines.pop(core)
+            text = prev + text
+        else:
+            first = time
+
+        if not text.endswith("\n"):
+            lines[core] = (first, text)
+            continue
+
+        out.write(stamp(first) + text)
+
+    for core, (first, text) in sorted(lines.items()):
+        out.write(stamp(first) + text + "\n")
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit("Usage: %s <capture> <task0.elf> [image 1 elf ...]" % sys.argv[0])
+
+    images = [read_logstr(path) for path in sys.argv[2:]]
+
+    with open(sys.argv[1], "rb") as f:
+        capture = f.read()
+
+    decode(capture, images, sys.stdout)
+
+if __name__ == "__main__":
+    main()
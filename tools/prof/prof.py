@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2020 Richard Healy
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+#
+# prof.py
+# Map profile histograms printed by task_prof_dump() (src/kernel/prof.c)
+# to symbols. Symbols come from each task's ELF file or its objdump
+# listing (debug/*.lst). Tasks are linked at 0 and samples are offsets
+# into the task image, so no relocation is needed.
+#
+# Usage: prof.py [-n N] <capture> <task0.elf|.lst> [<task1.elf|.lst>]...
+#
+# The N'th file after the capture is task N. Use - to skip a task.
+#
+
+import bisect
+import re
+import struct
+import sys
+
+SHT_SYMTAB = 2
+STT_FUNC   = 2
+STT_NOTYPE = 0
+
+#
+# Readers. Each returns {core: (period, samples, {task: (shift, other,
+# {offset: count})})}. Histograms are cumulative so the last dump of a
+# core wins.
+#
+
+def read_uart(text):
+    cores = {}
+    dump  = None
+    task  = None
+    hexnum = r"0x([0-9A-Fa-f]+)"
+    begin = re.compile(r"rpi3rtos::prof: begin %s %s %s" % (hexnum, hexnum, hexnum))
+    head  = re.compile(r"rpi3rtos::prof: task %s %s %s" % (hexnum, hexnum, hexnum))
+    rec   = re.compile(r"rpi3rtos::prof: %s %s" % (hexnum, hexnum))
+
+    for line in text.splitlines():
+        m = begin.search(line)
+        if m:
+            dump = (int(m.group(2), 16), int(m.group(3), 16), {})
+            cores[int(m.group(1), 16)] = dump
+            task = None
+            continue
+        if "rpi3rtos::prof: end" in line:
+            dump = None
+            continue
+        m = head.search(line)
+        if m and dump is not None:
+            task = (int(m.group(2), 16), int(m.group(3), 16), {})
+            dump[2][int(m.group(1), 16)] = task
+            continue
+        m = rec.search(line)
+        if m and task is not None:
+            task[2][int(m.group(1), 16)] = int(m.group(2), 16)
+    return cores
+
+#
+# Symbols as a sorted list of (address, name).
+#
+
+def read_elf(data):
+    if data[:4] != b"\x7fELF" or data[4] != 2:
+        return None
+    shoff, = struct.unpack_from("<Q", data, 0x28)
+    shentsize, shnum = struct.unpack_from("<HH", data, 0x3A)
+    sections = [struct.unpack_from("<IIQQQQIIQQ", data, shoff + i * shentsize)
+                for i in range(shnum)]
+    syms = []
+
+    for sh in sections:
+        if sh[1] != SHT_SYMTAB:
+            continue
+        strtab = sections[sh[6]]
+        for off in range(sh[4], sh[4] + sh[5], sh[9]):
+            name, info, _, shndx, value, _ = struct.unpack_from("<IBBHQQ", data, off)
+            if shndx == 0 or (info & 0xF) not in (STT_FUNC, STT_NOTYPE):
+                continue
+            beg = strtab[4] + name
+            text = data[beg:data.index(b"\0", beg)].decode("ascii", "replace")
+            if text and not text.startswith("$"):
+                syms.append((value, text))
+    return sorted(set(syms))
+
+def read_lst(text):
+    label = re.compile(r"^([0-9a-fA-F]+) <([^>]+)>:")
+    syms = []
+    for line in text.splitlines():
+        m = label.match(line)
+        if m:
+            syms.append((int(m.group(1), 16), m.group(2)))
+    return sorted(set(syms))
+
+def read_symbols(path):
+    if path == "-":
+        return []
+    with open(path, "rb") as f:
+        data = f.read()
+    syms = read_elf(data)
+    if syms is None:
+        syms = read_lst(data.decode("ascii", "replace"))
+    return syms
+
+def symbolize(syms, offset):
+    i = bisect.bisect_right([s[0] for s in syms], offset) - 1
+    if i < 0:
+        return "0x%X" % offset
+    return syms[i][1]
+
+#
+# Sum every core's histogram of each task and print the top symbols.
+#
+
+def report(cores, symbols, top):
+    tasks = {}
+    for core in sorted(cores):
+        period, samples, hists = cores[core]
+        print("core %d: %d samples every %d cycles" % (core, samples, period))
+        for task, (shift, other, hist) in hists.items():
+            t = tasks.setdefault(task, [shift, 0, {}])
+            t[1] += other
+            for offset, count in hist.items():
+                t[2][offset] = t[2].get(offset, 0) + count
+
+    for task in sorted(tasks):
+        shift, other, hist = tasks[task]
+        total = other + sum(hist.values())
+        if not total:
+            continue
+        syms = symbols[task] if task < len(symbols) else []
+        by_sym = {}
+        for offset, count in hist.items():
+            name = symbolize(syms, offset)
+            by_sym[name] = by_sym.get(name, 0) + count
+        if other:
+            by_sym["<outside code>"] = other
+
+        print("")
+        print("task %d: %d samples, %d byte buckets" % (task, total, 1 << shift))
+        for name, count in sorted(by_sym.items(), key=lambda s: -s[1])[:top]:
+            print("  %6.2f%% %8d  %s" % (100.0 * count / total, count, name))
+
+def main(argv):
+    top = 20
+    args = argv[1:]
+    if len(args) > 1 and args[0] == "-n":
+        top = int(args[1])
+        args = args[2:]
+    if len(args) < 2:
+        sys.stderr.write("usage: %s [-n N] <capture> <task0.elf|.lst> "
+                         "[<task1.elf|.lst>]...\n" % argv[0])
+        return 1
+
+    with open(args[0], "rb") as f:
+        cores = read_uart(f.read().decode("ascii", "replace"))
+    if not cores:
+        sys.stderr.write("%s: no profile found\n" % args[0])
+        return 1
+
+    report(cores, [read_symbols(p) for p in args[1:]], top)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,928 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//sim.c
+// Discrete event simulator for scheduling policies. Replays a workload
+// of task activity (run bursts, sleeps, I/O waits, yields and priority
+// changes) through the kernel's own queue, sleep timer wheel and 
+// suspend list (src/kernel/sched.c, queue.c, sleep.c and node.c) and
+// reports throughput, response time percentiles and deadline misses
+// for each policy. Hardware and logging are stubbed out by 
+// tools/bench/host.c.
+//
+// Usage: sim [-c cores] [-d duration] [-p policy]... workload
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "kernel.h"
+
+#define SIM_NEVER        0xFFFFFFFFFFFFFFFFULL
+#define SIM_POLICIES_MAX 16
+#define SIM_HIST_SUB     16   //Histogram buckets per power of two.
+#define SIM_HIST_SZ      (64 * SIM_HIST_SUB)
+
+//
+//SIM_OP_*
+// Workload actions.
+//
+#define SIM_OP_RUN      1 //Use the CPU for lo-hi ns.
+#define SIM_OP_SLEEP    2 //task_sleep() for lo ms.
+#define SIM_OP_USLEEP   3 //task_usleep() for lo-hi ns.
+#define SIM_OP_IO       4 //Suspended waiting for I/O for lo-hi ns.
+#define SIM_OP_YIELD    5 //task_yield().
+#define SIM_OP_PRIORITY 6 //task_priority_set() to lo.
+
+//
+//SIM_PRIO_*, SIM_QUEUE_*
+// Policy choices for priorities and queue flags.
+//
+#define SIM_PRIO_TRACE  0 //As in the workload.
+#define SIM_PRIO_FLAT   1 //Every task the same priority.
+#define SIM_PRIO_RM     2 //Rate monotonic. Shorter cycle is higher.
+#define SIM_PRIO_DM     3 //Deadline monotonic. Shorter deadline is higher.
+
+#define SIM_QUEUE_TRACE 0
+#define SIM_QUEUE_RR    1
+#define SIM_QUEUE_FIFO  2
+
+typedef struct _sim_action {
+    u64_t op;
+    u64_t lo;
+    u64_t hi;
+} sim_action;
+
+//
+//sim_task{}
+// Task from the workload and its state while a policy is simulated.
+//
+typedef struct _sim_task {
+    char name[48];
+    i64_t priority;      //From the workload.
+    u64_t flags;         //KERNEL_TASK_FLAG_QUEUE_* from the workload.
+    u64_t deadline;      //Response time limit in ns. 0 is none.
+    u64_t action;        //First action in sim_actions[].
+    u64_t num_actions;
+    u64_t core;          //Core the task runs on.
+    u64_t id;            //Kernel task number on its core.
+    u64_t cycle;         //Mean ns per pass. SIM_NEVER if it never blocks.
+    u64_t pc;            //Next action.
+    u64_t remaining;     //ns left in the current run burst.
+    u64_t release;       //When the current job became due.
+    u64_t rng;
+    i64_t level;         //Priority under the policy being simulated.
+} sim_task;
+
+//
+//sim_policy{}
+//
+typedef struct _sim_policy {
+    char name[64];
+    u64_t tick_ns;       //Tick length.
+    u64_t tick_cost;     //ns of CPU taken by each tick.
+    u64_t switch_cost;   //ns of CPU taken by each context switch.
+    u64_t prio;          //SIM_PRIO_*
+    u64_t queue;         //SIM_QUEUE_*
+} sim_policy;
+
+//
+//sim_stats{}
+// Results of one policy summed over cores.
+//
+typedef struct _sim_stats {
+    u64_t jobs;
+    u64_t misses;
+    u64_t busy;          //ns running tasks.
+    u64_t overhead;      //ns switching.
+    u64_t switches;
+    u64_t hist[SIM_HIST_SZ]; //Response times.
+    u64_t max;
+} sim_stats;
+
+//
+//sim_event{}
+// Pending wake up of a task in usleep or waiting for I/O.
+//
+typedef struct _sim_event {
+    u64_t time;
+    u64_t task;          //Index in sim_tasks[].
+} sim_event;
+
+static sim_task   *sim_tasks;
+static u64_t       sim_num_tasks;
+static sim_action *sim_actions;
+static u64_t       sim_num_actions;
+
+static sim_event  *sim_heap;
+static u64_t       sim_heap_len;
+
+static u64_t       sim_core_tasks[PLATFORM_CORES][KERNEL_TASKS_MAX];
+static u64_t       sim_core_count[PLATFORM_CORES];
+
+//*********************************************************************
+// Helpers
+//*********************************************************************
+
+static void sim_die(const char *msg, const char *arg, u64_t line) {
+    if (line) {
+        fprintf(stderr, "sim: line %llu: %s%s\n", line, msg, arg);
+    } else {
+        fprintf(stderr, "sim: %s%s\n", msg, arg);
+    }
+    exit(1);
+}
+
+//
+//sim_rand()
+// xorshift64. Each task has its own stream so policies see the same
+// workload.
+//
+static u64_t sim_rand(u64_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static u64_t sim_draw(sim_task *t, sim_action *a) {
+    if (a->hi <= a->lo) {
+        return a->lo;
+    }
+    return a->lo + sim_rand(&t->rng) % (a->hi - a->lo + 1);
+}
+
+static void sim_hist_add(sim_stats *st, u64_t val) {
+    u64_t msb, sub;
+
+    if (val < SIM_HIST_SUB) {
+        ++st->hist[val];
+    } else {
+        msb = 63 - __builtin_clzll(val);
+        sub = (val >> (msb - 4)) & (SIM_HIST_SUB - 1);
+        ++st->hist[(msb - 3) * SIM_HIST_SUB + sub];
+    }
+
+    if (val > st->max) {
+        st->max = val;
+    }
+}
+
+//
+//sim_hist_pct()
+// Upper bound of the bucket holding percentile 'pct'. Within 1/16.
+//
+static u64_t sim_hist_pct(sim_stats *st, double pct) {
+    u64_t total = 0, seen = 0, want, i, msb, val;
+
+    for (i = 0; i < SIM_HIST_SZ; ++i) {
+        total += st->hist[i];
+    }
+    if (!total) {
+        return 0;
+    }
+
+    want = (u64_t) (pct / 100.0 * total);
+    if (want >= total) {
+        want = total - 1;
+    }
+
+    for (i = 0; i < SIM_HIST_SZ; ++i) {
+        seen += st->hist[i];
+        if (seen > want) {
+            break;
+        }
+    }
+
+    if (i < SIM_HIST_SUB) {
+        return i;
+    }
+
+    msb = i / SIM_HIST_SUB + 3;
+    val = ((SIM_HIST_SUB + i % SIM_HIST_SUB + 1) << (msb - 4)) - 1;
+    return val < st->max ? val : st->max;
+}
+
+//*********************************************************************
+// Event Heap
+//  Wake ups ordered by time.
+//*********************************************************************
+
+static void sim_heap_psh(u64_t time, u64_t task) {
+    u64_t i = sim_heap_len++;
+
+    while (i && sim_heap[(i - 1) / 2].time > time) {
+        sim_heap[i] = sim_heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sim_heap[i].time = time;
+    sim_heap[i].task = task;
+}
+
+static sim_event sim_heap_pop(void) {
+    sim_event top = sim_heap[0];
+    sim_event last = sim_heap[--sim_heap_len];
+    u64_t i = 0, c;
+
+    while ((c = 2 * i + 1) < sim_heap_len) {
+        if (c + 1 < sim_heap_len && sim_heap[c + 1].time < sim_heap[c].time) {
+            ++c;
+        }
+        if (last.time <= sim_heap[c].time) {
+            break;
+        }
+        sim_heap[i] = sim_heap[c];
+        i = c;
+    }
+    sim_heap[i] = last;
+
+    return top;
+}
+
+//*********************************************************************
+// Workload
+//*********************************************************************
+
+//
+//sim_parse_range()
+// "N" or "N-M" scaled by 'unit'.
+//
+static void sim_parse_range(const char *s, u64_t unit, sim_action *a, u64_t line) {
+    char *end;
+
+    if (!s) {
+        sim_die("missing value", "", line);
+    }
+    a->lo = strtoull(s, &end, 10) * unit;
+    a->hi = a->lo;
+    if ('-' == *end) {
+        a->hi = strtoull(end + 1, &end, 10) * unit;
+    }
+    if (*end || a->hi < a->lo) {
+        sim_die("bad value ", s, line);
+    }
+}
+
+//
+//sim_task_new()
+// Append a task. Returns its index in sim_tasks[].
+//
+static u64_t sim_task_new(void) {
+    static u64_t cap;
+
+    if (sim_num_tasks == cap) {
+        cap = cap ? 2 * cap : 64;
+        sim_tasks = realloc(sim_tasks, cap * sizeof(sim_task));
+        if (!sim_tasks) {
+            sim_die("out of memory", "", 0);
+        }
+    }
+    memset(&sim_tasks[sim_num_tasks], 0, sizeof(sim_task));
+    return sim_num_tasks++;
+}
+
+//
+//sim_task_copies()
+// Copies of task 'idx' share its actions.
+//
+static void sim_task_copies(u64_t idx, u64_t copies) {
+    char base[24];
+    u64_t i, n;
+
+    memcpy(base, sim_tasks[idx].name, sizeof(base) - 1);
+    base[sizeof(base) - 1] = 0;
+    for (i = 1; i < copies; ++i) {
+        n = sim_task_new();
+        sim_tasks[n] = sim_tasks[idx];
+        snprintf(sim_tasks[n].name, sizeof(sim_tasks[n].name), 
+                 "%s.%llu", base, i);
+    }
+}
+
+static void sim_load(const char *path) {
+    FILE *f = fopen(path, "r");
+    char buf[256], *tok, *arg;
+    u64_t line = 0, copies = 1, cur = SIM_NEVER, acap = 0;
+    sim_task *t;
+    sim_action *a;
+
+    if (!f) {
+        sim_die("can not open ", path, 0);
+    }
+
+    while (fgets(buf, sizeof(buf), f)) {
+        ++line;
+        if ((tok = strchr(buf, '#'))) {
+            *tok = 0;
+        }
+        if (!(tok = strtok(buf, " \t\r\n"))) {
+            continue;
+        }
+
+        if (!strcmp(tok, "task")) {
+            if (SIM_NEVER != cur) {
+                sim_task_copies(cur, copies);
+            }
+
+            copies      = 1;
+            cur         = sim_task_new();
+            t           = &sim_tasks[cur];
+            t->priority = 1;
+            t->flags    = KERNEL_TASK_FLAG_QUEUE_FIFO;
+            t->core     = SIM_NEVER;
+            t->action   = sim_num_actions;
+
+            if (!(arg = strtok(0, " \t\r\n"))) {
+                sim_die("task needs a name", "", line);
+            }
+            snprintf(t->name, sizeof(t->name), "%s", arg);
+
+            while ((tok = strtok(0, " \t\r\n"))) {
+                if (!strcmp(tok, "rr")) {
+                    t->flags = KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN;
+                } else if (!strcmp(tok, "fifo")) {
+                    t->flags = KERNEL_TASK_FLAG_QUEUE_FIFO;
+                } else if (!(arg = strtok(0, " \t\r\n"))) {
+                    sim_die("missing value for ", tok, line);
+                } else if (!strcmp(tok, "priority")) {
+                    t->priority = strtoll(arg, 0, 10);
+                } else if (!strcmp(tok, "deadline")) {
+                    t->deadline = strtoull(arg, 0, 10) * 1000;
+                } else if (!strcmp(tok, "copies")) {
+                    copies = strtoull(arg, 0, 10);
+                } else if (!strcmp(tok, "core")) {
+                    t->core = strtoull(arg, 0, 10);
+                } else {
+                    sim_die("unknown task option ", tok, line);
+                }
+            }
+            continue;
+        }
+
+        if (SIM_NEVER == cur) {
+            sim_die("action before the first task", "", line);
+        }
+        if (sim_num_actions == acap) {
+            acap = acap ? 2 * acap : 256;
+            sim_actions = realloc(sim_actions, acap * sizeof(sim_action));
+            if (!sim_actions) {
+                sim_die("out of memory", "", 0);
+            }
+        }
+        a = &sim_actions[sim_num_actions++];
+        memset(a, 0, sizeof(*a));
+        arg = strtok(0, " \t\r\n");
+
+        if (!strcmp(tok, "run")) {
+            a->op = SIM_OP_RUN;
+            sim_parse_range(arg, 1000, a, line);
+        } else if (!strcmp(tok, "sleep")) {
+            a->op = SIM_OP_SLEEP;
+            sim_parse_range(arg, 1, a, line);
+        } else if (!strcmp(tok, "usleep")) {
+            a->op = SIM_OP_USLEEP;
+            sim_parse_range(arg, 1000, a, line);
+        } else if (!strcmp(tok, "io")) {
+            a->op = SIM_OP_IO;
+            sim_parse_range(arg, 1000, a, line);
+        } else if (!strcmp(tok, "yield")) {
+            a->op = SIM_OP_YIELD;
+        } else if (!strcmp(tok, "priority")) {
+            a->op = SIM_OP_PRIORITY;
+            sim_parse_range(arg, 1, a, line);
+        } else {
+            sim_die("unknown action ", tok, line);
+        }
+        ++sim_tasks[cur].num_actions;
+    }
+
+    if (SIM_NEVER != cur) {
+        sim_task_copies(cur, copies);
+    }
+    fclose(f);
+
+    if (!sim_num_tasks) {
+        sim_die("no tasks in ", path, 0);
+    }
+}
+
+//*********************************************************************
+// Policies
+//*********************************************************************
+
+//
+//sim_policy_parse()
+// "tick=MS,prio=trace|flat|rm|dm,queue=trace|rr|fifo,switch=NS,
+// tickcost=NS". Omitted keys keep the kernel's defaults.
+//
+static void sim_policy_parse(const char *arg, sim_policy *p) {
+    char buf[128], *tok, *val, *save;
+
+    memset(p, 0, sizeof(*p));
+    snprintf(p->name, sizeof(p->name), "%s", arg);
+    snprintf(buf, sizeof(buf), "%s", arg);
+    p->tick_ns = KERNEL_TICK_DURATION_MS * 1000000ULL;
+
+    for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(0, ",", &save)) {
+        if (!(val = strchr(tok, '='))) {
+            sim_die("bad policy option ", tok, 0);
+        }
+        *val++ = 0;
+
+        if (!strcmp(tok, "tick")) {
+            p->tick_ns = (u64_t) (strtod(val, 0) * 1000000.0);
+        } else if (!strcmp(tok, "switch")) {
+            p->switch_cost = strtoull(val, 0, 10);
+        } else if (!strcmp(tok, "tickcost")) {
+            p->tick_cost = strtoull(val, 0, 10);
+        } else if (!strcmp(tok, "prio") && !strcmp(val, "trace")) {
+            p->prio = SIM_PRIO_TRACE;
+        } else if (!strcmp(tok, "prio") && !strcmp(val, "flat")) {
+            p->prio = SIM_PRIO_FLAT;
+        } else if (!strcmp(tok, "prio") && !strcmp(val, "rm")) {
+            p->prio = SIM_PRIO_RM;
+        } else if (!strcmp(tok, "prio") && !strcmp(val, "dm")) {
+            p->prio = SIM_PRIO_DM;
+        } else if (!strcmp(tok, "queue") && !strcmp(val, "trace")) {
+            p->queue = SIM_QUEUE_TRACE;
+        } else if (!strcmp(tok, "queue") && !strcmp(val, "rr")) {
+            p->queue = SIM_QUEUE_RR;
+        } else if (!strcmp(tok, "queue") && !strcmp(val, "fifo")) {
+            p->queue = SIM_QUEUE_FIFO;
+        } else {
+            sim_die("bad policy option ", tok, 0);
+        }
+    }
+
+    if (!p->tick_ns || p->tick_cost >= p->tick_ns) {
+        sim_die("tick must be longer than tickcost in ", arg, 0);
+    }
+}
+
+//
+//sim_task_key()
+// Rate monotonic ranks by cycle time. Deadline monotonic ranks by
+// deadline, or cycle time if the task has none.
+//
+static u64_t sim_task_key(sim_task *t, u64_t prio) {
+    if (SIM_PRIO_DM == prio && t->deadline) {
+        return t->deadline;
+    }
+    return t->cycle;
+}
+
+static int sim_key_cmp(const void *a, const void *b) {
+    u64_t x = *(const u64_t *) a, y = *(const u64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+//
+//sim_policy_levels()
+// Priority of every task under policy 'p'. Rate and deadline monotonic
+// spread the distinct keys over levels 63 (shortest) to 1.
+//
+static void sim_policy_levels(sim_policy *p) {
+    u64_t *keys, i, n = 0, lo, hi, mid;
+
+    if (SIM_PRIO_TRACE == p->prio || SIM_PRIO_FLAT == p->prio) {
+        for (i = 0; i < sim_num_tasks; ++i) {
+            sim_tasks[i].level = SIM_PRIO_FLAT == p->prio ? 1 : 
+                                 sim_tasks[i].priority;
+        }
+        return;
+    }
+
+    keys = malloc(sim_num_tasks * sizeof(u64_t));
+    for (i = 0; i < sim_num_tasks; ++i) {
+        keys[i] = sim_task_key(&sim_tasks[i], p->prio);
+    }
+    qsort(keys, sim_num_tasks, sizeof(u64_t), sim_key_cmp);
+    for (i = 0; i < sim_num_tasks; ++i) {
+        if (!n || keys[n - 1] != keys[i]) {
+            keys[n++] = keys[i];
+        }
+    }
+
+    for (i = 0; i < sim_num_tasks; ++i) {
+        lo = 0;
+        hi = n - 1;
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (keys[mid] < sim_task_key(&sim_tasks[i], p->prio)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        sim_tasks[i].level = n > 1 ? 
+                             (i64_t) (KERNEL_QUEUE_LEVELS - 1 - 
+                                      lo * (KERNEL_QUEUE_LEVELS - 2) / (n - 1)) :
+                             KERNEL_QUEUE_LEVELS / 2;
+    }
+
+    free(keys);
+}
+
+//*********************************************************************
+// Simulation
+//*********************************************************************
+
+//
+//sim_assign()
+// Tasks without a core go to the core with the fewest tasks, as 
+// kernel_smp_assign() does. Kernel task numbers start at 1.
+//
+static void sim_assign(u64_t cores) {
+    u64_t i, c, core;
+    sim_task *t;
+
+    for (i = 0; i < sim_num_tasks; ++i) {
+        t = &sim_tasks[i];
+        core = t->core;
+
+        if (SIM_NEVER == core) {
+            core = 0;
+            for (c = 1; c < cores; ++c) {
+                if (sim_core_count[c] < sim_core_count[core]) {
+                    core = c;
+                }
+            }
+        } else if (core >= cores) {
+            sim_die("task pinned to a missing core: ", t->name, 0);
+        }
+
+        if (sim_core_count[core] + 1 >= KERNEL_TASKS_MAX) {
+            sim_die("too many tasks on a core for KERNEL_TASKS_MAX at ", 
+                    t->name, 0);
+        }
+        t->core = core;
+        t->id   = ++sim_core_count[core];
+        sim_core_tasks[core][t->id] = i;
+    }
+}
+
+//
+//sim_job_done()
+// Task blocks. Its response time is from the job's release until now.
+//
+static void sim_job_done(sim_task *t, u64_t now, sim_stats *st) {
+    u64_t response = now - t->release;
+
+    ++st->jobs;
+    sim_hist_add(st, response);
+    if (t->deadline && response > t->deadline) {
+        ++st->misses;
+    }
+}
+
+//
+//sim_action_next()
+// The running task has finished its run burst. Performs its actions up
+// to the next one which takes time, as the syscalls would.
+//
+static void sim_action_next(kernel *k, sim_policy *p, sim_task *t, 
+                            u64_t now, sim_stats *st) 
+{
+    sim_action *a = &sim_actions[t->action + t->pc];
+    u64_t ticks;
+
+    t->pc = (t->pc + 1) % t->num_actions;
+
+    switch (a->op) {
+        case SIM_OP_RUN:
+            t->remaining = sim_draw(t, a);
+        break;
+
+        case SIM_OP_YIELD:
+            kernel_queue_task_yield_and_update(k, t->id);
+        break;
+
+        case SIM_OP_PRIORITY:
+//Only priorities from the workload change at run time.
+            if (SIM_PRIO_TRACE == p->prio) {
+                k->sysarg.lo = a->lo;
+                k->sysarg.hi = 0;
+                kernel_queue_task_priority_and_update(k, t->id);
+            }
+        break;
+
+        case SIM_OP_SLEEP:
+            sim_job_done(t, now, st);
+//Whole ticks of this policy, in the ms the kernel divides by its own
+//tick length.
+            ticks = (a->lo * 1000000ULL + p->tick_ns - 1) / p->tick_ns;
+            k->time = now / p->tick_ns;
+            k->sysarg.value = ticks * KERNEL_TICK_DURATION_MS;
+            kernel_queue_task_sleep_and_update(k, t->id);
+            t->release = k->tasks[t->id].wakeup * p->tick_ns;
+        break;
+
+        case SIM_OP_USLEEP:
+            sim_job_done(t, now, st);
+            kernel_queue_task_node_rmv(k, t->id);
+            k->tasks[t->id].flags |= KERNEL_TASK_FLAG_SLEEPING;
+            sim_heap_psh(now + sim_draw(t, a), t - sim_tasks);
+        break;
+
+        case SIM_OP_IO:
+            sim_job_done(t, now, st);
+            k->sysarg.value = KERNEL_TASK_FLAG_WAKEUP_UART0_RX;
+            kernel_queue_task_suspend_and_update(k, t->id);
+            sim_heap_psh(now + sim_draw(t, a), t - sim_tasks);
+        break;
+    }
+
+    k->sysarg.value = 0;
+    k->task = kernel_queue_first(k);
+}
+
+//
+//sim_wake()
+// usleep() timer expired or I/O completed.
+//
+static void sim_wake(kernel *k, sim_event *ev) {
+    sim_task *t = &sim_tasks[ev->task];
+
+    if (k->tasks[t->id].flags & KERNEL_TASK_FLAG_SLEEPING) {
+        k->tasks[t->id].flags &= ~KERNEL_TASK_FLAG_SLEEPING;
+    } else {
+        k->tasks[t->id].flags &= ~KERNEL_TASK_FLAG_WAKEUP_UART0_RX;
+        kernel_suspend_task_node_rmv(k, t->id);
+    }
+
+    t->release = ev->time;
+    kernel_queue_task_node_add(k, t->id);
+}
+
+//
+//sim_burst_ns()
+// Time to finish 'work' ns of run burst when ticks take part of the CPU.
+//
+static u64_t sim_burst_ns(u64_t work, double capacity) {
+    u64_t ns = (u64_t) ((double) work / capacity);
+    return (double) ns * capacity < (double) work ? ns + 1 : ns;
+}
+
+//
+//sim_core()
+// Run the tasks of one core under policy 'p' for 'duration' ns. Ticks
+// are only simulated when they can change the schedule: a sleeping task
+// is due or the running round robin task has a peer to rotate with.
+//
+static void sim_core(u64_t core, sim_policy *p, u64_t duration, sim_stats *st) {
+    static kernel k;
+    static task_header headers[KERNEL_TASKS_MAX];
+    double capacity = 1.0 - (double) p->tick_cost / p->tick_ns;
+    u64_t now = 0, last = 0, id, idx, next, t_run, t_tick, t_wake, done;
+    sim_event ev;
+    sim_task *t;
+
+    memset(&k, 0, sizeof(k));
+    memset(headers, 0, sizeof(headers));
+    kernel_queue_init(&k.queue);
+    kernel_sleep_init(&k.sleep, 0);
+    k.core      = core;
+    k.num_tasks = sim_core_count[core] + 1;
+    sim_heap_len = 0;
+
+    for (id = 1; id < k.num_tasks; ++id) {
+        idx = sim_core_tasks[core][id];
+        t   = &sim_tasks[idx];
+        t->pc        = 0;
+        t->remaining = 0;
+        t->release   = 0;
+        t->rng       = 0x9E3779B97F4A7C15ULL * (idx + 1);
+
+        k.tasks[id].header    = &headers[id];
+        k.tasks[id].priority  = t->level;
+        k.tasks[id].flags     = t->flags;
+        k.tasks[id].node.task = id;
+        if (SIM_QUEUE_RR == p->queue) {
+            k.tasks[id].flags = KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN;
+        } else if (SIM_QUEUE_FIFO == p->queue) {
+            k.tasks[id].flags = KERNEL_TASK_FLAG_QUEUE_FIFO;
+        }
+        kernel_queue_task_node_add(&k, id);
+    }
+
+    while (now < duration) {
+        id = k.task;
+        t  = id ? &sim_tasks[sim_core_tasks[core][id]] : 0;
+
+        if (id != last) {
+            last = id;
+            if (id) {
+                ++st->switches;
+                now          += p->switch_cost;
+                st->overhead += p->switch_cost;
+            }
+        }
+
+        if (t && !t->remaining) {
+            sim_action_next(&k, p, t, now, st);
+            continue;
+        }
+
+        t_run  = t ? now + sim_burst_ns(t->remaining, capacity) : SIM_NEVER;
+        t_wake = sim_heap_len ? sim_heap[0].time : SIM_NEVER;
+        t_tick = SIM_NEVER;
+
+        if (KERNEL_SLEEP_NEVER != kernel_sleep_next(&k)) {
+            t_tick = kernel_sleep_next(&k) * p->tick_ns;
+        }
+        if (t && (k.tasks[id].flags & KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN) &&
+            kernel_queue_has_peer(&k, id))
+        {
+            next = (now / p->tick_ns + 1) * p->tick_ns;
+            t_tick = next < t_tick ? next : t_tick;
+        }
+        if (t_tick < now) {
+//Overslept while a switch was paid for. Next tick wakes it.
+            t_tick = (now / p->tick_ns + 1) * p->tick_ns;
+        }
+
+        next = duration;
+        next = t_run  < next ? t_run  : next;
+        next = t_wake < next ? t_wake : next;
+        next = t_tick < next ? t_tick : next;
+        next = next < now ? now : next;
+
+        if (t) {
+            st->busy += next - now;
+            if (next == t_run) {
+                t->remaining = 0;
+            } else {
+                done = (u64_t) ((double) (next - now) * capacity);
+                t->remaining -= done < t->remaining ? done : t->remaining - 1;
+            }
+        }
+        now = next;
+
+        while (sim_heap_len && sim_heap[0].time <= now) {
+            ev = sim_heap_pop();
+            sim_wake(&k, &ev);
+        }
+
+        if (t_tick <= now) {
+            k.time = t_tick / p->tick_ns;
+            kernel_service_sleeping(&k);
+            kernel_service_tick(&k);
+        }
+    }
+}
+
+//
+//sim_duration()
+// Seconds with an optional ms, s, m or h suffix.
+//
+static u64_t sim_duration(const char *arg) {
+    char *end;
+    double v = strtod(arg, &end);
+
+    if (!strcmp(end, "ms")) {
+        v /= 1000.0;
+    } else if (!strcmp(end, "m")) {
+        v *= 60.0;
+    } else if (!strcmp(end, "h")) {
+        v *= 3600.0;
+    } else if (*end && strcmp(end, "s")) {
+        sim_die("bad duration ", arg, 0);
+    }
+    return (u64_t) (v * 1e9);
+}
+
+static void sim_usage(void) {
+    fprintf(stderr, 
+        "usage: sim [-c cores] [-d duration] [-p policy]... workload\n"
+        "  -c cores     1 to %d. Default 1.\n"
+        "  -d duration  Simulated time, e.g. 90s, 10m, 2h. Default 60s.\n"
+        "  -p policy    tick=MS,prio=trace|flat|rm|dm,queue=trace|rr|fifo,\n"
+        "               switch=NS,tickcost=NS. Repeat to compare.\n",
+        PLATFORM_CORES);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    static sim_policy policies[SIM_POLICIES_MAX];
+    static sim_stats st;
+    u64_t num_policies = 0, cores = 1, duration = 60000000000ULL;
+    u64_t i, j, c, timed, blocks;
+    double secs;
+    sim_action *a;
+    sim_task *t;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "c:d:p:"))) {
+        switch (opt) {
+            case 'c':
+                cores = strtoull(optarg, 0, 10);
+                if (!cores || cores > PLATFORM_CORES) {
+                    sim_usage();
+                }
+            break;
+
+            case 'd':
+                duration = sim_duration(optarg);
+            break;
+
+            case 'p':
+                if (SIM_POLICIES_MAX == num_policies) {
+                    sim_die("too many policies", "", 0);
+                }
+                sim_policy_parse(optarg, &policies[num_policies++]);
+            break;
+
+            default:
+                sim_usage();
+        }
+    }
+    if (optind + 1 != argc) {
+        sim_usage();
+    }
+    if (!num_policies) {
+        sim_policy_parse("prio=trace", &policies[num_policies++]);
+    }
+
+    sim_load(argv[optind]);
+
+//Mean time per pass through the actions, for rate monotonic. Tasks 
+//which never block are not periodic and rank lowest. Every task needs 
+//an action that takes time or the simulation would not advance.
+    for (i = 0; i < sim_num_tasks; ++i) {
+        t = &sim_tasks[i];
+        timed = 0;
+        blocks = 0;
+        for (j = 0; j < t->num_actions; ++j) {
+            a = &sim_actions[t->action + j];
+            if (SIM_OP_SLEEP == a->op) {
+                t->cycle += a->lo * 1000000ULL;
+                timed = 1;
+                blocks = 1;
+            } else if (SIM_OP_RUN == a->op || SIM_OP_USLEEP == a->op ||
+                       SIM_OP_IO == a->op) {
+                t->cycle += (a->lo + a->hi) / 2;
+                timed |= a->hi || SIM_OP_RUN != a->op;
+                blocks |= SIM_OP_RUN != a->op;
+            }
+        }
+        if (!timed) {
+            sim_die("task never runs or blocks: ", t->name, 0);
+        }
+        if (!blocks) {
+            t->cycle = SIM_NEVER;
+        }
+    }
+
+    sim_assign(cores);
+    sim_heap = malloc(sim_num_tasks * sizeof(sim_event));
+    secs = duration / 1e9;
+
+    printf("sim: %llu tasks on %llu cores, %.0f s simulated\n", 
+           sim_num_tasks, cores, secs);
+    printf("%10s %6s %6s %9s %9s %9s %9s %9s %9s %8s  %s\n",
+           "jobs/s", "cpu%", "ovh%", "sw/s", "p50us", "p90us", "p99us", 
+           "p99.9us", "maxus", "misses", "policy");
+
+    for (i = 0; i < num_policies; ++i) {
+        memset(&st, 0, sizeof(st));
+        sim_policy_levels(&policies[i]);
+        for (c = 0; c < cores; ++c) {
+            sim_core(c, &policies[i], duration, &st);
+        }
+
+        printf("%10.1f %6.1f %6.2f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8llu  %s\n",
+               st.jobs / secs, 
+               100.0 * st.busy / (double) (duration * cores),
+               100.0 * st.overhead / (double) (duration * cores),
+               st.switches / secs,
+               sim_hist_pct(&st, 50.0) / 1e3, sim_hist_pct(&st, 90.0) / 1e3,
+               sim_hist_pct(&st, 99.0) / 1e3, sim_hist_pct(&st, 99.9) / 1e3,
+               st.max / 1e3, st.misses, policies[i].name);
+    }
+
+    return 0;
+}
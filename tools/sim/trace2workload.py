@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2020 Richard Healy
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+#
+# trace2workload.py
+# Turn kernel trace rings (src/kernel/trace.h) into a workload for sim.
+# Each task's run bursts, sleeps, usleeps, I/O waits and yields are
+# replayed in the order they were recorded. The trace has no priorities
+# or deadlines so they are given on the command line.
+#
+# Usage: trace2workload.py [-p task=prio[:rr]]... [-d task=us]...
+#                          <capture or dump> [out.txt]
+#
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                "..", "trace"))
+from trace2json import (read_uart, read_mem, SWITCH, SYSCALL_ENTER,
+                        WAKEUP, SLEEP, SUSPEND)
+
+SYSCALL_SLEEP  = 2
+SYSCALL_USLEEP = 4
+SYSCALL_YIELD  = 7
+
+#
+# Actions of each task as (time, text), with the core it ran on longest.
+#
+
+def task_actions(rings):
+    actions = {}  # task -> [(time, action)]
+    cores   = {}  # task -> {core: us}
+
+    for core, freq, recs in rings:
+        running = None  # (task, start)
+        burst   = {}    # task -> us run since it last blocked
+        syscall = {}    # task -> last syscall
+        blocked = {}    # task -> time suspended
+
+        def us(t):
+            return t * 1e6 / freq
+
+        def ran(task, t):
+            used = cores.setdefault(task, {})
+            used[core] = used.get(core, 0) + us(t) - us(running[1])
+            burst[task] = burst.get(task, 0) + us(t) - us(running[1])
+
+        def act(task, t, text):
+            nonlocal running
+            if running is not None and running[0] == task:
+                ran(task, t)
+                running = (task, t)
+            if burst.get(task, 0) >= 1:
+                actions.setdefault(task, []).append((us(t), "run %d" % burst[task]))
+            burst[task] = 0
+            if text:
+                actions.setdefault(task, []).append((us(t), text))
+
+        for t, ev, task, arg in recs:
+            if ev == SWITCH:
+                if running is not None and running[0] == task and task:
+                    ran(task, t)
+                running = (arg, t)
+            elif task == 0:
+                continue
+            elif ev == SYSCALL_ENTER:
+                syscall[task] = arg
+                if arg == SYSCALL_YIELD:
+                    act(task, t, "yield")
+            elif ev == SLEEP:
+                if syscall.get(task) == SYSCALL_SLEEP:
+                    act(task, t, "sleep %d" % max(arg // 1000, 1))
+                else:
+                    act(task, t, "usleep %d" % arg)
+            elif ev == SUSPEND:
+                act(task, t, None)
+                blocked[task] = t
+            elif ev == WAKEUP and task in blocked:
+                wait = us(t) - us(blocked[task])
+                actions.setdefault(task, []).append((us(blocked.pop(task)),
+                                                     "io %d" % wait))
+
+    for task in actions:
+        actions[task].sort(key=lambda a: a[0])
+    return actions, cores
+
+def parse_opts(argv):
+    prios, deadlines, args = {}, {}, []
+    i = 1
+    while i < len(argv):
+        if argv[i] in ("-p", "-d") and i + 1 < len(argv):
+            task, val = argv[i + 1].split("=")
+            if argv[i] == "-p":
+                prios[int(task)] = val.split(":")
+            else:
+                deadlines[int(task)] = int(val)
+            i += 2
+        else:
+            args.append(argv[i])
+            i += 1
+    return prios, deadlines, args
+
+def main(argv):
+    prios, deadlines, args = parse_opts(argv)
+    if not args:
+        sys.stderr.write("usage: %s [-p task=prio[:rr]]... [-d task=us]... "
+                         "<capture or dump> [out.txt]\n" % argv[0])
+        return 1
+
+    with open(args[0], "rb") as f:
+        data = f.read()
+
+    rings = read_mem(data)
+    if not rings:
+        rings = read_uart(data.decode("ascii", "replace"))
+    if not rings:
+        sys.stderr.write("%s: no trace found\n" % args[0])
+        return 1
+
+    actions, cores = task_actions(rings)
+    lines = ["# Workload from %s" % os.path.basename(args[0])]
+
+    for task in sorted(actions):
+        prio = prios.get(task, ["1"])
+        head = "task task%d priority %s" % (task, prio[0])
+        if len(prio) > 1 and prio[1] == "rr":
+            head += " rr"
+        if task in deadlines:
+            head += " deadline %d" % deadlines[task]
+        if task in cores:
+            head += " core %d" % max(cores[task], key=cores[task].get)
+        lines.append("")
+        lines.append(head)
+        lines.extend(text for _, text in actions[task])
+
+    out = "\n".join(lines) + "\n"
+    if len(args) > 1:
+        with open(args[1], "w") as f:
+            f.write(out)
+    else:
+        sys.stdout.write(out)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,115 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//fmt_test.c
+// Host tests of the freestanding formatter (src/tasks/fmt.c). Output
+// is compared with the C library's snprintf(). Exits non-zero if a 
+// check fails.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "fmt.h"
+
+static u64_t failures;
+
+//
+//TEST_FMT()
+// Format with both and compare. Arguments are evaluated twice.
+//
+#define TEST_FMT(...)                                                \
+    do {                                                             \
+        char want_[128], got_[128];                                  \
+        snprintf(want_, sizeof(want_), __VA_ARGS__);                 \
+        fmt_snprintf(got_, sizeof(got_), __VA_ARGS__);               \
+        test_check(want_, got_, #__VA_ARGS__, __LINE__);             \
+    } while (0)
+
+static void test_check(const char *want, const char *got, 
+                       const char *args, int line) 
+{
+    if (strcmp(want, got)) {
+        printf("fmt_test.c:%d: %s: want \"%s\" got \"%s\"\n", 
+               line, args, want, got);
+        ++failures;
+    }
+}
+
+//
+//test_int_prec()
+// Precision of integer conversions.
+//
+static void test_int_prec(void) {
+    TEST_FMT("%.4llu", 42ULL);
+    TEST_FMT("%.4llu", 123456ULL);
+    TEST_FMT("%.0u", 0U);
+    TEST_FMT("[%5.0u]", 0U);
+    TEST_FMT("%.0u", 7U);
+    TEST_FMT("%.3d", -5);
+    TEST_FMT("%8.3d", -5);
+    TEST_FMT("%-8.3d|", 5);
+    TEST_FMT("%.8llX", 0xBEEFULL);
+    TEST_FMT("%.*x", 6, 0xabU);
+    TEST_FMT("%.*d", -1, 42);
+    TEST_FMT("[%.*u]", -3, 0U);
+    TEST_FMT("%.20llu", 18446744073709551615ULL);
+}
+
+//
+//test_misc()
+// Conversions the kernel already relies on.
+//
+static void test_misc(void) {
+    TEST_FMT("%llu %lld %d", 0ULL, -9223372036854775807LL - 1, 2147483647);
+    TEST_FMT("0x%016llX", 0x1234ULL);
+    TEST_FMT("%-6s|%6s|%.2s", "ab", "cd", "efgh");
+    TEST_FMT("%c%%%5c", 'x', 'y');
+    TEST_FMT("%.*s", 3, "abcdef");
+    TEST_FMT("%.*s", -1, "abcdef");
+}
+
+int main(void) {
+    char buf[8];
+
+    test_int_prec();
+    test_misc();
+
+//Truncated and always terminated.
+    if (7 != fmt_snprintf(buf, sizeof(buf), "%.10u", 1U) || 
+        strcmp(buf, "0000000")) 
+    {
+        printf("fmt_test.c:%d: truncation: got \"%s\"\n", __LINE__, buf);
+        ++failures;
+    }
+
+    if (failures) {
+        printf("fmt_test: %llu checks failed.\n", failures);
+        return 1;
+    }
+
+    printf("fmt_test: ok\n");
+    return 0;
+}
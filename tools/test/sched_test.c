@@ -0,0 +1,193 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Richard Healy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+//
+//sched_test.c
+// Host tests of the scheduler core (src/kernel/sched.c) and the 
+// syscall fast path (src/kernel/syscall.c). Hardware and logging are
+// stubbed out in tools/bench/host.c and below. Exits non-zero if a
+// check fails.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel.h"
+
+static kernel k;
+static task_header headers[KERNEL_TASKS_MAX];
+static u64_t failures;
+
+//
+//TEST_CHECK()
+// Count and print a failed check.
+//
+#define TEST_CHECK(cond) test_check((cond), #cond, __LINE__)
+
+static void test_check(int ok, const char *cond, int line) {
+    if (!ok) {
+        printf("sched_test.c:%d: check failed: %s\n", line, cond);
+        ++failures;
+    }
+}
+
+//*********************************************************************
+// Stand-ins for the kernel routines syscall.c calls.
+//*********************************************************************
+
+u64_t kernel_now_ns(kernel *k) {
+    return 0;
+}
+
+u64_t kernel_acct_cpu_time(kernel *k, u64_t which) {
+    return 0;
+}
+
+u64_t kernel_pmu_count(kernel *k, u64_t task, u64_t counter) {
+    return 0;
+}
+
+u64_t kernel_lat_value(kernel *k, u64_t task, u64_t permille) {
+    return 0;
+}
+
+void kernel_log_append(kernel_log *l, u64_t task, const char *str) {
+}
+
+void kernel_lock_acquire(kernel_lock *l) {
+}
+
+void kernel_lock_release(kernel_lock *l) {
+}
+
+u64_t uart_read(char *buf, u64_t len) {
+    return 0;
+}
+
+//*********************************************************************
+// Tests
+//*********************************************************************
+
+//
+//test_reset()
+// Kernel with tasks 1 and 2 queued at the same priority. Task 1 is 
+// round-robin and running.
+//
+static void test_reset(void) {
+    u64_t i;
+
+    memset(&k, 0, sizeof(k));
+    kernel_queue_init(&k.queue);
+    kernel_sleep_init(&k.sleep, 0);
+    k.num_tasks = 3;
+
+    for (i = 1; i < k.num_tasks; ++i) {
+        k.tasks[i].header    = &headers[i];
+        k.tasks[i].priority  = 5;
+        k.tasks[i].flags     = KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN;
+        k.tasks[i].node.task = i;
+        kernel_queue_task_node_add(&k, i);
+    }
+
+    k.task = kernel_queue_first(&k);
+}
+
+//
+//test_queue_flags()
+// Queue flags of task 1 are exactly 'flags'.
+//
+static int test_queue_flags(u64_t flags) {
+    return flags == (k.tasks[1].flags & (KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN |
+                                         KERNEL_TASK_FLAG_QUEUE_FIFO));
+}
+
+//
+//test_fast_priority()
+// Task 1 changes only its queue flags through the syscall fast path. 
+// Round-robin to FIFO and back.
+//
+static void test_fast_priority(void) {
+    kernel_frame frame;
+    kernel_sysarg sysarg;
+
+    test_reset();
+    TEST_CHECK(1 == k.task);
+
+    sysarg.lo = 0;
+    sysarg.hi = KERNEL_TASK_FLAG_QUEUE_FIFO;
+    TEST_CHECK(0 == kernel_syscall_fast(&k, KERNEL_SYSCALL_PRIORITY, 
+                                        sysarg.value, &frame));
+    TEST_CHECK(test_queue_flags(KERNEL_TASK_FLAG_QUEUE_FIFO));
+
+    sysarg.hi = KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN;
+    TEST_CHECK(0 == kernel_syscall_fast(&k, KERNEL_SYSCALL_PRIORITY, 
+                                        sysarg.value, &frame));
+    TEST_CHECK(test_queue_flags(KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN));
+}
+
+//
+//test_slow_priority()
+// Task 1 changes its queue flags through the kernel's slow path, on 
+// its own and together with a priority change. Round-robin to FIFO 
+// and back.
+//
+static void test_slow_priority(void) {
+    test_reset();
+
+    k.sysarg.lo = 0;
+    k.sysarg.hi = KERNEL_TASK_FLAG_QUEUE_FIFO;
+    kernel_queue_task_priority_and_update(&k, 1);
+    TEST_CHECK(test_queue_flags(KERNEL_TASK_FLAG_QUEUE_FIFO));
+
+    k.sysarg.hi = KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN;
+    kernel_queue_task_priority_and_update(&k, 1);
+    TEST_CHECK(test_queue_flags(KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN));
+
+//Lower priority. Task 2 runs next.
+    k.sysarg.lo = 4;
+    k.sysarg.hi = KERNEL_TASK_FLAG_QUEUE_FIFO;
+    kernel_queue_task_priority_and_update(&k, 1);
+    TEST_CHECK(test_queue_flags(KERNEL_TASK_FLAG_QUEUE_FIFO));
+    TEST_CHECK(4 == k.tasks[1].priority);
+    TEST_CHECK(2 == k.task);
+
+    k.sysarg.lo = 5;
+    k.sysarg.hi = KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN;
+    kernel_queue_task_priority_and_update(&k, 1);
+    TEST_CHECK(test_queue_flags(KERNEL_TASK_FLAG_QUEUE_ROUND_ROBIN));
+    TEST_CHECK(5 == k.tasks[1].priority);
+}
+
+int main(void) {
+    test_fast_priority();
+    test_slow_priority();
+
+    if (failures) {
+        printf("sched_test: %llu checks failed.\n", failures);
+        return 1;
+    }
+
+    printf("sched_test: ok\n");
+    return 0;
+}
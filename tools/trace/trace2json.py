@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2020 Richard Healy
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+#
+# trace2json.py
+# Decode kernel trace rings (src/kernel/trace.h) into Chrome trace
+# event JSON. Input is either a uart capture containing the output of
+# task_trace_dump() or a raw memory dump containing the rings.
+#
+# Usage: trace2json.py <capture or dump> [out.json]
+#
+
+import json
+import re
+import struct
+import sys
+
+TRACE_MAGIC  = 0x45435254534F5452 # "RTOSTRCE"
+TRACE_HDR    = struct.Struct("<8Q")
+TRACE_REC    = struct.Struct("<QHHI")
+
+SWITCH        = 0x1
+SYSCALL_ENTER = 0x2
+SYSCALL_EXIT  = 0x3
+IRQ_ENTER     = 0x4
+IRQ_EXIT      = 0x5
+WAKEUP        = 0x6
+SLEEP         = 0x7
+SUSPEND       = 0x8
+STEAL         = 0x9
+
+SYSCALLS = {
+    1: "suspend", 2: "sleep", 3: "priority", 4: "usleep",
+    5: "time", 6: "task_id", 7: "yield", 8: "trace_dump",
+}
+
+IRQ_TID = 1000 # Interrupts get their own row under each core.
+
+#
+# Readers. Each returns a list of rings: (core, freq, [(time, event,
+# task, arg), ...]) with records oldest first.
+#
+
+def read_uart(text):
+    rings = []
+    ring  = None
+    hexnum = r"0x([0-9A-Fa-f]{16})"
+    begin = re.compile(r"rpi3rtos::trace: begin %s %s %s" % (hexnum, hexnum, hexnum))
+    rec   = re.compile(r"rpi3rtos::trace: %s %s" % (hexnum, hexnum))
+
+    for line in text.splitlines():
+        m = begin.search(line)
+        if m:
+            ring = (int(m.group(1), 16), int(m.group(2), 16), [])
+            rings.append(ring)
+            continue
+        if "rpi3rtos::trace: end" in line:
+            ring = None
+            continue
+        m = rec.search(line)
+        if m and ring is not None:
+            word = int(m.group(2), 16)
+            ring[2].append((int(m.group(1), 16), word >> 48,
+                            (word >> 32) & 0xFFFF, word & 0xFFFFFFFF))
+    return rings
+
+def read_mem(data):
+    rings = []
+    magic = struct.pack("<Q", TRACE_MAGIC)
+    pos = data.find(magic)
+
+    while pos >= 0:
+        _, core, freq, size, head = TRACE_HDR.unpack_from(data, pos)[:5]
+        recs = pos + TRACE_HDR.size
+        end  = recs + size * TRACE_REC.size
+        if size and size & (size - 1) == 0 and end <= len(data):
+            first = head - size if head > size else 0
+            ring  = (core, freq, [])
+            for i in range(first, head):
+                off = recs + (i & (size - 1)) * TRACE_REC.size
+                ring[2].append(TRACE_REC.unpack_from(data, off))
+            rings.append(ring)
+            pos = data.find(magic, end)
+        else:
+            pos = data.find(magic, pos + 8)
+    return rings
+
+#
+# Convert rings to trace events. Running tasks, syscalls and interrupts
+# become complete ("X") events. Wakeups, sleeps, suspends and steals
+# are instant events.
+#
+
+def task_name(task):
+    return "kernel" if task == 0 else "task %d" % task
+
+def convert(rings):
+    events = []
+    starts = [r[2][0][0] for r in rings if r[2]]
+    t0 = min(starts) if starts else 0
+
+    for core, freq, recs in rings:
+        def us(t):
+            return (t - t0) * 1e6 / freq
+
+        def span(name, tid, beg, end, args=None):
+            ev = {"name": name, "ph": "X", "pid": core, "tid": tid,
+                  "ts": us(beg), "dur": us(end) - us(beg)}
+            if args:
+                ev["args"] = args
+            events.append(ev)
+
+        def instant(name, tid, t, args):
+            events.append({"name": name, "ph": "i", "s": "t", "pid": core,
+                           "tid": tid, "ts": us(t), "args": args})
+
+        tids = set([IRQ_TID])
+        running = None  # (task, start)
+        syscall = {}    # task -> (syscall, start)
+        irq = None      # start
+
+        for t, ev, task, arg in recs:
+            tids.add(task)
+            if ev == SWITCH:
+                if running is not None and running[0] == task:
+                    span(task_name(task), task, running[1], t)
+                running = (arg, t)
+                tids.add(arg)
+            elif ev == SYSCALL_ENTER:
+                syscall[task] = (arg, t)
+            elif ev == SYSCALL_EXIT:
+                if task in syscall and syscall[task][0] == arg:
+                    span("svc %s" % SYSCALLS.get(arg, arg), task,
+                         syscall[task][1], t)
+                    del syscall[task]
+            elif ev == IRQ_ENTER:
+                irq = t
+            elif ev == IRQ_EXIT:
+                if irq is not None:
+                    span("irq", IRQ_TID, irq, t)
+                irq = None
+            elif ev == WAKEUP:
+                instant("wakeup", task, t, {})
+            elif ev == SLEEP:
+                instant("sleep", task, t, {"us": arg})
+            elif ev == SUSPEND:
+                instant("suspend", task, t, {"flags": arg})
+            elif ev == STEAL:
+                instant("steal", task, t, {"from core": arg})
+
+        if running is not None and recs:
+            span(task_name(running[0]), running[0], running[1], recs[-1][0])
+
+        events.append({"name": "process_name", "ph": "M", "pid": core,
+                       "args": {"name": "core %d" % core}})
+        for tid in tids:
+            name = "irq" if tid == IRQ_TID else task_name(tid)
+            events.append({"name": "thread_name", "ph": "M", "pid": core,
+                           "tid": tid, "args": {"name": name}})
+
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write("usage: %s <capture or dump> [out.json]\n" % argv[0])
+        return 1
+
+    with open(argv[1], "rb") as f:
+        data = f.read()
+
+    rings = read_mem(data)
+    if not rings:
+        rings = read_uart(data.decode("ascii", "replace"))
+    if not rings:
+        sys.stderr.write("%s: no trace found\n" % argv[1])
+        return 1
+
+    out = json.dumps(convert(rings), indent=1)
+    if len(argv) > 2:
+        with open(argv[2], "w") as f:
+            f.write(out)
+    else:
+        print(out)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))